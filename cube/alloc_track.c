@@ -0,0 +1,92 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Heap allocation tracking.
+// Built with ENABLE_ALLOC_TRACKING and linked with ALLOC_TRACK_LDFLAGS
+// from the Makefile, every malloc, calloc and realloc this program makes
+// goes through the wrappers below and is counted, on any thread. Frames
+// after the warmup must not allocate at all: transient data comes from
+// frame and scratch arenas, see arena.c. A frame that did allocate is
+// reported with the caller of its first allocation and aborts, the build
+// isn't position independent so `addr2line -e <program> <address>` finds it.
+// Code that allocates on purpose outside the steady state, like a shader
+// rebuilt after an edit, calls alloc_track_excuse for that frame.
+// Allocations inside libraries, the GL driver's included, aren't seen.
+
+#ifndef ENABLE_ALLOC_TRACKING
+#define ENABLE_ALLOC_TRACKING 0
+#endif
+
+#define ALLOC_TRACK_WARMUP_FRAMES 10
+
+static struct {
+	atomic_uint_fast64_t count;
+	_Atomic(void *) first_caller; // of the first allocation since the frame began
+	atomic_bool excused;
+	atomic_uint_fast64_t frame_start_count;
+	uint64_t frames;
+} alloc_track;
+
+#if ENABLE_ALLOC_TRACKING
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+static void alloc_track_count(void *caller) {
+	uint64_t start = atomic_load_explicit(&alloc_track.frame_start_count, memory_order_relaxed);
+	if (atomic_fetch_add_explicit(&alloc_track.count, 1, memory_order_relaxed) == start) {
+		atomic_store_explicit(&alloc_track.first_caller, caller, memory_order_relaxed);
+	}
+}
+
+void *__wrap_malloc(size_t size) {
+	alloc_track_count(__builtin_return_address(0));
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	alloc_track_count(__builtin_return_address(0));
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+	alloc_track_count(__builtin_return_address(0));
+	return __real_realloc(pointer, size);
+}
+#endif
+
+// the allocation of this frame is expected
+void alloc_track_excuse(void) {
+	atomic_store_explicit(&alloc_track.excused, true, memory_order_relaxed);
+}
+
+// call where the frame loop starts a frame, on one thread
+void alloc_track_frame_begin(void) {
+	uint64_t count = atomic_load_explicit(&alloc_track.count, memory_order_relaxed);
+	atomic_store_explicit(&alloc_track.frame_start_count, count, memory_order_relaxed);
+	atomic_store_explicit(&alloc_track.first_caller, NULL, memory_order_relaxed);
+	atomic_store_explicit(&alloc_track.excused, false, memory_order_relaxed);
+}
+
+// and where it ends it, aborts if a frame after the warmup allocated
+void alloc_track_frame_end(void) {
+	if (!ENABLE_ALLOC_TRACKING) {
+		return;
+	}
+	uint64_t count = atomic_load_explicit(&alloc_track.count, memory_order_relaxed)
+		- atomic_load_explicit(&alloc_track.frame_start_count, memory_order_relaxed);
+	alloc_track.frames += 1;
+	if (count == 0 || alloc_track.frames <= ALLOC_TRACK_WARMUP_FRAMES
+		|| atomic_load_explicit(&alloc_track.excused, memory_order_relaxed)) {
+		return;
+	}
+	log_error("frame %llu made %llu heap allocations, the first from %p",
+			  (unsigned long long)alloc_track.frames, (unsigned long long)count,
+			  atomic_load_explicit(&alloc_track.first_caller, memory_order_relaxed));
+	log_flush();
+	abort();
+}
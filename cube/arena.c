@@ -0,0 +1,147 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Linear arenas.
+// An arena reserves a range of address space once and hands out memory by
+// bumping an offset, pages are only backed once touched and stay backed,
+// so an arena that has seen a frame's worth of data once never faults or
+// calls malloc again. Nothing is freed on its own: frame arenas are reset
+// as a whole when the frame they belong to is done, scratch arenas are
+// rewound to a mark when the code that took it returns.
+// A FrameArena has an arena per job worker, so jobs allocate without
+// atomics, plus one for threads outside the job system, of which only one
+// may fill a frame at a time.
+// Every thread has its own scratch arena for loaders, reserved on first
+// use. A job may move to another thread in jobs_wait, so it mustn't hold a
+// scratch mark across one.
+
+#define ARENA_FRAME_RESERVE   (32u << 20)  // per thread and frame
+#define ARENA_SCRATCH_RESERVE (256u << 20) // per thread
+#define ARENA_ALIGN 16 // what malloc would give
+
+typedef struct {
+	unsigned char *base;
+	size_t reserved;
+	size_t used;
+	size_t high_water;
+} Arena;
+
+typedef size_t ArenaMark;
+
+typedef struct {
+	Arena threads[JOBS_MAX_WORKERS + 1]; // the last one for threads that aren't workers
+} FrameArena;
+
+bool arena_init(Arena *arena, size_t reserve) {
+	*arena = (Arena){0};
+	void *base = mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED) {
+		log_error("could not reserve %zu bytes for an arena: %s", reserve, strerror(errno));
+		errno = 0;
+		return false;
+	}
+	arena->base = base;
+	arena->reserved = reserve;
+	return true;
+}
+
+void arena_destroy(Arena *arena) {
+	if (arena->base != NULL) {
+		munmap(arena->base, arena->reserved);
+	}
+	*arena = (Arena){0};
+}
+
+// align is a power of two, NULL once the reservation is used up
+void *arena_alloc(Arena *arena, size_t size, size_t align) {
+	size_t start = (arena->used + align - 1) & ~(align - 1);
+	if (start > arena->reserved || size > arena->reserved - start) {
+		log_error("arena of %zu bytes is full, %zu more requested", arena->reserved, size);
+		return NULL;
+	}
+	arena->used = start + size;
+	if (arena->used > arena->high_water) {
+		arena->high_water = arena->used;
+	}
+	return arena->base + start;
+}
+
+#define arena_alloc_array(arena, type, count) \
+	((type *)arena_alloc((arena), sizeof(type) * (count), _Alignof(type)))
+
+void arena_reset(Arena *arena) {
+	arena->used = 0;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+	return arena->used;
+}
+
+// frees everything allocated since the mark was taken
+void arena_rewind(Arena *arena, ArenaMark mark) {
+	arena->used = mark;
+}
+
+// the calling thread's arena of the frame, reserved on first use
+Arena *frame_arena_thread(FrameArena *frame) {
+	int index = jobs_worker_index();
+	Arena *arena = &frame->threads[index >= 0 ? index : JOBS_MAX_WORKERS];
+	if (arena->base == NULL && !arena_init(arena, ARENA_FRAME_RESERVE)) {
+		return NULL;
+	}
+	return arena;
+}
+
+// once nothing reads what the frame allocated anymore
+void frame_arena_reset(FrameArena *frame) {
+	for (int i = 0; i <= JOBS_MAX_WORKERS; ++i) {
+		arena_reset(&frame->threads[i]);
+	}
+}
+
+void frame_arena_destroy(FrameArena *frame) {
+	for (int i = 0; i <= JOBS_MAX_WORKERS; ++i) {
+		arena_destroy(&frame->threads[i]);
+	}
+}
+
+// the most any thread's arena held in one frame
+size_t frame_arena_high_water(const FrameArena *frame) {
+	size_t high_water = 0;
+	for (int i = 0; i <= JOBS_MAX_WORKERS; ++i) {
+		if (frame->threads[i].high_water > high_water) {
+			high_water = frame->threads[i].high_water;
+		}
+	}
+	return high_water;
+}
+
+static _Thread_local Arena arena_scratch_thread;
+static pthread_key_t arena_scratch_key;
+static pthread_once_t arena_scratch_once = PTHREAD_ONCE_INIT;
+
+static void arena_scratch_release(void *arena) {
+	arena_destroy(arena);
+}
+
+static void arena_scratch_key_create(void) {
+	pthread_key_create(&arena_scratch_key, arena_scratch_release);
+}
+
+// The calling thread's scratch arena. Take a mark before allocating and
+// rewind to it before returning. If the reservation failed every
+// allocation from it fails.
+Arena *arena_scratch(void) {
+	Arena *arena = &arena_scratch_thread;
+	if (arena->base == NULL && arena_init(arena, ARENA_SCRATCH_RESERVE)) {
+		// unmapped when the thread exits
+		pthread_once(&arena_scratch_once, arena_scratch_key_create);
+		pthread_setspecific(arena_scratch_key, arena);
+	}
+	return arena;
+}
@@ -0,0 +1,606 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "hash.c"
+#include "log.c"
+#include "math.c"
+#include "profiler.c"
+#include "jobs.c"
+#include "arena.c"
+#include "alloc_track.c"
+#include "pool.c"
+#include "render_stats.c"
+#include "gpu_memory.c"
+#include "retire.c"
+#include "buffer.c"
+#include "tlsf.c"
+#include "mesh_heap.c"
+#include "mesh.c"
+#include "shader.c"
+#include "shader_cache.c"
+#include "shader_reflect.c"
+#include "shader_batch.c"
+#include "shader_preprocess.c"
+#include "hot_reload.c"
+#include "shader_variant.c"
+#include "command_list.c"
+#include "gpu_profiler.c"
+#include "pipeline_stats.c"
+#include "overdraw.c"
+#include "scene.c"
+#include "frame_stats.c"
+#include "timestep.c"
+#include "hud.c"
+#include "headless.c"
+#include "scenario.c"
+
+#define GLAD_GL_IMPLEMENTATION
+#include "glad.h"
+
+// Runs every scenario of a scenario file headlessly, writes the timings
+// as JSON and optionally compares them against a stored baseline.
+// Each repetition contributes its median frame time, the baseline and the
+// current medians are compared with Welch's t-test. A scenario regressed
+// when it got slower by more than the threshold and the difference is
+// significant, in which case the exit code is 2.
+
+#define BENCH_WIDTH  800
+#define BENCH_HEIGHT 600
+#define SHADER_CACHE_DIR "shader_cache"
+#define SHADER_MANIFEST "shaders.manifest"
+#define BENCH_DEFAULT_SCENARIOS "bench.scenarios"
+#define BENCH_DEFAULT_OUTPUT    "bench_results.json"
+#define BENCH_DEFAULT_ALPHA     0.01
+#define BENCH_DEFAULT_THRESHOLD 5.0 // percent
+
+#define BENCH_EXIT_REGRESSION 2
+
+#define BENCH_JSON_MAX_DEPTH 16 // of nested values in a result file
+#define BENCH_JSON_KEY_SIZE  32
+
+typedef enum {
+	BENCH_VERDICT_NONE = 0, // no baseline to compare against
+	BENCH_VERDICT_SAME,
+	BENCH_VERDICT_FASTER,
+	BENCH_VERDICT_SLOWER,   // significant but within the threshold
+	BENCH_VERDICT_REGRESSION,
+} BenchVerdict;
+
+static const char *bench_verdict_names[] = { "new", "same", "faster", "slower", "REGRESSION" };
+
+typedef struct {
+	double frame_p50[SCENARIO_MAX_REPETITIONS]; // median frame time of each repetition
+	HeadlessTimings timings; // every measured frame of every repetition
+	uint32_t draw_calls;     // per frame
+
+	BenchVerdict verdict;
+	double baseline_mean; // mean of the baseline's repetition medians
+	double change;        // relative change of the mean against the baseline
+	double p_value;
+} BenchResult;
+
+typedef struct {
+	char name[SCENARIO_NAME_SIZE];
+	double frame_p50[SCENARIO_MAX_REPETITIONS];
+	size_t count;
+} BaselineEntry;
+
+typedef struct {
+	char renderer[256];
+	char context[16]; // empty in files from before contexts were recorded
+	BaselineEntry entries[SCENARIO_MAX];
+	size_t count;
+} Baseline;
+
+static double mean(const double *samples, size_t count) {
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i) sum += samples[i];
+	return count ? sum / count : 0.0;
+}
+
+static bool bench_run_scenario(Headless *headless, Scene *scene, const Scenario *scenario, BenchResult *result) {
+	size_t capacity = (size_t)scenario->frames * scenario->repetitions;
+	if (!frame_times_init(&result->timings.cpu, capacity)
+		|| !frame_times_init(&result->timings.submit, capacity)
+		|| !frame_times_init(&result->timings.gpu, capacity)
+		|| !frame_times_init(&result->timings.frame, capacity)) {
+		log_error("out of memory");
+		return false;
+	}
+
+	for (int i = 0; i < scenario->repetitions; ++i) {
+		scenario_apply(scenario, scene);
+
+		// compilation is not what's being measured, finish it first
+		scene_program_state(scene);
+		while (shader_batch_poll() > 0) {}
+		if (scene_program_state(scene) != PROGRAM_READY) {
+			log_error("could not load the shader program for `%s`", scenario->name);
+			return false;
+		}
+
+		size_t first = result->timings.frame.count;
+		headless_run(headless, scene, scenario->warmup, scenario->frames, &result->timings);
+
+		FrameTimes repetition = { result->timings.frame.samples + first, result->timings.frame.count - first, 0 };
+		result->frame_p50[i] = frame_times_summarize(&repetition).p50;
+		result->draw_calls = render_stats_latest().draw_calls;
+	}
+	return true;
+}
+
+static void bench_free_result(BenchResult *result) {
+	frame_times_free(&result->timings.cpu);
+	frame_times_free(&result->timings.submit);
+	frame_times_free(&result->timings.gpu);
+	frame_times_free(&result->timings.frame);
+}
+
+// Reads back what bench_write_json wrote. The result file is parsed as
+// JSON and walked by key: renderer, context and, per scenario object,
+// name and frame_p50_ms. Every other value is skipped whatever its type,
+// so a key of a nested summary or a field added later can't be taken for
+// one of those. Any syntax error fails the whole file.
+
+typedef struct {
+	const char *p;
+	int depth; // of the values being skipped
+	bool failed;
+} BenchJson;
+
+static void bench_json_space(BenchJson *json) {
+	while (*json->p == ' ' || *json->p == '\n' || *json->p == '\r' || *json->p == '\t') ++json->p;
+}
+
+// consumes c if it comes next
+static bool bench_json_accept(BenchJson *json, char c) {
+	bench_json_space(json);
+	if (*json->p != c) return false;
+	++json->p;
+	return true;
+}
+
+static void bench_json_expect(BenchJson *json, char c) {
+	if (!json->failed && !bench_json_accept(json, c)) json->failed = true;
+}
+
+// out may be NULL to skip the string, \u escapes outside ASCII become '?'
+static void bench_json_string(BenchJson *json, char *out, size_t size) {
+	size_t length = 0;
+	bench_json_expect(json, '"');
+	while (!json->failed && *json->p != '"') {
+		char c = *json->p++;
+		if (c == '\0') {
+			json->failed = true;
+			break;
+		}
+		if (c == '\\') {
+			c = *json->p++;
+			switch (c) {
+			case '"': case '\\': case '/': break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case 'u': {
+				unsigned value = 0;
+				for (int i = 0; i < 4 && !json->failed; ++i, ++json->p) {
+					char h = *json->p;
+					if (h >= '0' && h <= '9')      value = value * 16 + (unsigned)(h - '0');
+					else if (h >= 'a' && h <= 'f') value = value * 16 + (unsigned)(h - 'a' + 10);
+					else if (h >= 'A' && h <= 'F') value = value * 16 + (unsigned)(h - 'A' + 10);
+					else json->failed = true;
+				}
+				c = value < 0x80 ? (char)value : '?';
+				break;
+			}
+			default: json->failed = true; break;
+			}
+		}
+		if (out != NULL && length + 1 < size) out[length++] = c;
+	}
+	if (!json->failed) ++json->p;
+	if (out != NULL && size > 0) out[length] = '\0';
+}
+
+static double bench_json_number(BenchJson *json) {
+	if (json->failed) return 0.0;
+	bench_json_space(json);
+	char *end = NULL;
+	double value = strtod(json->p, &end);
+	if (end == json->p) json->failed = true;
+	json->p = end;
+	return value;
+}
+
+// a member's key and the colon after it
+static void bench_json_key(BenchJson *json, char *key, size_t size) {
+	bench_json_string(json, key, size);
+	bench_json_expect(json, ':');
+}
+
+// Call in a loop after the opening bracket of an object or array, index
+// starting at 0. True while there's another element, false once close
+// was consumed or on an error.
+static bool bench_json_next(BenchJson *json, char close, size_t *index) {
+	if (json->failed || bench_json_accept(json, close)) return false;
+	if (*index > 0) bench_json_expect(json, ',');
+	*index += 1;
+	return !json->failed;
+}
+
+static void bench_json_skip(BenchJson *json) {
+	if (json->failed) return;
+	bench_json_space(json);
+	char c = *json->p;
+	if (c == '"') {
+		bench_json_string(json, NULL, 0);
+	} else if (c == '{' || c == '[') {
+		if (json->depth == BENCH_JSON_MAX_DEPTH) {
+			json->failed = true;
+			return;
+		}
+		json->depth += 1;
+		++json->p;
+		for (size_t i = 0; bench_json_next(json, c == '{' ? '}' : ']', &i); ) {
+			if (c == '{') {
+				char key[BENCH_JSON_KEY_SIZE];
+				bench_json_key(json, key, sizeof(key));
+			}
+			bench_json_skip(json);
+		}
+		json->depth -= 1;
+	} else if (strncmp(json->p, "true", 4) == 0 || strncmp(json->p, "null", 4) == 0) {
+		json->p += 4;
+	} else if (strncmp(json->p, "false", 5) == 0) {
+		json->p += 5;
+	} else {
+		bench_json_number(json);
+	}
+}
+
+// one element of "scenarios", past SCENARIO_MAX they're skipped
+static void bench_baseline_scenario(BenchJson *json, Baseline *baseline) {
+	if (baseline->count == SCENARIO_MAX) {
+		bench_json_skip(json);
+		return;
+	}
+	BaselineEntry *entry = &baseline->entries[baseline->count];
+	entry->count = 0;
+	bool named = false, timed = false;
+	bench_json_expect(json, '{');
+	for (size_t i = 0; bench_json_next(json, '}', &i); ) {
+		char key[BENCH_JSON_KEY_SIZE];
+		bench_json_key(json, key, sizeof(key));
+		if (strcmp(key, "name") == 0) {
+			bench_json_string(json, entry->name, sizeof(entry->name));
+			named = true;
+		} else if (strcmp(key, "frame_p50_ms") == 0) {
+			bench_json_expect(json, '[');
+			for (size_t j = 0; bench_json_next(json, ']', &j); ) {
+				double value = bench_json_number(json);
+				if (entry->count < SCENARIO_MAX_REPETITIONS) entry->frame_p50[entry->count++] = value;
+			}
+			timed = true;
+		} else {
+			bench_json_skip(json);
+		}
+	}
+	if (!named || !timed) json->failed = true;
+	baseline->count += 1;
+}
+
+bool bench_baseline_load(const char *path, Baseline *baseline) {
+	baseline->count = 0;
+	baseline->renderer[0] = '\0';
+	baseline->context[0] = '\0';
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *text = read_entire_file_arena(path, scratch);
+	if (text == NULL) {
+		log_error("failed to read file `%s`: %s", path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	BenchJson json = { .p = text };
+	bool has_renderer = false, has_scenarios = false;
+	bench_json_expect(&json, '{');
+	for (size_t i = 0; bench_json_next(&json, '}', &i); ) {
+		char key[BENCH_JSON_KEY_SIZE];
+		bench_json_key(&json, key, sizeof(key));
+		if (strcmp(key, "renderer") == 0) {
+			bench_json_string(&json, baseline->renderer, sizeof(baseline->renderer));
+			has_renderer = true;
+		} else if (strcmp(key, "context") == 0) {
+			bench_json_string(&json, baseline->context, sizeof(baseline->context));
+		} else if (strcmp(key, "scenarios") == 0) {
+			bench_json_expect(&json, '[');
+			for (size_t j = 0; bench_json_next(&json, ']', &j); ) {
+				bench_baseline_scenario(&json, baseline);
+			}
+			has_scenarios = true;
+		} else {
+			bench_json_skip(&json);
+		}
+	}
+	bench_json_space(&json);
+	bool ok = !json.failed && *json.p == '\0' && has_renderer && has_scenarios;
+
+	if (!ok) {
+		log_error("`%s` is not a benchmark result file", path);
+	}
+	arena_rewind(scratch, mark);
+	return ok;
+}
+
+static const BaselineEntry *bench_baseline_find(const Baseline *baseline, const char *name) {
+	for (size_t i = 0; i < baseline->count; ++i) {
+		if (strcmp(baseline->entries[i].name, name) == 0) {
+			return &baseline->entries[i];
+		}
+	}
+	return NULL;
+}
+
+static void bench_compare(const Scenario *scenario, BenchResult *result, const BaselineEntry *entry,
+						  double alpha, double threshold) {
+	result->verdict = BENCH_VERDICT_NONE;
+	if (entry == NULL || entry->count < 2) {
+		return;
+	}
+
+	double t = 0.0;
+	result->p_value = welch_t_test(entry->frame_p50, entry->count, result->frame_p50, scenario->repetitions, &t);
+	result->baseline_mean = mean(entry->frame_p50, entry->count);
+	double current_mean = mean(result->frame_p50, scenario->repetitions);
+	result->change = result->baseline_mean > 0.0 ? current_mean / result->baseline_mean - 1.0 : 0.0;
+
+	if (result->p_value >= alpha) {
+		result->verdict = BENCH_VERDICT_SAME;
+	} else if (result->change < 0.0) {
+		result->verdict = BENCH_VERDICT_FASTER;
+	} else if (result->change * 100.0 > threshold) {
+		result->verdict = BENCH_VERDICT_REGRESSION;
+	} else {
+		result->verdict = BENCH_VERDICT_SLOWER;
+	}
+}
+
+static void bench_write_json_string(FILE *file, const char *s) {
+	fputc('"', file);
+	for (; *s != '\0'; ++s) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(file, "\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			fprintf(file, "\\u%04x", *s);
+		} else {
+			fputc(*s, file);
+		}
+	}
+	fputc('"', file);
+}
+
+static void bench_write_json_summary(FILE *file, const char *key, FrameTimeSummary s) {
+	fprintf(file, "      \"%s\": { \"samples\": %zu, \"mean\": %.6f, \"min\": %.6f, \"p50\": %.6f, "
+			"\"p90\": %.6f, \"p95\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+			key, s.count, s.mean, s.min, s.p50, s.p90, s.p95, s.p99, s.max);
+}
+
+// CPU time per draw call, the whole frame or only the GL submission
+static double bench_us_per_draw(const BenchResult *result, const FrameTimes *times) {
+	double ms = frame_times_summarize(times).mean;
+	return result->draw_calls ? ms * 1000.0 / result->draw_calls : 0.0;
+}
+
+// where context modes differ
+static double bench_cpu_us_per_draw(const BenchResult *result) {
+	return bench_us_per_draw(result, &result->timings.cpu);
+}
+
+// where the ways of submitting differ
+static double bench_submit_us_per_draw(const BenchResult *result) {
+	return bench_us_per_draw(result, &result->timings.submit);
+}
+
+bool bench_write_json(const char *path, const Scenarios *scenarios, const BenchResult *results) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		log_error("could not open `%s` for writing: %s", path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	fprintf(file, "{\n  \"renderer\": ");
+	bench_write_json_string(file, (const char *)glGetString(GL_RENDERER));
+	fprintf(file, ",\n  \"version\": ");
+	bench_write_json_string(file, (const char *)glGetString(GL_VERSION));
+	fprintf(file, ",\n  \"context\": \"%s\"", context_mode_names[gl_ext_context_mode()]);
+	fprintf(file, ",\n  \"width\": %d,\n  \"height\": %d,\n  \"scenarios\": [\n", BENCH_WIDTH, BENCH_HEIGHT);
+
+	for (size_t i = 0; i < scenarios->count; ++i) {
+		const Scenario *scenario = &scenarios->items[i];
+		const BenchResult *result = &results[i];
+		char features[64];
+		scenario_features_string(scenario->features, features, sizeof(features));
+
+		fprintf(file, "    {\n      \"name\": \"%s\",\n", scenario->name);
+		fprintf(file, "      \"objects\": %zu,\n      \"mesh\": \"%s\",\n      \"camera\": \"%s\",\n      \"features\": \"%s\",\n",
+				scenario->objects, scene_mesh_names[scenario->mesh], scene_camera_names[scenario->camera], features);
+		fprintf(file, "      \"submit\": \"%s\",\n", scene_submit_names[scenario->submit]);
+		fprintf(file, "      \"frames\": %d,\n      \"warmup\": %d,\n      \"repetitions\": %d,\n",
+				scenario->frames, scenario->warmup, scenario->repetitions);
+
+		fprintf(file, "      \"frame_p50_ms\": [");
+		for (int j = 0; j < scenario->repetitions; ++j) {
+			fprintf(file, "%s%.6f", j ? ", " : "", result->frame_p50[j]);
+		}
+		fprintf(file, "],\n");
+		fprintf(file, "      \"draw_calls\": %u,\n      \"cpu_us_per_draw\": %.6f,\n      \"submit_us_per_draw\": %.6f,\n",
+				result->draw_calls, bench_cpu_us_per_draw(result), bench_submit_us_per_draw(result));
+
+		bench_write_json_summary(file, "cpu_ms", frame_times_summarize(&result->timings.cpu));
+		fprintf(file, ",\n");
+		bench_write_json_summary(file, "submit_ms", frame_times_summarize(&result->timings.submit));
+		fprintf(file, ",\n");
+		bench_write_json_summary(file, "gpu_ms", frame_times_summarize(&result->timings.gpu));
+		fprintf(file, ",\n");
+		bench_write_json_summary(file, "frame_ms", frame_times_summarize(&result->timings.frame));
+
+		if (result->verdict != BENCH_VERDICT_NONE) {
+			fprintf(file, ",\n      \"baseline_frame_p50_ms\": %.6f,\n      \"change\": %.6f,\n      \"p_value\": %.6g",
+					result->baseline_mean, result->change, result->p_value);
+		}
+		fprintf(file, ",\n      \"verdict\": \"%s\"\n    }%s\n",
+				bench_verdict_names[result->verdict], i + 1 < scenarios->count ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		log_error("could not write `%s`", path);
+	}
+	return ok;
+}
+
+static void bench_print(const Scenarios *scenarios, const BenchResult *results) {
+	printf("%-20s %8s %10s %10s %8s %10s %12s %14s  %s\n", "scenario", "objects", "baseline", "p50 ms", "change", "p",
+		   "cpu/draw us", "submit/draw us", "verdict");
+	for (size_t i = 0; i < scenarios->count; ++i) {
+		const Scenario *scenario = &scenarios->items[i];
+		const BenchResult *result = &results[i];
+		double current = mean(result->frame_p50, scenario->repetitions);
+		if (result->verdict == BENCH_VERDICT_NONE) {
+			printf("%-20s %8zu %10s %10.3f %8s %10s %12.3f %14.3f  %s\n", scenario->name, scenario->objects,
+				   "-", current, "-", "-", bench_cpu_us_per_draw(result), bench_submit_us_per_draw(result),
+				   bench_verdict_names[result->verdict]);
+		} else {
+			printf("%-20s %8zu %10.3f %10.3f %+7.1f%% %10.2g %12.3f %14.3f  %s\n", scenario->name, scenario->objects,
+				   result->baseline_mean, current, result->change * 100.0, result->p_value,
+				   bench_cpu_us_per_draw(result), bench_submit_us_per_draw(result), bench_verdict_names[result->verdict]);
+		}
+	}
+}
+
+void usage(const char *program) {
+	fprintf(stderr, "usage: %s [--scenarios FILE] [--out FILE] [--baseline FILE] [--alpha P] [--threshold PERCENT]"
+			" [--context release|default|debug]\n", program);
+}
+
+int main(int argc, char **argv) {
+	const char *scenarios_path = BENCH_DEFAULT_SCENARIOS;
+	const char *output_path = BENCH_DEFAULT_OUTPUT;
+	const char *baseline_path = NULL;
+	double alpha = BENCH_DEFAULT_ALPHA;
+	double threshold = BENCH_DEFAULT_THRESHOLD;
+	ContextMode context_mode = CONTEXT_MODE_RELEASE;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		char *end = NULL;
+		if (strcmp(argv[i], "--scenarios") == 0 && value) {
+			scenarios_path = argv[++i];
+		} else if (strcmp(argv[i], "--out") == 0 && value) {
+			output_path = argv[++i];
+		} else if (strcmp(argv[i], "--baseline") == 0 && value) {
+			baseline_path = argv[++i];
+		} else if (strcmp(argv[i], "--alpha") == 0 && value && (alpha = strtod(value, &end), *end == '\0') && alpha > 0.0 && alpha < 1.0) {
+			++i;
+		} else if (strcmp(argv[i], "--threshold") == 0 && value && (threshold = strtod(value, &end), *end == '\0') && threshold >= 0.0) {
+			++i;
+		} else if (strcmp(argv[i], "--context") == 0 && value) {
+			int mode = 0;
+			while (mode < CONTEXT_MODE_COUNT && strcmp(value, context_mode_names[mode]) != 0) ++mode;
+			if (mode == CONTEXT_MODE_COUNT) {
+				usage(argv[0]);
+				return 1;
+			}
+			context_mode = mode;
+			++i;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	log_init();
+	if (!jobs_init(0)) {
+		return 1;
+	}
+	static Scenarios scenarios;
+	if (!scenarios_load(scenarios_path, &scenarios)) {
+		return 1;
+	}
+	static Baseline baseline;
+	if (baseline_path != NULL && !bench_baseline_load(baseline_path, &baseline)) {
+		return 1;
+	}
+
+	static Headless headless;
+	if (!headless_init(&headless, BENCH_WIDTH, BENCH_HEIGHT, context_mode)) {
+		log_error("could not create a headless context.");
+		headless_destroy(&headless);
+		return 1;
+	}
+
+	const char *renderer = (const char *)glGetString(GL_RENDERER);
+	printf("OpenGL renderer: %s\n", renderer);
+	printf("OpenGL version:  %s\n", glGetString(GL_VERSION));
+	const char *context = context_mode_names[gl_ext_context_mode()];
+	printf("OpenGL context:  %s\n", context);
+	if (context_mode != gl_ext_context_mode()) {
+		log_warning("asked for a %s context, the driver gave a %s one", context_mode_names[context_mode], context);
+	}
+	if (baseline_path != NULL && strcmp(baseline.renderer, renderer) != 0) {
+		log_warning("baseline was recorded on `%s`, comparing anyway", baseline.renderer);
+	}
+	if (baseline_path != NULL && baseline.context[0] != '\0' && strcmp(baseline.context, context) != 0) {
+		log_warning("baseline was recorded with a %s context, comparing anyway", baseline.context);
+	}
+
+	shader_cache_init(SHADER_CACHE_DIR);
+	shader_batch_init();
+	shader_variant_prewarm_manifest(SHADER_MANIFEST);
+
+	static Scene scene;
+	scene_init(&scene, (float)BENCH_WIDTH/(float)BENCH_HEIGHT);
+
+	static BenchResult results[SCENARIO_MAX];
+	bool ok = true;
+	bool regressed = false;
+	for (size_t i = 0; ok && i < scenarios.count; ++i) {
+		const Scenario *scenario = &scenarios.items[i];
+		printf("running %s...\n", scenario->name);
+		fflush(stdout);
+		ok = bench_run_scenario(&headless, &scene, scenario, &results[i]);
+		if (ok) {
+			bench_compare(scenario, &results[i], bench_baseline_find(&baseline, scenario->name), alpha, threshold);
+			regressed = regressed || results[i].verdict == BENCH_VERDICT_REGRESSION;
+		}
+	}
+
+	if (ok) {
+		bench_print(&scenarios, results);
+		ok = bench_write_json(output_path, &scenarios, results);
+	}
+
+	for (size_t i = 0; i < scenarios.count; ++i) {
+		bench_free_result(&results[i]);
+	}
+	scene_destroy(&scene);
+	mesh_heap_shutdown();
+	retire_shutdown();
+	headless_destroy(&headless);
+	jobs_shutdown();
+
+	if (!ok) {
+		return 1;
+	}
+	return regressed ? BENCH_EXIT_REGRESSION : 0;
+}
+
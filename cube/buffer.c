@@ -0,0 +1,124 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "glad.h"
+
+// GL buffers behind BufferHandles, see pool.c.
+// Binding and drawing only need the name and the size, those are the hot
+// part. The usage is only read to respecify, the label to tell buffers
+// apart when debugging.
+// Destroyed buffers go through the destruction queue, see retire.c, and
+// new ones reuse what it recycled when size and usage match. Their memory
+// is accounted by what they're bound to at creation unless the owner says
+// otherwise, see gpu_memory.c.
+
+#define BUFFER_MAX 1024
+
+typedef uint32_t BufferHandle; // 0 is never a valid handle
+
+typedef struct {
+	GLuint name;
+	GLsizeiptr size;
+} BufferHot;
+
+typedef struct {
+	GLenum usage;
+	GpuMemoryCategory category;
+	const char *label; // not owned, must outlive the buffer
+} BufferCold;
+
+static struct {
+	HandlePool pool;
+	BufferHot hot[BUFFER_MAX];
+	BufferCold cold[BUFFER_MAX];
+} buffers = { .pool = POOL_INIT("buffers", BUFFER_MAX) };
+
+static GpuMemoryCategory buffer_category(GLenum target) {
+	switch (target) {
+	case GL_ELEMENT_ARRAY_BUFFER: return GPU_MEMORY_INDEX;
+	case GL_UNIFORM_BUFFER:       return GPU_MEMORY_UNIFORM;
+	default:                      return GPU_MEMORY_VERTEX;
+	}
+}
+
+// Creates a buffer of size bytes, bound to target afterwards. data may be
+// NULL to leave it undefined.
+BufferHandle buffer_create(GLenum target, GLsizeiptr size, const void *data, GLenum usage, const char *label) {
+	uint32_t position = 0;
+	BufferHandle handle = pool_acquire(&buffers.pool, &position);
+	if (handle == 0) {
+		return 0;
+	}
+	BufferHot *hot = &buffers.hot[position];
+	*hot = (BufferHot){ .size = size };
+	GpuMemoryCategory category = buffer_category(target);
+	buffers.cold[position] = (BufferCold){ .usage = usage, .category = category, .label = label };
+	hot->name = retire_take_buffer(size, usage);
+	if (hot->name != 0) {
+		// the storage is already the right size, only the data goes up
+		gpu_memory_move(GPU_MEMORY_RECYCLED, category, size);
+		render_bind_buffer(target, hot->name);
+		if (data != NULL) {
+			render_buffer_sub_data(target, 0, size, data);
+		}
+		return handle;
+	}
+	glGenBuffers(1, &hot->name);
+	render_bind_buffer(target, hot->name);
+	render_buffer_data(target, size, data, usage);
+	gpu_memory_alloc(category, size);
+	return handle;
+}
+
+// NULL once the buffer was destroyed
+const BufferHot *buffer_get(BufferHandle handle) {
+	uint32_t position = 0;
+	return pool_find(&buffers.pool, handle, &position) ? &buffers.hot[position] : NULL;
+}
+
+// 0 once the buffer was destroyed
+GLuint buffer_name(BufferHandle handle) {
+	const BufferHot *hot = buffer_get(handle);
+	return hot ? hot->name : 0;
+}
+
+// counts the buffer's memory as category from now on
+void buffer_set_category(BufferHandle handle, GpuMemoryCategory category) {
+	uint32_t position = 0;
+	if (pool_find(&buffers.pool, handle, &position)) {
+		gpu_memory_move(buffers.cold[position].category, category, buffers.hot[position].size);
+		buffers.cold[position].category = category;
+	}
+}
+
+// Binds the buffer to target and gives it new storage of size bytes, the
+// GPU may still read the old storage, it's orphaned rather than waited on.
+bool buffer_respecify(BufferHandle handle, GLenum target, GLsizeiptr size, const void *data) {
+	uint32_t position = 0;
+	if (!pool_find(&buffers.pool, handle, &position)) {
+		return false;
+	}
+	BufferHot *hot = &buffers.hot[position];
+	const BufferCold *cold = &buffers.cold[position];
+	render_bind_buffer(target, hot->name);
+	render_buffer_data(target, size, data, cold->usage);
+	gpu_memory_free(cold->category, hot->size);
+	gpu_memory_alloc(cold->category, size);
+	hot->size = size;
+	return true;
+}
+
+void buffer_destroy(BufferHandle handle) {
+	uint32_t position = 0;
+	if (!pool_find(&buffers.pool, handle, &position)) {
+		log_error("destroyed stale buffer handle %08x", handle);
+		return;
+	}
+	// the GPU may still read it, it's deleted or recycled once it's done
+	render_state_forget_buffer(buffers.hot[position].name);
+	gpu_memory_move(buffers.cold[position].category, GPU_MEMORY_RETIRING, buffers.hot[position].size);
+	retire_buffer(buffers.hot[position].name, buffers.hot[position].size, buffers.cold[position].usage);
+	uint32_t to = 0, from = 0;
+	pool_release(&buffers.pool, handle, &to, &from);
+	buffers.hot[to] = buffers.hot[from];
+	buffers.cold[to] = buffers.cold[from];
+}
@@ -0,0 +1,256 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "glad.h"
+
+// Command lists.
+// Working out a frame's draws needs no GL, only the order of binds and
+// draws and the uniform data that goes with them, so any thread records
+// that into a command list and the GL thread replays the lists in order.
+// A list is an array of fixed size commands plus the list's own uniform
+// bytes, commands refer to those by offset. Programs are named by shader
+// family and features and meshes by handle, never by GL object, so
+// recording doesn't depend on what the GL thread has compiled yet.
+// Replaying uploads the uniforms of every list into one orphaned buffer,
+// then decodes the commands in a single switch.
+// A list takes its memory from an arena when recording begins, the
+// recorder says how many commands and uniform bytes it will need. Going
+// over that drops the list instead of growing it.
+
+typedef enum {
+	COMMAND_BIND_PROGRAM = 0,
+	COMMAND_UNIFORM_BLOCK, // points a block of the bound program at a binding
+	COMMAND_BIND_UNIFORMS, // a range of the list's uniforms at a binding
+	COMMAND_UNIFORM_V3,
+	COMMAND_BIND_MESH,
+	COMMAND_DRAW,
+} CommandType;
+
+typedef struct {
+	CommandType type;
+	union {
+		struct { ShaderFamily family; uint32_t features; } program;
+		struct { uint32_t name; uint32_t binding; } block;     // name hash
+		struct { uint32_t binding, offset, size; } uniforms;
+		struct { uint32_t name; V3f value; } v3;               // name hash
+		MeshHandle mesh;
+		struct { uint32_t count, first; } draw;                // indices
+	};
+} Command;
+
+typedef struct {
+	Command *commands;
+	size_t count, capacity;
+	unsigned char *uniforms;
+	size_t uniforms_size, uniforms_capacity;
+	bool overflowed; // more was recorded than begun for, the list misses commands
+} CommandList;
+
+static struct {
+	size_t alignment; // of uniform ranges, from GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	BufferHandle buffer;
+	size_t capacity;
+} command_replay = { .alignment = 256 };
+
+static size_t command_align(size_t offset) {
+	return (offset + command_replay.alignment - 1) / command_replay.alignment * command_replay.alignment;
+}
+
+// on the GL thread before anything is recorded, offsets depend on the alignment
+void command_replay_init(void) {
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) {
+		command_replay.alignment = (size_t)alignment;
+	}
+	command_replay.buffer = buffer_create(GL_UNIFORM_BUFFER, 0, NULL, GL_STREAM_DRAW, "command uniforms");
+}
+
+// what size bytes of uniforms take up in a list, ranges start aligned
+size_t command_uniform_stride(size_t size) {
+	return command_align(size);
+}
+
+// Empties the list and takes room for it from arena, which has to outlive
+// the replay. uniforms_size is the sum of the command_uniform_stride of
+// every command_list_alloc_uniforms.
+void command_list_begin(CommandList *list, Arena *arena, size_t commands, size_t uniforms_size) {
+	*list = (CommandList){0};
+	if (arena == NULL) {
+		list->overflowed = true;
+		return;
+	}
+	list->commands = arena_alloc_array(arena, Command, commands);
+	list->uniforms = uniforms_size ? arena_alloc(arena, uniforms_size, ARENA_ALIGN) : NULL;
+	if (list->commands == NULL || (uniforms_size && list->uniforms == NULL)) {
+		list->overflowed = true;
+		return;
+	}
+	list->capacity = commands;
+	list->uniforms_capacity = uniforms_size;
+}
+
+static Command *command_list_push(CommandList *list, CommandType type) {
+	if (list->count == list->capacity) {
+		list->overflowed = true;
+		return NULL;
+	}
+	Command *command = &list->commands[list->count++];
+	command->type = type;
+	return command;
+}
+
+// Room for size bytes of uniforms at an offset a range can start at,
+// fill it in and bind it with command_bind_uniforms. NULL once the list
+// is out of the room it began with.
+void *command_list_alloc_uniforms(CommandList *list, size_t size, uint32_t *offset) {
+	size_t start = command_align(list->uniforms_size);
+	if (start + size > list->uniforms_capacity) {
+		list->overflowed = true;
+		return NULL;
+	}
+	list->uniforms_size = start + size;
+	*offset = (uint32_t)start;
+	return list->uniforms + start;
+}
+
+void command_bind_program(CommandList *list, ShaderFamily family, uint32_t features) {
+	Command *command = command_list_push(list, COMMAND_BIND_PROGRAM);
+	if (command != NULL) {
+		command->program.family = family;
+		command->program.features = features;
+	}
+}
+
+void command_uniform_block(CommandList *list, uint32_t name_hash, uint32_t binding) {
+	Command *command = command_list_push(list, COMMAND_UNIFORM_BLOCK);
+	if (command != NULL) {
+		command->block.name = name_hash;
+		command->block.binding = binding;
+	}
+}
+
+void command_bind_uniforms(CommandList *list, uint32_t binding, uint32_t offset, uint32_t size) {
+	Command *command = command_list_push(list, COMMAND_BIND_UNIFORMS);
+	if (command != NULL) {
+		command->uniforms.binding = binding;
+		command->uniforms.offset = offset;
+		command->uniforms.size = size;
+	}
+}
+
+void command_uniform_v3(CommandList *list, uint32_t name_hash, V3f value) {
+	Command *command = command_list_push(list, COMMAND_UNIFORM_V3);
+	if (command != NULL) {
+		command->v3.name = name_hash;
+		command->v3.value = value;
+	}
+}
+
+void command_bind_mesh(CommandList *list, MeshHandle mesh) {
+	Command *command = command_list_push(list, COMMAND_BIND_MESH);
+	if (command != NULL) {
+		command->mesh = mesh;
+	}
+}
+
+void command_draw(CommandList *list, uint32_t count, uint32_t first) {
+	Command *command = command_list_push(list, COMMAND_DRAW);
+	if (command != NULL) {
+		command->draw.count = count;
+		command->draw.first = first;
+	}
+}
+
+// Runs the lists in order on the GL thread, state carries over from one
+// list to the next. Draws are skipped while the bound program isn't
+// compiled yet and after binding a destroyed mesh. Returns false if a list
+// overflowed and was skipped.
+bool command_lists_replay(const CommandList *lists, size_t count) {
+	PROFILE_ZONE("command_replay");
+	bool ok = true;
+
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i) {
+		total = command_align(total) + lists[i].uniforms_size;
+	}
+	GLuint buffer = buffer_name(command_replay.buffer);
+	if (total > 0) {
+		if (total > command_replay.capacity) {
+			command_replay.capacity = total * 2;
+		}
+		// orphaned, the GPU may still read last frame's uniforms
+		buffer_respecify(command_replay.buffer, GL_UNIFORM_BUFFER, command_replay.capacity, NULL);
+	}
+	size_t base = 0;
+	for (size_t i = 0; i < count; ++i) {
+		base = command_align(base);
+		if (lists[i].uniforms_size > 0) {
+			render_buffer_sub_data(GL_UNIFORM_BUFFER, base, lists[i].uniforms_size, lists[i].uniforms);
+		}
+		base += lists[i].uniforms_size;
+	}
+
+	GLuint program = 0;
+	const ProgramReflection *reflection = NULL;
+	const MeshHot *mesh = NULL;
+	base = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const CommandList *list = &lists[i];
+		base = command_align(base);
+		if (list->overflowed) {
+			ok = false;
+			base += list->uniforms_size;
+			continue;
+		}
+		for (const Command *command = list->commands, *end = command + list->count; command != end; ++command) {
+			if (program == 0 && command->type != COMMAND_BIND_PROGRAM) {
+				continue;
+			}
+			switch (command->type) {
+			case COMMAND_BIND_PROGRAM: {
+				ProgramHandle handle = shader_variant_get(command->program.family, command->program.features);
+				program = shader_batch_program(handle);
+				reflection = shader_batch_reflection(handle);
+				if (program != 0) {
+					render_use_program(program);
+				}
+			} break;
+			case COMMAND_UNIFORM_BLOCK: {
+				const ShaderReflectEntry *block = shader_reflect_find(reflection, command->block.name);
+				if (block != NULL && block->kind == SHADER_REFLECT_BLOCK) {
+					glUniformBlockBinding(program, block->block_index, command->block.binding);
+				}
+			} break;
+			case COMMAND_BIND_UNIFORMS:
+				glBindBufferRange(GL_UNIFORM_BUFFER, command->uniforms.binding, buffer,
+								  base + command->uniforms.offset, command->uniforms.size);
+				break;
+			case COMMAND_UNIFORM_V3:
+				glUniform3f(shader_reflect_location(reflection, command->v3.name),
+							command->v3.value.x, command->v3.value.y, command->v3.value.z);
+				break;
+			case COMMAND_BIND_MESH:
+				mesh = mesh_use(command->mesh);
+				if (mesh != NULL) {
+					render_bind_vertex_array(mesh->vao);
+				}
+				break;
+			case COMMAND_DRAW:
+				if (mesh == NULL) {
+					break;
+				}
+				// first counts from the mesh's own indices
+				render_draw_elements_base_vertex(GL_TRIANGLES, command->draw.count, GL_UNSIGNED_INT,
+												 (const void *)((size_t)(mesh->first_index + command->draw.first) * sizeof(Index)),
+												 mesh->base_vertex);
+				break;
+			}
+		}
+		base += list->uniforms_size;
+	}
+	if (!ok) {
+		log_error("a command list recorded more than it began for, its draws were dropped");
+	}
+	return ok;
+}
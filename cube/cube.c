@@ -1,10 +1,46 @@
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 
+#include "hash.c"
+#include "log.c"
 #include "math.c"
+#include "profiler.c"
+#include "jobs.c"
+#include "arena.c"
+#include "alloc_track.c"
+#include "pool.c"
+#include "render_stats.c"
+#include "gpu_memory.c"
+#include "retire.c"
+#include "buffer.c"
+#include "tlsf.c"
+#include "mesh_heap.c"
+#include "mesh.c"
 #include "shader.c"
+#include "shader_cache.c"
+#include "shader_reflect.c"
+#include "shader_batch.c"
+#include "shader_preprocess.c"
+#include "hot_reload.c"
+#include "shader_variant.c"
+#include "command_list.c"
+#include "gpu_profiler.c"
+#include "pipeline_stats.c"
+#include "input.c"
+#include "overdraw.c"
+#include "scene.c"
+#include "frame_stats.c"
+#include "timestep.c"
+#include "pacing.c"
+#include "frame_queue.c"
+#include "hud.c"
+#include "headless.c"
 
 #define GLAD_GL_IMPLEMENTATION
 #include "glad.h"
@@ -14,313 +50,667 @@
 
 #define SCREEN_WIDTH  800
 #define SCREEN_HEIGHT 600
-#define ENABLE_VSYNC 1
-
-static double global_scroll_y;
-
-void draw_mesh(Mesh* mesh, Transform* transform, Camera* camera) {
-	M4f model = calculate_transform_matrix(transform);
-	M4f mvp = m4f_mul_m4f(camera->view_projection_matrix, model);
-
-	glBindVertexArray(mesh->vao);
-	glUniformMatrix4fv(mesh->loc_mvp,   1, GL_TRUE, &mvp.m[0][0]);
-	glUniformMatrix4fv(mesh->loc_model, 1, GL_TRUE, &model.m[0][0]);
-	glUniform3f(mesh->loc_color, 0.8f, 0.2f, 0.2f);
-	glUniform3f(mesh->loc_light_dir, -0.5f, -1.0f, -0.5f);
-
-	glDrawElements(GL_TRIANGLES, mesh->indices_count, GL_UNSIGNED_INT, 0);
-	//glDrawElements(GL_POINTS, mesh.indices_count, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-}
-
-Mesh cube_generate_mesh() {
-	static const Vertex vertices[24] = {
-		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
-		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
-		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
-		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
-
-		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
-		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
-		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
-		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
-
-		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
-		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
-		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
-		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
-
-		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
-		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
-		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
-		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
-
-		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
-		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
-		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
-		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
-
-		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
-		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
-		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
-		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = { 0.0f, -1.0f,  0.0f} }
-	};
-	static const Index indices[36] = {
-		0,  1,  2,   0,  2,  3,
-		4,  6,  5,   4,  7,  6,
-		8,  9, 10,   8, 10, 11,
-		12, 14, 13,  12, 15, 14,
-		16, 18, 17,  16, 19, 18,
-		20, 21, 22,  20, 22, 23
-	};
-	Mesh cube_mesh = {0};
-	cube_mesh.vertices = (Vertex*)vertices;
-	cube_mesh.indices = (Index*)indices;
-	cube_mesh.vertices_count = sizeof(vertices) / sizeof(Vertex);
-	cube_mesh.indices_count = sizeof(indices) / sizeof(Index);
-	return cube_mesh;
-}
-
-void mesh_init(Mesh* mesh, GLuint program) {
-	glGenVertexArrays(1, &mesh->vao);
-	glBindVertexArray(mesh->vao);
-
-	glGenBuffers(1, &mesh->vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-	glBufferData(GL_ARRAY_BUFFER, mesh->vertices_count * sizeof(Vertex), mesh->vertices, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &mesh->ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices_count * sizeof(Index), mesh->indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
-	mesh->loc_mvp   = glGetUniformLocation(program, "u_mvp");
-	mesh->loc_model = glGetUniformLocation(program, "u_model");
-	mesh->loc_color = glGetUniformLocation(program, "u_color");
-	mesh->loc_light_dir = glGetUniformLocation(program, "u_light_dir");
-}
-
-
+#define MOUSE_SENSITIVITY 0.002f
+// 1 for a debug context wired to message_callback, 0 for a release context
+// that asks for KHR_no_error, `make cube-debug` builds the former
+#ifndef ENABLE_GL_DEBUG
+#define ENABLE_GL_DEBUG 0
+#endif
+#define CONTEXT_MODE (ENABLE_GL_DEBUG ? CONTEXT_MODE_DEBUG : CONTEXT_MODE_RELEASE)
+#define SHADER_CACHE_DIR "shader_cache"
+#define SHADER_MANIFEST "shaders.manifest"
+#define HEADLESS_DEFAULT_FRAMES 1000
+#define HEADLESS_WARMUP_FRAMES  30
+
+static uint32_t global_shader_features = SHADER_FEATURE_LIGHTING;
+static bool global_pipeline_stats;
+static bool global_overdraw;
+static bool global_hud;
+static PacingMode global_pacing_mode = PACING_VSYNC;
+static double global_target_fps = 60.0;
+static int global_frames_in_flight = 2;
+static bool global_render_thread = true;
+static int global_job_threads; // 0 for one per CPU
+static SceneSubmit global_submit = SCENE_SUBMIT_DIRECT;
 
 void error_callback(int error, const char* description) {
-	fprintf(stderr, "[ERROR]: %s\n", description);
+	log_error("%s", description);
 }
 
+// the callbacks only queue events, the frame loop applies them
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	input_push_key(key, action);
+}
+
+void handle_key(GLFWwindow* window, int key, int action) {
 	if (action == GLFW_PRESS) {
 		if (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_CAPS_LOCK) {
 			glfwSetWindowShouldClose(window, GL_TRUE);
 		}
+		if (key == GLFW_KEY_L) {
+			global_shader_features ^= SHADER_FEATURE_LIGHTING;
+		}
+		if (key == GLFW_KEY_F1) {
+			global_pipeline_stats = !global_pipeline_stats;
+		}
+		if (key == GLFW_KEY_F2) {
+			global_overdraw = !global_overdraw;
+		}
+		if (key == GLFW_KEY_F3) {
+			global_hud = !global_hud;
+		}
+		if (key == GLFW_KEY_F4) {
+			LogLevel level = (log_level() + 1) % LOG_LEVEL_COUNT;
+			log_set_level(level);
+			printf("log level: %s\n", log_level_names[level]);
+		}
+		if (key == GLFW_KEY_F5) {
+			global_pacing_mode = (global_pacing_mode + 1) % PACING_MODE_COUNT;
+		}
+		if (key == GLFW_KEY_F6) {
+			global_submit = (global_submit + 1) % SCENE_SUBMIT_COUNT;
+			printf("submit: %s\n", scene_submit_names[global_submit]);
+		}
 	}
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
-	global_scroll_y += yoffset;
+	input_push_scroll(xoffset, yoffset);
+}
+
+void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
+	input_push_cursor(xpos, ypos);
+}
+
+// Scene.late_latch: the mouse motion that arrived while the frame was built
+// goes into the camera before it's written into the packet, render_frame
+// adds what arrived after right before the upload
+void latch_camera(Scene *scene, void *user) {
+	(void) user;
+	glfwPollEvents();
+	double dx, dy;
+	if (input_latch_cursor(&dx, &dy)) {
+		scene_camera_rotate(scene, (float)(-dx * MOUSE_SENSITIVITY), (float)(-dy * MOUSE_SENSITIVITY));
+	}
 }
 
-void window_size_callback(GLFWwindow* window, int width, int height) {
+// on the thread that owns the context, when the framebuffer size changed
+void render_resize(int width, int height) {
+	static uint64_t texture_bytes;
 	glViewport(0, 0, width, height);
 	glActiveTexture(GL_TEXTURE1);
 	//glBindTexture(GL_TEXTURE_2D, texture);
 	glTexImage2D(GL_TEXTURE_2D, 0,
 			  GL_RGBA, width, height, 0,
 			  GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	if (texture_bytes != 0) {
+		gpu_memory_free(GPU_MEMORY_RENDER_TARGET, texture_bytes);
+	}
+	texture_bytes = (uint64_t)width * height * 4;
+	gpu_memory_alloc(GPU_MEMORY_RENDER_TARGET, texture_bytes);
+}
+
+
+// Falls back to vsync where the driver can't swap late frames immediately.
+// The pacer keeps the requested mode, F5 cycles on from that one.
+void apply_pacing(FramePacer *pacer, PacingMode requested) {
+	PacingMode mode = requested;
+	if (mode == PACING_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear")
+		&& !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+		log_warning("adaptive vsync is not supported, using vsync");
+		mode = PACING_VSYNC;
+	}
+	pacing_set_mode(pacer, requested, mode);
+	glfwSwapInterval(pacing_swap_interval(pacer));
+}
+
+// WASD walking, one fixed step's worth
+void camera_move(GLFWwindow* window, Camera* cam, float delta_time) {
+	V3f forward = { sinf(cam->transform.rotation.y), 0, cosf(cam->transform.rotation.y) };
+	V3f right = { forward.z, 0, -forward.x };
+
+	float speed = 5.0f * delta_time;
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+		cam->transform.position.x += forward.x * speed;
+		cam->transform.position.z -= forward.z * speed;
+	}
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+		cam->transform.position.x -= forward.x * speed;
+		cam->transform.position.z += forward.z * speed;
+	}
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+		cam->transform.position.x -= right.x * speed;
+		cam->transform.position.z -= right.z * speed;
+	}
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+		cam->transform.position.x += right.x * speed;
+		cam->transform.position.z += right.z * speed;
+	}
+}
+
+// Everything the GL side needs for a frame. The main thread fills one
+// while the render thread draws the one before it.
+typedef struct {
+	ScenePacket scene;
+	int width, height; // of the framebuffer
+	float frame_ms;
+	bool hud, pipeline_stats;
+	PacingMode pacing_mode;
+	LogLevel log_level;
+	double cursor_dx, cursor_dy; // the input_motion_total its camera includes
+	bool quit;
+} FramePacket;
+
+// The GL side of the windowed loop. With the render thread it owns the
+// context and is fed packets through the frame queue, so the main thread's
+// input and simulation for the next frame overlap this frame's submission.
+// Without it the main thread draws every packet itself right away.
+typedef struct {
+	GLFWwindow *window;
+	Scene *scene; // only its GL objects, the main thread owns the rest
+	FramePacer pacer;
+	LogLevel log_level;
+	bool pipeline_stats_failed;
+	int width, height;
+	double debug_print_time;
+
+	bool threaded;
+	FrameQueue queue;
+	FramePacket packets[FRAME_QUEUE_SIZE];
+	FramePacket packet; // without the thread
+	pthread_t thread;
+	atomic_bool failed;
+} Renderer;
+
+// returns false if the scene's program can't be built
+bool render_frame(Renderer *renderer, FramePacket *packet) {
+	PROFILE_ZONE("render_frame");
+
+	// F5 cycles the pacing modes, the old mode's numbers are printed first
+	if (packet->pacing_mode != renderer->pacer.requested) {
+		pacing_print(&renderer->pacer);
+		apply_pacing(&renderer->pacer, packet->pacing_mode);
+	}
+	pacing_frame_begin(&renderer->pacer);
+	render_stats_frame_begin();
+	input_latency_collect();
+
+	if (packet->width != renderer->width || packet->height != renderer->height) {
+		renderer->width = packet->width;
+		renderer->height = packet->height;
+		render_resize(packet->width, packet->height);
+	}
+	if (packet->log_level != renderer->log_level) {
+		renderer->log_level = packet->log_level;
+		gl_ext_debug_output_level(packet->log_level);
+	}
+
+	// F1 and F2 switch the debug modes, their numbers are printed once a second
+	bool stats = packet->pipeline_stats && !renderer->pipeline_stats_failed;
+	if (stats != pipeline_stats_enabled()) {
+		if (stats && !pipeline_stats.initialized && !pipeline_stats_init()) {
+			renderer->pipeline_stats_failed = true;
+			stats = false;
+		}
+		pipeline_stats_set_enabled(stats);
+	}
+	double now = glfwGetTime();
+	if ((stats || packet->scene.debug_overdraw) && now - renderer->debug_print_time >= 1.0) {
+		renderer->debug_print_time = now;
+		if (stats) pipeline_stats_print_latest();
+		if (packet->scene.debug_overdraw) overdraw_print(overdraw_latest());
+	}
+
+	gpu_profiler_frame_begin();
+	pipeline_stats_frame_begin();
+
+	PROFILE_BEGIN("shaders");
+	hot_reload_poll(shader_variant_file_changed);
+	shader_batch_poll();
+	shader_variant_update();
+	PROFILE_END();
+	ProgramHandle program = shader_variant_get(renderer->scene->shader, packet->scene.shader_features);
+	if (program == 0 || shader_batch_state(program) == PROGRAM_FAILED) {
+		log_error("could not load shader program.");
+		return false;
+	}
+
+	// the late latch of this side: mouse motion the main thread latched
+	// since it built the packet, a frame's worth with the render thread
+	double dx, dy;
+	uint64_t input_ns = input_motion_draw(&dx, &dy);
+	scene_packet_rotate(&packet->scene, (float)(-(dx - packet->cursor_dx) * MOUSE_SENSITIVITY),
+						(float)(-(dy - packet->cursor_dy) * MOUSE_SENSITIVITY));
+	scene_render_packet(renderer->scene, &packet->scene, packet->width, packet->height);
+	// F3 toggles the stats overlay
+	hud_set_enabled(packet->hud);
+	hud_render(packet->width, packet->height, packet->frame_ms);
+	pipeline_stats_frame_end();
+	gpu_profiler_frame_end();
+	input_latency_frame_end(input_ns);
+
+	pacing_limit(&renderer->pacer);
+	PROFILE_BEGIN("swap_buffers");
+	glfwSwapBuffers(renderer->window);
+	PROFILE_END();
+	pacing_frame_end(&renderer->pacer);
+	mesh_frame_end();
+	retire_frame_end();
+	return true;
 }
 
+void *render_thread_main(void *arg) {
+	Renderer *renderer = arg;
+	PROFILE_THREAD("render");
+	glfwMakeContextCurrent(renderer->window);
+	for (;;) {
+		FramePacket *packet = frame_queue_begin_read(&renderer->queue);
+		bool quit = packet->quit;
+		if (!quit && !render_frame(renderer, packet)) {
+			atomic_store(&renderer->failed, true);
+			quit = true;
+		}
+		frame_queue_end_read(&renderer->queue);
+		if (quit) {
+			break;
+		}
+	}
+	glfwMakeContextCurrent(NULL);
+	return NULL;
+}
 
-void message_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
-					  GLsizei length, const GLchar* message, const void* userParam) {
-	(void) source;
-	(void) id;
-	(void) length;
-	(void) userParam;
-	fprintf(stderr, "[message_callback]: %s type = 0x%x, severity = 0x%x, message = %s\n",
-		 (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""),
-		 type, severity, message);
+// with the context current, hands it to the render thread if threaded
+void renderer_start(Renderer *renderer, GLFWwindow *window, Scene *scene, bool threaded) {
+	renderer->window = window;
+	renderer->scene = scene;
+	// what GL's default viewport already covers
+	glfwGetFramebufferSize(window, &renderer->width, &renderer->height);
+	renderer->log_level = log_level();
+	pacing_init(&renderer->pacer, global_pacing_mode, global_target_fps, global_frames_in_flight);
+	apply_pacing(&renderer->pacer, global_pacing_mode);
+	atomic_init(&renderer->failed, false);
+
+	renderer->threaded = false;
+	if (!threaded || !frame_queue_init(&renderer->queue, renderer->packets, sizeof(FramePacket))) {
+		return;
+	}
+	glfwMakeContextCurrent(NULL);
+	int error = pthread_create(&renderer->thread, NULL, render_thread_main, renderer);
+	if (error != 0) {
+		log_warning("could not start the render thread, drawing on the main thread: %s", strerror(error));
+		frame_queue_destroy(&renderer->queue);
+		glfwMakeContextCurrent(window);
+		return;
+	}
+	renderer->threaded = true;
 }
 
+// the packet to fill for the next frame, may wait for the render thread
+FramePacket *renderer_begin_frame(Renderer *renderer) {
+	if (!renderer->threaded) {
+		return &renderer->packet;
+	}
+	return frame_queue_begin_write(&renderer->queue);
+}
 
+void renderer_end_frame(Renderer *renderer) {
+	if (!renderer->threaded) {
+		if (!render_frame(renderer, &renderer->packet)) {
+			atomic_store(&renderer->failed, true);
+		}
+		return;
+	}
+	frame_queue_end_write(&renderer->queue);
+}
+
+// Drains the queue, stops the thread and takes the context back.
+// Returns false if drawing failed.
+bool renderer_stop(Renderer *renderer) {
+	if (renderer->threaded) {
+		// a failed render thread is gone already, nobody would read the packet
+		if (!atomic_load(&renderer->failed)) {
+			FramePacket *packet = frame_queue_begin_write(&renderer->queue);
+			packet->quit = true;
+			frame_queue_end_write(&renderer->queue);
+		}
+		pthread_join(renderer->thread, NULL);
+		frame_queue_destroy(&renderer->queue);
+		glfwMakeContextCurrent(renderer->window);
+		renderer->threaded = false;
+	}
+	pacing_print(&renderer->pacer);
+	pacing_destroy(&renderer->pacer);
+	for (int i = 0; i < FRAME_QUEUE_SIZE; ++i) {
+		scene_packet_free(&renderer->packets[i].scene);
+	}
+	scene_packet_free(&renderer->packet.scene);
+	return !atomic_load(&renderer->failed);
+}
+
+int headless_main(int frames) {
+	static Headless headless;
+	if (!headless_init(&headless, SCREEN_WIDTH, SCREEN_HEIGHT, CONTEXT_MODE)) {
+		log_error("could not create a headless context.");
+		headless_destroy(&headless);
+		return 1;
+	}
+
+	printf("OpenGL renderer: %s\n", glGetString(GL_RENDERER));
+	printf("OpenGL version:  %s\n", glGetString(GL_VERSION));
+	printf("OpenGL context:  %s\n", context_mode_names[gl_ext_context_mode()]);
+	shader_cache_init(SHADER_CACHE_DIR);
+	shader_batch_init();
+	gpu_profiler_init();
+	if (global_pipeline_stats && pipeline_stats_init()) {
+		pipeline_stats_set_enabled(true);
+	}
+	// shaders preprocess on the workers while the meshes are generated
+	ShaderPrewarm prewarm;
+	shader_variant_prewarm_begin(SHADER_MANIFEST, &prewarm);
+
+	static Scene scene;
+	scene_init(&scene, (float)SCREEN_WIDTH/(float)SCREEN_HEIGHT);
+	shader_variant_prewarm_end(&prewarm);
+	scene.debug_overdraw = global_overdraw;
+	scene.submit = global_submit;
+	hud_init();
+	hud_set_enabled(global_hud);
+
+	// compilation is not what's being measured, finish it first
+	scene_program_state(&scene);
+	while (shader_batch_poll() > 0) {}
+	if (scene_program_state(&scene) != PROGRAM_READY) {
+		log_error("could not load shader program.");
+		headless_destroy(&headless);
+		return 1;
+	}
+
+	HeadlessTimings timings;
+	if (!frame_times_init(&timings.cpu, frames)
+		|| !frame_times_init(&timings.submit, frames)
+		|| !frame_times_init(&timings.gpu, frames)
+		|| !frame_times_init(&timings.frame, frames)) {
+		log_error("out of memory");
+		headless_destroy(&headless);
+		return 1;
+	}
+
+	headless_run(&headless, &scene, HEADLESS_WARMUP_FRAMES, frames, &timings);
+
+	printf("headless: %d frames after %d warmup at %dx%d, %zu objects, times in ms\n",
+		   frames, HEADLESS_WARMUP_FRAMES, headless.width, headless.height, scene.objects_count);
+	frame_times_print_header();
+	frame_times_print("cpu",    frame_times_summarize(&timings.cpu));
+	frame_times_print("submit", frame_times_summarize(&timings.submit));
+	frame_times_print("gpu",    frame_times_summarize(&timings.gpu));
+	frame_times_print("frame",  frame_times_summarize(&timings.frame));
+	pipeline_stats_print_summary();
+	if (scene.debug_overdraw) {
+		overdraw_print(overdraw_latest());
+	}
+	render_stats_print(render_stats_latest());
+	gpu_memory_print(gpu_memory_stats());
+	mesh_heap_print(mesh_heap_stats());
+	printf("frame arena: %zu bytes at most on one thread\n", frame_arena_high_water(&scene.packet.arena));
+	if (global_hud) {
+		printf("hud: %.4f ms cpu per frame\n", hud_average_cpu_ms());
+	}
+
+	frame_times_free(&timings.cpu);
+	frame_times_free(&timings.submit);
+	frame_times_free(&timings.gpu);
+	frame_times_free(&timings.frame);
+	scene_destroy(&scene);
+	mesh_heap_shutdown();
+	retire_shutdown();
+	headless_destroy(&headless);
+	return 0;
+}
+
+void usage(const char *program) {
+	fprintf(stderr, "usage: %s [--headless [--frames N]] [--trace FILE] [--pipeline-stats] [--overdraw] [--hud]"
+			" [--log-level debug|info|warning|error]"
+			" [--pacing vsync|adaptive|uncapped|capped] [--fps N] [--frames-in-flight N] [--no-render-thread] [--jobs N]"
+			" [--submit direct|commands] [--gpu-budget MB]\n", program);
+}
+
+int main(int argc, char **argv) {
+	bool headless = false;
+	int headless_frames = HEADLESS_DEFAULT_FRAMES;
+	const char *trace_path = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			headless_frames = atoi(argv[++i]);
+			if (headless_frames <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (strcmp(argv[i], "--pipeline-stats") == 0) {
+			global_pipeline_stats = true;
+		} else if (strcmp(argv[i], "--overdraw") == 0) {
+			global_overdraw = true;
+		} else if (strcmp(argv[i], "--hud") == 0) {
+			global_hud = true;
+		} else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+			int level = 0;
+			++i;
+			while (level < LOG_LEVEL_COUNT && strcasecmp(argv[i], log_level_names[level]) != 0) ++level;
+			if (level == LOG_LEVEL_COUNT) {
+				usage(argv[0]);
+				return 1;
+			}
+			log_set_level(level);
+		} else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+			int mode = 0;
+			++i;
+			while (mode < PACING_MODE_COUNT && strcasecmp(argv[i], pacing_mode_names[mode]) != 0) ++mode;
+			if (mode == PACING_MODE_COUNT) {
+				usage(argv[0]);
+				return 1;
+			}
+			global_pacing_mode = mode;
+		} else if (strcmp(argv[i], "--submit") == 0 && i + 1 < argc) {
+			int submit = 0;
+			++i;
+			while (submit < SCENE_SUBMIT_COUNT && strcmp(argv[i], scene_submit_names[submit]) != 0) ++submit;
+			if (submit == SCENE_SUBMIT_COUNT) {
+				usage(argv[0]);
+				return 1;
+			}
+			global_submit = submit;
+		} else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			global_target_fps = atof(argv[++i]);
+			if (global_target_fps <= 0.0) {
+				usage(argv[0]);
+				return 1;
+			}
+			global_pacing_mode = PACING_CAPPED;
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			global_job_threads = atoi(argv[++i]);
+			if (global_job_threads < 1) {
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc) {
+			double megabytes = atof(argv[++i]);
+			if (megabytes <= 0.0) {
+				usage(argv[0]);
+				return 1;
+			}
+			gpu_memory_set_budget((uint64_t)(megabytes * 1048576.0));
+		} else if (strcmp(argv[i], "--no-render-thread") == 0) {
+			global_render_thread = false;
+		} else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+			global_frames_in_flight = atoi(argv[++i]);
+			if (global_frames_in_flight < 1 || global_frames_in_flight > PACING_MAX_FRAMES_IN_FLIGHT) {
+				usage(argv[0]);
+				return 1;
+			}
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	log_init();
+	profiler_init();
+	PROFILE_THREAD("main");
+	if (!jobs_init(global_job_threads)) {
+		return 1;
+	}
+	if (headless) {
+		int result = headless_main(headless_frames);
+		jobs_shutdown();
+		if (trace_path != NULL && !profiler_write_chrome_trace(trace_path)) {
+			result = 1;
+		}
+		return result;
+	}
 
-int main(void) {
     glfwSetErrorCallback(error_callback);
 
 	if (!glfwInit()) {
-		fprintf(stderr, "[ERROR]: could not initialize GLFW\n");
+		log_error("could not initialize GLFW");
 		exit(1);
 	}
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if ENABLE_GL_DEBUG
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#else
+	glfwWindowHint(GLFW_CONTEXT_NO_ERROR, GL_TRUE);
+#endif
 
 	GLFWwindow * const window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "opengl_template", NULL, NULL);
 	if (window == NULL) {
-		fprintf(stderr, "[ERROR]: could not create a window.\n");
+		log_error("could not create a window.");
 		glfwTerminate();
 		exit(1);
 	}
 
     glfwMakeContextCurrent(window);
 	gladLoadGL(glfwGetProcAddress);
-	glfwSwapInterval(ENABLE_VSYNC);
 
 	printf("OpenGL renderer: %s\n", glGetString(GL_RENDERER));
 	printf("OpenGL version:  %s\n", glGetString(GL_VERSION));
+	gl_ext_load(glfwGetProcAddress);
+	printf("OpenGL context:  %s\n", context_mode_names[gl_ext_context_mode()]);
+	shader_cache_init(SHADER_CACHE_DIR);
+	shader_batch_init();
+	gpu_profiler_init();
 
 
 
-#if ENABLE_GL_MESSAGE_CALLBACK
-	if (glDebugMessageCallbackARB != NULL) {
-		glEnable(GL_DEBUG_OUTPUT);
-		glDebugMessageCallbackARB(message_callback, 0);
-	}
-#endif // ENABLE_GL_MESSAGE_CALLBACK
-	glfwSetFramebufferSizeCallback(window, window_size_callback);
+#if ENABLE_GL_DEBUG
+	gl_ext_enable_debug_output();
+#endif // ENABLE_GL_DEBUG
 	glfwSetKeyCallback(window, key_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetCursorPosCallback(window, cursor_position_callback);
 
 
-	GLuint program = 0;
-	if (!shader_load_program("cube.vert", "cube.frag", &program)) {
-		fprintf(stderr, "[ERROR]: could not load shader program.\n");
-		glfwTerminate();
-		exit(1);
-	}
-
-
-
-	Mesh cube_mesh = cube_generate_mesh();
-	mesh_init(&cube_mesh, program);
+	hot_reload_init();
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	//glFrontFace(GL_CW);
+	// variants compile in the background while the rest loads,
+	// shaders preprocess on the workers while the meshes are generated
+	ShaderPrewarm prewarm;
+	shader_variant_prewarm_begin(SHADER_MANIFEST, &prewarm);
 
-
-	Camera cam = {0};
-	cam.transform.position.z = 2,
-	cam.transform.scale = (V3f){1,1,1};
-	cam.fov = 50;
-	cam.aspect = (float)SCREEN_WIDTH/(float)SCREEN_HEIGHT;
-	camera_update(&cam);
-
-	Transform cube_transform = {
-		.position = {0, 0, 0},
-		.scale = {1, 1, 1}
-	};
-
-	Transform cube_transform2 = cube_transform;
-	cube_transform2.position.x += 2;
+	static Scene scene;
+	scene_init(&scene, (float)SCREEN_WIDTH/(float)SCREEN_HEIGHT);
+	shader_variant_prewarm_end(&prewarm);
+	hud_init();
+	input_latency_init();
+	Camera *cam = &scene.camera;
+	scene.late_latch = latch_camera;
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+	static Renderer renderer;
+	renderer_start(&renderer, window, &scene, global_render_thread);
 
-	float sensitivity = 0.002f;
-
-	double time = glfwGetTime();
-	double prev_time = 0.0;
-	double delta_time = 0.0f;
-	while (!glfwWindowShouldClose(window)) {
-		int width, height;
-		glfwGetWindowSize(window, &width, &height);
-
-		double xpos, ypos;
-		glfwGetCursorPos(window, &xpos, &ypos);
-
-
-		static double lastX = 0, lastY = 0;
-		static int firstMouse = 1;
+	FixedTimestep timestep;
+	fixed_timestep_init(&timestep, SCENE_STEP, SCENE_MAX_STEPS);
 
-		if (firstMouse) {
-			lastX = xpos;
-			lastY = ypos;
-			firstMouse = 0;
-		}
-
-		double xoffset = xpos - lastX;
-		double yoffset = lastY - ypos;
+	double prev_time = glfwGetTime();
+	double frame_time = 0.0;
+	while (!glfwWindowShouldClose(window) && !atomic_load(&renderer.failed)) {
+		PROFILE_ZONE("frame");
+		alloc_track_frame_begin();
 
-		lastX = xpos;
-		lastY = ypos;
+		// waits here while the render thread is a whole frame behind, so
+		// input is read after the wait
+		FramePacket *packet = renderer_begin_frame(&renderer);
 
-		xoffset *= sensitivity;
-		yoffset *= sensitivity;
-
-		cam.transform.rotation.y -= xoffset;
-		cam.transform.rotation.x += yoffset;
-		if (cam.transform.rotation.x >  1.5f) cam.transform.rotation.x =  1.5f;
-		if (cam.transform.rotation.x < -1.5f) cam.transform.rotation.x = -1.5f;
+		PROFILE_BEGIN("input");
+		// in pixels, the window size is in screen coordinates and smaller
+		// on high DPI displays
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
 
 		glfwPollEvents();
-
-		V3f forward = { sinf(cam.transform.rotation.y), 0, cosf(cam.transform.rotation.y) };
-		V3f right = { forward.z, 0, -forward.x };
-
-		float speed = 5.0f * delta_time;
-		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-			cam.transform.position.x += forward.x * speed;
-			cam.transform.position.z -= forward.z * speed;
+		InputEvent event;
+		while (input_pop(INPUT_EVENT_KEY, &event)) {
+			handle_key(window, event.key, event.action);
 		}
-		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-			cam.transform.position.x -= forward.x * speed;
-			cam.transform.position.z += forward.z * speed;
+		while (input_pop(INPUT_EVENT_SCROLL, &event)) {
+			cam->fov -= (float)event.y;
+			if (cam->fov < 1.0f)    cam->fov = 1.0f;
+			if (cam->fov > 1000.0f) cam->fov = 1000.0f;
 		}
-		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-			cam.transform.position.x -= right.x * speed;
-			cam.transform.position.z -= right.z * speed;
+		PROFILE_END();
+
+		// the simulation runs in fixed steps however long the frame took
+		PROFILE_BEGIN("simulate");
+		int steps = fixed_timestep_advance(&timestep, frame_time);
+		for (int step = 0; step < steps; ++step) {
+			scene_update(&scene, SCENE_STEP);
+			camera_move(window, cam, SCENE_STEP);
 		}
-		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-			cam.transform.position.x += right.x * speed;
-			cam.transform.position.z += right.z * speed;
-		}
-
-
-		if (global_scroll_y != 0.0) {
-			cam.fov -= (float)global_scroll_y;
-			if (cam.fov < 1.0f)    cam.fov = 1.0f;
-			if (cam.fov > 1000.0f) cam.fov = 1000.0f;
-			global_scroll_y = 0.0;
-		}
-
-
-		const float bg_color = 20.0f/255.0f;
-		glClearColor(bg_color, bg_color, bg_color, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glUseProgram(program);
-
-		cam.aspect = (float)width/(float)height;
-		camera_update(&cam);
-
-		float cube_speed = 2.0f * delta_time;
-		cube_transform.rotation.x += cube_speed;
-		cube_transform.rotation.y += cube_speed;
-		cube_transform.rotation.z += cube_speed;
-		//cube_transform.rotation = (V3f){time, time * 0.6f, 0};
-
-		draw_mesh(&cube_mesh, &cube_transform, &cam);
-
-		cube_transform2.rotation.x += 0.5f * cube_speed;
-		cube_transform2.rotation.y += 0.5f * cube_speed;
-		cube_transform2.rotation.z += 0.5f * cube_speed;
-		draw_mesh(&cube_mesh, &cube_transform2, &cam);
-
-
-
-		glfwSwapBuffers(window);
+		PROFILE_END();
+
+		scene.shader_features = global_shader_features;
+		scene.debug_overdraw = global_overdraw;
+		scene.submit = global_submit;
+		scene_build_packet(&scene, &packet->scene, (float)width/(float)height, fixed_timestep_alpha(&timestep));
+		packet->width = width;
+		packet->height = height;
+		packet->frame_ms = (float)(frame_time * 1000.0);
+		packet->hud = global_hud;
+		packet->pipeline_stats = global_pipeline_stats;
+		packet->pacing_mode = global_pacing_mode;
+		packet->log_level = log_level();
+		input_motion_total(&packet->cursor_dx, &packet->cursor_dy);
+		packet->quit = false;
+		renderer_end_frame(&renderer);
 
 		double cur_time = glfwGetTime();
-		delta_time = cur_time - prev_time;
-		time += delta_time;
+		frame_time = cur_time - prev_time;
 		prev_time = cur_time;
+		alloc_track_frame_end();
 	}
 
+	bool ok = renderer_stop(&renderer);
+	shader_variant_shutdown();
+	scene_destroy(&scene);
+	mesh_heap_shutdown();
+	retire_shutdown();
+	input_latency_print();
+	jobs_shutdown();
+
     glfwDestroyWindow(window);
 	glfwTerminate();
+	if (!ok) {
+		return 1;
+	}
+	if (trace_path != NULL && !profiler_write_chrome_trace(trace_path)) {
+		return 1;
+	}
 	return 0;
 }
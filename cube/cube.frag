@@ -3,16 +3,20 @@
 in vec3 v_normal;
 in vec3 v_world_pos;
 
-uniform vec3 u_light_dir;  // should be normalized
 uniform vec3 u_color;
 
+#ifdef LIGHTING
+#include "lighting.glsl"
+#endif
+
 layout(location = 0) out vec4 frag_color;
 
 void main() {
-	vec3 N = normalize(v_normal);
-	vec3 L = normalize(-u_light_dir); // assuming dir *toward* the surface
-	float diff = max(dot(N, L), 0.0);
-	vec3 color = u_color * diff;
+#ifdef LIGHTING
+	vec3 color = lighting_diffuse(normalize(v_normal), u_color);
+#else
+	vec3 color = u_color;
+#endif
 	frag_color = vec4(color, 1.0);
 }
 
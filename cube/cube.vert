@@ -3,15 +3,48 @@
 layout (location = 0) in vec3 a_pos;
 layout (location = 1) in vec3 a_normal;
 
-uniform mat4 u_mvp;
+// written once per frame right before the draws, see scene_render_packet
+layout (std140, row_major) uniform Camera {
+	mat4 u_view_projection;
+};
+
+#ifdef INSTANCED
+// column-major per-instance model matrix, takes locations 2 to 5
+layout (location = 2) in mat4 a_model;
+#elif defined(OBJECT_BLOCK)
+// a range of the replayed command list's uniforms per draw
+layout (std140, row_major) uniform Object {
+	mat4 u_model;
+};
+#else
 uniform mat4 u_model;
+#endif
+
+#ifdef SKINNED
+#include "skinning.glsl"
+#endif
 
 out vec3 v_normal;
 out vec3 v_world_pos;
 
 void main() {
-	gl_Position = u_mvp * vec4(a_pos, 1.0);
-	v_world_pos = vec3(u_model * vec4(a_pos, 1.0));
-	v_normal = mat3(transpose(inverse(u_model))) * a_normal;
+#ifdef INSTANCED
+	mat4 model = a_model;
+#else
+	mat4 model = u_model;
+#endif
+
+	vec4 pos = vec4(a_pos, 1.0);
+	vec3 normal = a_normal;
+#ifdef SKINNED
+	mat4 skin = skinning_matrix();
+	pos = skin * pos;
+	normal = mat3(skin) * normal;
+#endif
+
+	vec4 world_pos = model * pos;
+	gl_Position = u_view_projection * world_pos;
+	v_world_pos = vec3(world_pos);
+	v_normal = mat3(transpose(inverse(model))) * normal;
 }
 
@@ -2,9 +2,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-char *read_entire_file(const char *file_path) {
+// from the heap, or from arena if there is one
+static char *read_file(const char *file_path, Arena *arena) {
 	FILE *f = NULL;
 	char *buffer = NULL;
+	ArenaMark mark = arena ? arena_mark(arena) : 0;
 
 	f = fopen(file_path, "r");
 	if (f == NULL) goto fail;
@@ -13,8 +15,11 @@ char *read_entire_file(const char *file_path) {
 	long size = ftell(f);
 	if (size < 0) goto fail;
 
-	buffer = malloc(size + 1);
-	if (buffer == NULL) goto fail;
+	buffer = arena ? arena_alloc(arena, size + 1, 1) : malloc(size + 1);
+	if (buffer == NULL) {
+		errno = ENOMEM;
+		goto fail;
+	}
 
 	if (fseek(f, 0, SEEK_SET) < 0) goto fail;
 
@@ -34,8 +39,19 @@ fail:
 		fclose(f);
 		errno = saved_errno;
 	}
-	if (buffer) {
+	if (arena) {
+		arena_rewind(arena, mark);
+	} else if (buffer) {
 		free(buffer);
 	}
 	return NULL;
 }
+
+char *read_entire_file(const char *file_path) {
+	return read_file(file_path, NULL);
+}
+
+// nothing to free, rewinding the arena does it
+char *read_entire_file_arena(const char *file_path, Arena *arena) {
+	return read_file(file_path, arena);
+}
@@ -0,0 +1,87 @@
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Single producer, single consumer queue of frame packets.
+// The packets live in a ring the caller owns, FRAME_QUEUE_SIZE of them, and
+// are written and read in place: the producer fills the packet at the tail
+// while the consumer works on the one at the head, so the next frame is
+// built while the current one is drawn. Each index has one writer and is
+// published with a release store. A pair of semaphores counts free and
+// filled packets, their fast path is one atomic and only a side that
+// would overtake the other sleeps.
+
+#define FRAME_QUEUE_SIZE 2 // power of two
+
+typedef struct {
+	unsigned char *packets;
+	size_t packet_size;
+	_Atomic uint32_t head; // next packet to read, consumer only
+	_Atomic uint32_t tail; // next packet to write, producer only
+	sem_t free_packets, filled_packets;
+	// how often a side had to wait for the other, each written by its side
+	uint64_t producer_waits, consumer_waits;
+} FrameQueue;
+
+bool frame_queue_init(FrameQueue *queue, void *packets, size_t packet_size) {
+	*queue = (FrameQueue){ .packets = packets, .packet_size = packet_size };
+	if (sem_init(&queue->free_packets, 0, FRAME_QUEUE_SIZE) != 0) {
+		log_error("could not create the frame queue: %s", strerror(errno));
+		return false;
+	}
+	if (sem_init(&queue->filled_packets, 0, 0) != 0) {
+		log_error("could not create the frame queue: %s", strerror(errno));
+		sem_destroy(&queue->free_packets);
+		return false;
+	}
+	return true;
+}
+
+void frame_queue_destroy(FrameQueue *queue) {
+	sem_destroy(&queue->free_packets);
+	sem_destroy(&queue->filled_packets);
+}
+
+static void frame_queue_wait(sem_t *semaphore, uint64_t *waits) {
+	if (sem_trywait(semaphore) == 0) {
+		return;
+	}
+	*waits += 1;
+	while (sem_wait(semaphore) != 0 && errno == EINTR) {}
+}
+
+// the packet to fill next, blocks while the consumer holds every packet
+void *frame_queue_begin_write(FrameQueue *queue) {
+	PROFILE_ZONE("frame_queue_wait");
+	frame_queue_wait(&queue->free_packets, &queue->producer_waits);
+	uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	return queue->packets + (tail & (FRAME_QUEUE_SIZE - 1)) * queue->packet_size;
+}
+
+void frame_queue_end_write(FrameQueue *queue) {
+	uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	sem_post(&queue->filled_packets);
+}
+
+// the oldest filled packet, blocks until there is one, the consumer may
+// change it in place
+void *frame_queue_begin_read(FrameQueue *queue) {
+	PROFILE_ZONE("frame_queue_wait");
+	frame_queue_wait(&queue->filled_packets, &queue->consumer_waits);
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	// pairs with the release in frame_queue_end_write
+	(void) atomic_load_explicit(&queue->tail, memory_order_acquire);
+	return queue->packets + (head & (FRAME_QUEUE_SIZE - 1)) * queue->packet_size;
+}
+
+// hands the packet back to the producer once nothing reads it anymore
+void frame_queue_end_read(FrameQueue *queue) {
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+	sem_post(&queue->free_packets);
+}
@@ -0,0 +1,176 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Frame time samples and their percentiles, in milliseconds.
+
+typedef struct {
+	double *samples;
+	size_t count;
+	size_t capacity;
+} FrameTimes;
+
+typedef struct {
+	size_t count;
+	double mean, min, p50, p90, p95, p99, max;
+} FrameTimeSummary;
+
+double clock_now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// allocates up front so pushing never allocates inside the frame loop
+bool frame_times_init(FrameTimes *times, size_t capacity) {
+	times->samples = malloc(capacity * sizeof(double));
+	times->count = 0;
+	times->capacity = times->samples ? capacity : 0;
+	return times->samples != NULL;
+}
+
+void frame_times_free(FrameTimes *times) {
+	free(times->samples);
+	*times = (FrameTimes){0};
+}
+
+void frame_times_push(FrameTimes *times, double ms) {
+	if (times->count < times->capacity) {
+		times->samples[times->count++] = ms;
+	}
+}
+
+static int frame_times_compare(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// nearest rank, sorted must not be empty
+static double frame_times_percentile(const double *sorted, size_t count, double percentile) {
+	size_t rank = (size_t)(percentile / 100.0 * count + 0.999999);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+	return sorted[rank - 1];
+}
+
+FrameTimeSummary frame_times_summarize(const FrameTimes *times) {
+	FrameTimeSummary summary = { .count = times->count };
+	if (times->count == 0) {
+		return summary;
+	}
+
+	double *sorted = malloc(times->count * sizeof(double));
+	if (sorted == NULL) {
+		return summary;
+	}
+	memcpy(sorted, times->samples, times->count * sizeof(double));
+	qsort(sorted, times->count, sizeof(double), frame_times_compare);
+
+	double sum = 0.0;
+	for (size_t i = 0; i < times->count; ++i) {
+		sum += sorted[i];
+	}
+	summary.mean = sum / times->count;
+	summary.min  = sorted[0];
+	summary.p50  = frame_times_percentile(sorted, times->count, 50.0);
+	summary.p90  = frame_times_percentile(sorted, times->count, 90.0);
+	summary.p95  = frame_times_percentile(sorted, times->count, 95.0);
+	summary.p99  = frame_times_percentile(sorted, times->count, 99.0);
+	summary.max  = sorted[times->count - 1];
+
+	free(sorted);
+	return summary;
+}
+
+void frame_times_print_header(void) {
+	printf("%-8s %8s %9s %9s %9s %9s %9s %9s %9s\n",
+		   "", "samples", "mean", "min", "p50", "p90", "p95", "p99", "max");
+}
+
+void frame_times_print(const char *label, FrameTimeSummary s) {
+	printf("%-8s %8zu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+		   label, s.count, s.mean, s.min, s.p50, s.p90, s.p95, s.p99, s.max);
+}
+
+// Regularized incomplete beta function I_x(a, b), evaluated with the
+// continued fraction from Numerical Recipes (modified Lentz).
+static double incomplete_beta_fraction(double a, double b, double x) {
+	const double tiny = 1e-300;
+	double c = 1.0;
+	double d = 1.0 - (a + b) * x / (a + 1.0);
+	if (fabs(d) < tiny) d = tiny;
+	d = 1.0 / d;
+	double h = d;
+	for (int m = 1; m <= 200; ++m) {
+		double m2 = 2.0 * m;
+		double numerator = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+		d = 1.0 + numerator * d;
+		if (fabs(d) < tiny) d = tiny;
+		c = 1.0 + numerator / c;
+		if (fabs(c) < tiny) c = tiny;
+		d = 1.0 / d;
+		h *= d * c;
+
+		numerator = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+		d = 1.0 + numerator * d;
+		if (fabs(d) < tiny) d = tiny;
+		c = 1.0 + numerator / c;
+		if (fabs(c) < tiny) c = tiny;
+		d = 1.0 / d;
+		double delta = d * c;
+		h *= delta;
+		if (fabs(delta - 1.0) < 1e-12) break;
+	}
+	return h;
+}
+
+static double incomplete_beta(double a, double b, double x) {
+	if (x <= 0.0) return 0.0;
+	if (x >= 1.0) return 1.0;
+	double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x));
+	if (x < (a + 1.0) / (a + b + 2.0)) {
+		return front * incomplete_beta_fraction(a, b, x) / a;
+	}
+	return 1.0 - front * incomplete_beta_fraction(b, a, 1.0 - x) / b;
+}
+
+static void sample_mean_variance(const double *samples, size_t count, double *mean, double *variance) {
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i) sum += samples[i];
+	*mean = sum / count;
+	double squares = 0.0;
+	for (size_t i = 0; i < count; ++i) squares += (samples[i] - *mean) * (samples[i] - *mean);
+	*variance = squares / (count - 1);
+}
+
+// Welch's t-test for two samples with possibly different variances.
+// Returns the two sided p-value of the means being equal, 1 when either
+// sample has fewer than two values. t is positive when b's mean is larger.
+double welch_t_test(const double *a, size_t a_count, const double *b, size_t b_count, double *t) {
+	*t = 0.0;
+	if (a_count < 2 || b_count < 2) {
+		return 1.0;
+	}
+
+	double a_mean, a_variance, b_mean, b_variance;
+	sample_mean_variance(a, a_count, &a_mean, &a_variance);
+	sample_mean_variance(b, b_count, &b_mean, &b_variance);
+
+	double a_error = a_variance / a_count;
+	double b_error = b_variance / b_count;
+	double error = a_error + b_error;
+	if (error <= 0.0) {
+		// no spread at all, any difference is significant
+		return a_mean == b_mean ? 1.0 : 0.0;
+	}
+
+	*t = (b_mean - a_mean) / sqrt(error);
+	double dof = error * error / (a_error * a_error / (a_count - 1) + b_error * b_error / (b_count - 1));
+	return incomplete_beta(dof * 0.5, 0.5, dof / (dof + *t * *t));
+}
+
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "glad.h"
+
+// glad.h only covers gl:core=3.3, entry points from newer versions and
+// extensions are loaded here and left NULL when the driver lacks them.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB              0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB            0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB       0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB     0x82F4
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB       0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB      0x82F7
+#endif
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_DEBUG_SEVERITY_NOTIFICATION
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#endif
+#ifndef GL_CONTEXT_FLAG_DEBUG_BIT
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
+#ifndef GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR
+#define GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR 0x00000008
+#endif
+
+// How much error checking a context does, picked when it is created.
+// A release context asks for KHR_no_error, which lets the driver skip
+// validating calls, errors are undefined behaviour in it instead.
+typedef enum {
+	CONTEXT_MODE_RELEASE = 0,
+	CONTEXT_MODE_DEFAULT, // neither flag, what drivers give without asking
+	CONTEXT_MODE_DEBUG,   // validates and reports through message_callback
+	CONTEXT_MODE_COUNT,
+} ContextMode;
+
+const char *context_mode_names[CONTEXT_MODE_COUNT] = { "release", "default", "debug" };
+
+typedef void (GLAD_API_PTR *PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (GLAD_API_PTR *PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (GLAD_API_PTR *PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+PFNGLGETPROGRAMBINARYPROC  ext_glGetProgramBinary  = NULL;
+PFNGLPROGRAMBINARYPROC     ext_glProgramBinary     = NULL;
+PFNGLPROGRAMPARAMETERIPROC ext_glProgramParameteri = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC ext_glMaxShaderCompilerThreadsKHR = NULL;
+#define glGetProgramBinary  ext_glGetProgramBinary
+#define glProgramBinary     ext_glProgramBinary
+#define glProgramParameteri ext_glProgramParameteri
+#define glMaxShaderCompilerThreadsKHR ext_glMaxShaderCompilerThreadsKHR
+
+// KHR_parallel_shader_compile or its ARB predecessor, same tokens for both
+bool gl_ext_parallel_shader_compile = false;
+// ARB_pipeline_statistics_query, core since 4.6, only adds query targets
+bool gl_ext_pipeline_statistics = false;
+
+bool gl_ext_has(const char *name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != NULL && strcmp(ext, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool gl_ext_version_at_least(int major, int minor) {
+	GLint context_major = 0, context_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+	glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+	return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+// must be called after gladLoadGL, with the same loader
+void gl_ext_load(GLADloadfunc load) {
+	if (gl_ext_version_at_least(4, 1) || gl_ext_has("GL_ARB_get_program_binary")) {
+		glGetProgramBinary  = (PFNGLGETPROGRAMBINARYPROC)  load("glGetProgramBinary");
+		glProgramBinary     = (PFNGLPROGRAMBINARYPROC)     load("glProgramBinary");
+		glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC) load("glProgramParameteri");
+	}
+	if (gl_ext_has("GL_KHR_parallel_shader_compile")) {
+		glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsKHR");
+		gl_ext_parallel_shader_compile = true;
+	} else if (gl_ext_has("GL_ARB_parallel_shader_compile")) {
+		glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsARB");
+		gl_ext_parallel_shader_compile = true;
+	}
+	gl_ext_pipeline_statistics = gl_ext_version_at_least(4, 6) || gl_ext_has("GL_ARB_pipeline_statistics_query");
+}
+
+
+// driver messages go through the logger, which keeps them off the render
+// thread's time and limits floods of the same message id
+void message_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+					  GLsizei length, const GLchar* message, const void* userParam) {
+	(void) length;
+	(void) userParam;
+	LogLevel level;
+	switch (severity) {
+	case GL_DEBUG_SEVERITY_HIGH_ARB:   level = LOG_ERROR;   break;
+	case GL_DEBUG_SEVERITY_MEDIUM_ARB: level = LOG_WARNING; break;
+	case GL_DEBUG_SEVERITY_LOW_ARB:    level = LOG_INFO;    break;
+	default:                           level = LOG_DEBUG;   break; // notifications
+	}
+	// GL ids are only unique per source and type
+	uint64_t log_id = (uint64_t)source << 48 ^ (uint64_t)type << 32 ^ id;
+	log_message(level, log_id, "GL %s0x%x: %s", type == GL_DEBUG_TYPE_ERROR_ARB ? "error " : "", id, message);
+}
+
+// Only messages at the logger's level or above are generated at all, the
+// rest are switched off in the driver. Call again after log_set_level.
+void gl_ext_debug_output_level(LogLevel level) {
+	if (glDebugMessageControlARB == NULL) {
+		return;
+	}
+	static const GLenum severities[LOG_LEVEL_COUNT] = {
+		GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW_ARB, GL_DEBUG_SEVERITY_MEDIUM_ARB, GL_DEBUG_SEVERITY_HIGH_ARB,
+	};
+	for (int i = 0; i < LOG_LEVEL_COUNT; ++i) {
+		glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, NULL, i >= (int)level);
+	}
+}
+
+// in a debug context, routes driver messages to message_callback
+void gl_ext_enable_debug_output(void) {
+	if (glDebugMessageCallbackARB != NULL) {
+		glEnable(GL_DEBUG_OUTPUT);
+		glDebugMessageCallbackARB(message_callback, 0);
+		gl_ext_debug_output_level(log_level());
+	}
+}
+
+// what the current context actually is, drivers may ignore the request
+ContextMode gl_ext_context_mode(void) {
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (flags & GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR) return CONTEXT_MODE_RELEASE;
+	if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) return CONTEXT_MODE_DEBUG;
+	return CONTEXT_MODE_DEFAULT;
+}
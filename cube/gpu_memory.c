@@ -0,0 +1,107 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// GPU memory accounting.
+// GL doesn't say how much memory it holds for us, so everything that
+// allocates storage reports it here by category: buffers, textures and
+// render targets as they're created, respecified and deleted. The sizes
+// are what was asked for, drivers round up and add their own.
+// Buffers that were destroyed move to retiring until the GPU is done with
+// them, see retire.c, and to recycled if they're kept for reuse. Meshes
+// take ranges of large pages, see mesh_heap.c, what no range uses counts
+// as heap free. With a budget set, mesh_frame_end evicts meshes nobody
+// drew lately whenever everything but the retiring memory goes over it,
+// see mesh.c. Heap free memory counts, pages are only given up whole.
+// GL thread only.
+
+typedef enum {
+	GPU_MEMORY_VERTEX = 0,
+	GPU_MEMORY_INDEX,
+	GPU_MEMORY_UNIFORM,
+	GPU_MEMORY_TEXTURE,
+	GPU_MEMORY_RENDER_TARGET,
+	GPU_MEMORY_RETIRING, // destroyed, waiting for a fence
+	GPU_MEMORY_RECYCLED, // retired, kept for reuse
+	GPU_MEMORY_HEAP_FREE, // of mesh heap pages, what no range uses
+	GPU_MEMORY_COUNT,
+} GpuMemoryCategory;
+
+const char *gpu_memory_names[GPU_MEMORY_COUNT] = {
+	"vertex", "index", "uniform", "texture", "render target", "retiring", "recycled", "heap free",
+};
+
+typedef struct {
+	uint64_t bytes[GPU_MEMORY_COUNT];
+	uint32_t objects[GPU_MEMORY_COUNT];
+	uint64_t total, peak;
+	uint64_t budget; // 0 for none
+	uint64_t evictions, reloads; // of meshes, since the start
+} GpuMemoryStats;
+
+static GpuMemoryStats gpu_memory;
+
+void gpu_memory_alloc(GpuMemoryCategory category, uint64_t bytes) {
+	gpu_memory.bytes[category] += bytes;
+	gpu_memory.objects[category] += 1;
+	gpu_memory.total += bytes;
+	if (gpu_memory.total > gpu_memory.peak) {
+		gpu_memory.peak = gpu_memory.total;
+	}
+}
+
+void gpu_memory_free(GpuMemoryCategory category, uint64_t bytes) {
+	gpu_memory.bytes[category] -= bytes;
+	gpu_memory.objects[category] -= 1;
+	gpu_memory.total -= bytes;
+}
+
+// the same object now counts as another category
+void gpu_memory_move(GpuMemoryCategory from, GpuMemoryCategory to, uint64_t bytes) {
+	gpu_memory_free(from, bytes);
+	gpu_memory_alloc(to, bytes);
+}
+
+// bytes of one object now count as another category, for sub-allocations
+void gpu_memory_shift(GpuMemoryCategory from, GpuMemoryCategory to, uint64_t bytes) {
+	gpu_memory.bytes[from] -= bytes;
+	gpu_memory.bytes[to] += bytes;
+}
+
+// bytes may be 0 to have no budget
+void gpu_memory_set_budget(uint64_t bytes) {
+	gpu_memory.budget = bytes;
+}
+
+// how far what's held, less what's on its way out, is over the budget
+uint64_t gpu_memory_over_budget(void) {
+	uint64_t held = gpu_memory.total - gpu_memory.bytes[GPU_MEMORY_RETIRING];
+	return gpu_memory.budget != 0 && held > gpu_memory.budget ? held - gpu_memory.budget : 0;
+}
+
+void gpu_memory_count_eviction(void) {
+	gpu_memory.evictions += 1;
+}
+
+void gpu_memory_count_reload(void) {
+	gpu_memory.reloads += 1;
+}
+
+GpuMemoryStats gpu_memory_stats(void) {
+	return gpu_memory;
+}
+
+void gpu_memory_print(GpuMemoryStats stats) {
+	printf("gpu memory: %.2f MB held, %.2f MB at most", stats.total / 1048576.0, stats.peak / 1048576.0);
+	if (stats.budget != 0) {
+		printf(", budget %.2f MB, %llu meshes evicted, %llu reloaded", stats.budget / 1048576.0,
+			   (unsigned long long)stats.evictions, (unsigned long long)stats.reloads);
+	}
+	printf("\n");
+	for (int i = 0; i < GPU_MEMORY_COUNT; ++i) {
+		if (stats.objects[i] != 0 || stats.bytes[i] != 0) {
+			// sub-allocated ranges are bytes without objects of their own
+			printf("  %-14s %10.1f KB in %u\n", gpu_memory_names[i], stats.bytes[i] / 1024.0, stats.objects[i]);
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "glad.h"
+
+// GPU pass timings on the profiler's timeline.
+// Every zone brackets its GL commands with two glQueryCounter timestamps.
+// The queries of a frame live in one slot of a GPU_PROFILER_FRAMES deep
+// ring and are only read once GL_QUERY_RESULT_AVAILABLE says so, a few
+// frames later. If the GPU falls so far behind that the slot is still
+// busy when its turn comes again, that frame is not recorded instead of
+// waiting. GPU timestamps are mapped onto the CPU clock by sampling
+// GL_TIMESTAMP and profiler_ticks at the same moment, so the zones show
+// up as a "GPU" track next to the CPU threads in the trace.
+
+#define GPU_PROFILER_FRAMES          4  // frames a result may lag behind
+#define GPU_PROFILER_MAX_ZONES       32 // per frame
+#define GPU_PROFILER_MAX_DEPTH       8
+#define GPU_PROFILER_CALIBRATE_EVERY 60 // frames between clock resyncs
+
+#if ENABLE_PROFILER
+
+typedef struct {
+	const char *names[GPU_PROFILER_MAX_ZONES];
+	GLuint queries[GPU_PROFILER_MAX_ZONES * 2]; // begin and end timestamp of each zone
+	uint32_t count;
+	uint32_t last_query; // issued last, available means all of them are
+	bool pending;        // issued, results not read yet
+} GpuProfilerFrame;
+
+static struct {
+	bool initialized;
+	bool recording; // false while the current frame's slot is still in flight
+	GpuProfilerFrame frames[GPU_PROFILER_FRAMES];
+	uint64_t frame_index;
+	uint32_t stack[GPU_PROFILER_MAX_DEPTH];
+	uint32_t depth;
+
+	ProfilerThread *track;
+	GLint64 calibration_gpu_ns;
+	uint64_t calibration_ticks;
+
+	double last_frame_ms; // first begin to last end of the newest frame read back
+	uint64_t dropped_frames;
+} gpu_profiler;
+
+static void gpu_profiler_calibrate(void) {
+	glGetInteger64v(GL_TIMESTAMP, &gpu_profiler.calibration_gpu_ns);
+	gpu_profiler.calibration_ticks = profiler_ticks();
+}
+
+// needs a current context, until then every zone is a no-op
+bool gpu_profiler_init(void) {
+	gpu_profiler.track = profiler_track_create("GPU");
+	if (gpu_profiler.track == NULL) {
+		return false;
+	}
+	for (int i = 0; i < GPU_PROFILER_FRAMES; ++i) {
+		glGenQueries(GPU_PROFILER_MAX_ZONES * 2, gpu_profiler.frames[i].queries);
+	}
+	gpu_profiler_calibrate();
+	gpu_profiler.initialized = true;
+	return true;
+}
+
+static uint64_t gpu_profiler_to_ticks(GLuint64 gpu_ns, double ns_per_tick) {
+	double ns = (double)((GLint64)gpu_ns - gpu_profiler.calibration_gpu_ns);
+	return gpu_profiler.calibration_ticks + (int64_t)(ns / ns_per_tick);
+}
+
+static bool gpu_profiler_collect(GpuProfilerFrame *frame) {
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(frame->queries[frame->last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+
+	double ns_per_tick = profiler_ns_per_tick();
+	GLuint64 first = UINT64_MAX, last = 0;
+	for (uint32_t i = 0; i < frame->count; ++i) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame->queries[i * 2],     GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+		if (begin < first) first = begin;
+		if (end > last) last = end;
+		profiler_track_push(gpu_profiler.track, frame->names[i],
+							gpu_profiler_to_ticks(begin, ns_per_tick), gpu_profiler_to_ticks(end, ns_per_tick));
+	}
+	gpu_profiler.last_frame_ms = (last - first) / 1000000.0;
+	frame->pending = false;
+	return true;
+}
+
+void gpu_profiler_frame_begin(void) {
+	if (!gpu_profiler.initialized) {
+		return;
+	}
+
+	// oldest first, which is the slot this frame reuses, so the track stays in order
+	for (uint64_t i = 0; i < GPU_PROFILER_FRAMES; ++i) {
+		GpuProfilerFrame *frame = &gpu_profiler.frames[(gpu_profiler.frame_index + i) % GPU_PROFILER_FRAMES];
+		if (frame->pending && !gpu_profiler_collect(frame)) {
+			break;
+		}
+	}
+
+	if (gpu_profiler.frame_index % GPU_PROFILER_CALIBRATE_EVERY == 0) {
+		gpu_profiler_calibrate();
+	}
+
+	GpuProfilerFrame *frame = &gpu_profiler.frames[gpu_profiler.frame_index % GPU_PROFILER_FRAMES];
+	gpu_profiler.recording = !frame->pending;
+	if (gpu_profiler.recording) {
+		frame->count = 0;
+	} else {
+		gpu_profiler.dropped_frames += 1;
+	}
+	gpu_profiler.depth = 0;
+}
+
+void gpu_profiler_frame_end(void) {
+	if (!gpu_profiler.initialized) {
+		return;
+	}
+	GpuProfilerFrame *frame = &gpu_profiler.frames[gpu_profiler.frame_index % GPU_PROFILER_FRAMES];
+	if (gpu_profiler.recording && frame->count > 0) {
+		frame->pending = true;
+	}
+	gpu_profiler.recording = false;
+	gpu_profiler.frame_index += 1;
+}
+
+// zones have to be closed before gpu_profiler_frame_end
+static inline void gpu_profiler_begin(const char *name) {
+	if (!gpu_profiler.recording) {
+		return;
+	}
+	GpuProfilerFrame *frame = &gpu_profiler.frames[gpu_profiler.frame_index % GPU_PROFILER_FRAMES];
+	// like the CPU zones, what doesn't fit is dropped but still balanced
+	if (frame->count < GPU_PROFILER_MAX_ZONES && gpu_profiler.depth < GPU_PROFILER_MAX_DEPTH) {
+		uint32_t zone = frame->count++;
+		frame->names[zone] = name;
+		glQueryCounter(frame->queries[zone * 2], GL_TIMESTAMP);
+		gpu_profiler.stack[gpu_profiler.depth] = zone;
+	} else if (gpu_profiler.depth < GPU_PROFILER_MAX_DEPTH) {
+		gpu_profiler.stack[gpu_profiler.depth] = UINT32_MAX;
+	}
+	gpu_profiler.depth += 1;
+}
+
+static inline void gpu_profiler_end(void) {
+	if (!gpu_profiler.recording || gpu_profiler.depth == 0) {
+		return;
+	}
+	gpu_profiler.depth -= 1;
+	if (gpu_profiler.depth >= GPU_PROFILER_MAX_DEPTH || gpu_profiler.stack[gpu_profiler.depth] == UINT32_MAX) {
+		return;
+	}
+	GpuProfilerFrame *frame = &gpu_profiler.frames[gpu_profiler.frame_index % GPU_PROFILER_FRAMES];
+	uint32_t query = gpu_profiler.stack[gpu_profiler.depth] * 2 + 1;
+	glQueryCounter(frame->queries[query], GL_TIMESTAMP);
+	frame->last_query = query;
+}
+
+// GPU time of the newest frame whose results came back, 0 before the first
+double gpu_profiler_last_frame_ms(void) {
+	return gpu_profiler.last_frame_ms;
+}
+
+#define GPU_PROFILE_BEGIN(name) gpu_profiler_begin(name)
+#define GPU_PROFILE_END() gpu_profiler_end()
+
+#else
+
+bool gpu_profiler_init(void) { return false; }
+void gpu_profiler_frame_begin(void) {}
+void gpu_profiler_frame_end(void) {}
+double gpu_profiler_last_frame_ms(void) { return 0.0; }
+
+#define GPU_PROFILE_BEGIN(name) do {} while (0)
+#define GPU_PROFILE_END() do {} while (0)
+
+#endif // ENABLE_PROFILER
+
@@ -0,0 +1,21 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_FNV1A64_SEED 0xcbf29ce484222325ull
+
+uint64_t hash_fnv1a64(const void *data, size_t size, uint64_t seed) {
+	const uint8_t *bytes = data;
+	uint64_t h = seed;
+	for (size_t i = 0; i < size; ++i) {
+		h ^= bytes[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+// hashes the terminating '\0' too, so consecutive strings can't run together
+uint64_t hash_cstr(const char *str, uint64_t seed) {
+	return hash_fnv1a64(str, strlen(str) + 1, seed);
+}
+
@@ -0,0 +1,252 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "glad.h"
+
+// glad.h carries its own copy of khrplatform.h which doesn't define this
+#ifndef KHRONOS_APIENTRY
+#define KHRONOS_APIENTRY
+#endif
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// Window-less GL context for benchmarks on machines without a display.
+// The context comes from EGL, surfaceless when the driver allows it (Mesa
+// llvmpipe does), otherwise with a tiny pbuffer, and frames are rendered
+// into an offscreen framebuffer.
+
+// without a swap chain nothing stops the CPU from queueing frames forever,
+// so the benchmark loop throttles itself with fences
+#define HEADLESS_FRAMES_IN_FLIGHT 2
+
+typedef struct {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface; // EGL_NO_SURFACE when running surfaceless
+	GLuint fbo, color, depth; // depth has a stencil for the overdraw mode
+	int width, height;
+} Headless;
+
+typedef struct {
+	FrameTimes cpu;    // time spent submitting a frame
+	FrameTimes submit; // the part of cpu in scene_render_packet, what a render thread would do
+	FrameTimes gpu;    // GL_TIME_ELAPSED of a frame
+	FrameTimes frame;  // wall time between frame starts, includes throttling
+} HeadlessTimings;
+
+static bool egl_has_extension(const char *extensions, const char *name) {
+	size_t size = strlen(name);
+	for (const char *p = extensions; p && (p = strstr(p, name)); p += size) {
+		if ((p == extensions || p[-1] == ' ') && (p[size] == ' ' || p[size] == '\0')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static EGLDisplay headless_get_display(void) {
+	const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (egl_has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display != NULL) {
+			EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY) {
+				return display;
+			}
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool headless_init(Headless *h, int width, int height, ContextMode mode) {
+	*h = (Headless){ .display = EGL_NO_DISPLAY, .context = EGL_NO_CONTEXT, .surface = EGL_NO_SURFACE };
+	h->width = width;
+	h->height = height;
+
+	h->display = headless_get_display();
+	if (h->display == EGL_NO_DISPLAY || !eglInitialize(h->display, NULL, NULL)) {
+		log_error("could not initialize EGL: 0x%x", eglGetError());
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		log_error("EGL has no desktop OpenGL: 0x%x", eglGetError());
+		return false;
+	}
+
+	static const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(h->display, config_attribs, &config, 1, &config_count) || config_count == 0) {
+		log_error("no usable EGL config: 0x%x", eglGetError());
+		return false;
+	}
+
+	const char *display_extensions = eglQueryString(h->display, EGL_EXTENSIONS);
+	EGLint context_attribs[16] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+	};
+	int attrib_count = 6;
+	// like GLFW, a flag the driver doesn't know is left out rather than failing
+	if (mode == CONTEXT_MODE_RELEASE && egl_has_extension(display_extensions, "EGL_KHR_create_context_no_error")) {
+		context_attribs[attrib_count++] = EGL_CONTEXT_OPENGL_NO_ERROR_KHR;
+		context_attribs[attrib_count++] = EGL_TRUE;
+	} else if (mode == CONTEXT_MODE_DEBUG) {
+		context_attribs[attrib_count++] = EGL_CONTEXT_OPENGL_DEBUG;
+		context_attribs[attrib_count++] = EGL_TRUE;
+	}
+	context_attribs[attrib_count] = EGL_NONE;
+	h->context = eglCreateContext(h->display, config, EGL_NO_CONTEXT, context_attribs);
+	if (h->context == EGL_NO_CONTEXT) {
+		log_error("could not create an EGL context: 0x%x", eglGetError());
+		return false;
+	}
+
+	if (!egl_has_extension(display_extensions, "EGL_KHR_surfaceless_context")) {
+		static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		h->surface = eglCreatePbufferSurface(h->display, config, pbuffer_attribs);
+		if (h->surface == EGL_NO_SURFACE) {
+			log_error("could not create a pbuffer: 0x%x", eglGetError());
+			return false;
+		}
+	}
+	if (!eglMakeCurrent(h->display, h->surface, h->surface, h->context)) {
+		log_error("could not make the EGL context current: 0x%x", eglGetError());
+		return false;
+	}
+
+	if (!gladLoadGL((GLADloadfunc) eglGetProcAddress)) {
+		log_error("could not load OpenGL");
+		return false;
+	}
+	gl_ext_load((GLADloadfunc) eglGetProcAddress);
+	if (mode == CONTEXT_MODE_DEBUG) {
+		gl_ext_enable_debug_output();
+	}
+
+	// both four bytes a pixel
+	gpu_memory_alloc(GPU_MEMORY_RENDER_TARGET, (uint64_t)width * height * 4);
+	gpu_memory_alloc(GPU_MEMORY_RENDER_TARGET, (uint64_t)width * height * 4);
+	glGenRenderbuffers(1, &h->color);
+	glBindRenderbuffer(GL_RENDERBUFFER, h->color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &h->depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, h->depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+	glGenFramebuffers(1, &h->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, h->fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, h->color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, h->depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		log_error("offscreen framebuffer is incomplete");
+		return false;
+	}
+	glViewport(0, 0, width, height);
+
+	return true;
+}
+
+void headless_destroy(Headless *h) {
+	if (h->fbo) {
+		glDeleteFramebuffers(1, &h->fbo);
+		glDeleteRenderbuffers(1, &h->color);
+		glDeleteRenderbuffers(1, &h->depth);
+		gpu_memory_free(GPU_MEMORY_RENDER_TARGET, (uint64_t)h->width * h->height * 4);
+		gpu_memory_free(GPU_MEMORY_RENDER_TARGET, (uint64_t)h->width * h->height * 4);
+	}
+	if (h->display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(h->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (h->surface != EGL_NO_SURFACE) eglDestroySurface(h->display, h->surface);
+		if (h->context != EGL_NO_CONTEXT) eglDestroyContext(h->display, h->context);
+		eglTerminate(h->display);
+	}
+	*h = (Headless){0};
+}
+
+// Renders warmup + frames frames, each exactly one SCENE_STEP apart in
+// simulated time whatever the wall clock did, so every run simulates the
+// same thing, and records timings for all but the warmup.
+// Timer queries are read back once their frame's fence signalled, which
+// never stalls on a query result.
+void headless_run(Headless *h, Scene *scene, int warmup, int frames, HeadlessTimings *timings) {
+	FixedTimestep timestep;
+	fixed_timestep_init(&timestep, SCENE_STEP, SCENE_MAX_STEPS);
+	const int total = warmup + frames;
+
+	GLuint queries[HEADLESS_FRAMES_IN_FLIGHT];
+	GLsync fences[HEADLESS_FRAMES_IN_FLIGHT] = {0};
+	glGenQueries(HEADLESS_FRAMES_IN_FLIGHT, queries);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, h->fbo);
+	glViewport(0, 0, h->width, h->height);
+
+	double prev_frame_start = 0.0;
+	for (int i = 0; i < total + HEADLESS_FRAMES_IN_FLIGHT; ++i) {
+		PROFILE_ZONE("frame");
+		int slot = i % HEADLESS_FRAMES_IN_FLIGHT;
+		if (fences[slot] != NULL) {
+			PROFILE_ZONE("wait_fence");
+			glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+			glDeleteSync(fences[slot]);
+			fences[slot] = NULL;
+
+			GLuint64 elapsed_ns = 0;
+			glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed_ns);
+			if (i - HEADLESS_FRAMES_IN_FLIGHT >= warmup) {
+				frame_times_push(&timings->gpu, elapsed_ns / 1000000.0);
+			}
+		}
+		// the last iterations only drain the queries still in flight
+		if (i >= total) {
+			continue;
+		}
+
+		double frame_start = clock_now_ms();
+		double frame_ms = i > 0 ? frame_start - prev_frame_start : 0.0;
+		if (i > warmup) {
+			frame_times_push(&timings->frame, frame_ms);
+		}
+		prev_frame_start = frame_start;
+
+		alloc_track_frame_begin();
+		render_stats_frame_begin();
+		gpu_profiler_frame_begin();
+		pipeline_stats_frame_begin();
+		glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+		int steps = fixed_timestep_advance(&timestep, SCENE_STEP);
+		for (int step = 0; step < steps; ++step) {
+			scene_update(scene, SCENE_STEP);
+		}
+		scene_build_packet(scene, &scene->packet, (float)h->width/(float)h->height, fixed_timestep_alpha(&timestep));
+		double submit_start = clock_now_ms();
+		scene_render_packet(scene, &scene->packet, h->width, h->height);
+		if (i >= warmup) {
+			frame_times_push(&timings->submit, clock_now_ms() - submit_start);
+		}
+		hud_render(h->width, h->height, (float)frame_ms);
+		glEndQuery(GL_TIME_ELAPSED);
+		pipeline_stats_frame_end();
+		gpu_profiler_frame_end();
+		mesh_frame_end();
+		retire_frame_end();
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		alloc_track_frame_end();
+
+		if (i >= warmup) {
+			frame_times_push(&timings->cpu, clock_now_ms() - frame_start);
+		}
+	}
+
+	glDeleteQueries(HEADLESS_FRAMES_IN_FLIGHT, queries);
+}
+
@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Watches the directories of source files and reports which of them changed.
+// Directories are watched instead of the files themselves because most
+// editors save by writing a new file and renaming it over the old one.
+// Polling never blocks, the inotify descriptor is non-blocking.
+
+#ifndef ENABLE_HOT_RELOAD
+#ifdef __linux__
+#define ENABLE_HOT_RELOAD 1
+#else
+#define ENABLE_HOT_RELOAD 0
+#endif
+#endif
+
+#define HOT_RELOAD_MAX_DIRS  16
+#define HOT_RELOAD_PATH_SIZE 256
+
+typedef void (*HotReloadCallback)(const char *file_path);
+
+#if ENABLE_HOT_RELOAD
+#include <sys/inotify.h>
+#include <unistd.h>
+
+typedef struct {
+	int wd;
+	char path[HOT_RELOAD_PATH_SIZE]; // "" for the working directory
+} HotReloadDir;
+
+static struct {
+	int fd;
+	HotReloadDir dirs[HOT_RELOAD_MAX_DIRS];
+	size_t dirs_count;
+} hot_reload = { .fd = -1 };
+
+bool hot_reload_init(void) {
+	hot_reload.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (hot_reload.fd < 0) {
+		log_error("could not initialize inotify: %s", strerror(errno));
+		errno = 0;
+		return false;
+	}
+	return true;
+}
+
+void hot_reload_watch(const char *file_path) {
+	if (hot_reload.fd < 0) {
+		return;
+	}
+
+	const char *slash = strrchr(file_path, '/');
+	int dir_size = slash ? (int)(slash - file_path) : 0;
+
+	for (size_t i = 0; i < hot_reload.dirs_count; ++i) {
+		const char *path = hot_reload.dirs[i].path;
+		if ((int)strlen(path) == dir_size && strncmp(path, file_path, dir_size) == 0) {
+			return;
+		}
+	}
+	if (hot_reload.dirs_count >= HOT_RELOAD_MAX_DIRS) {
+		log_error("too many watched directories, not watching `%s`", file_path);
+		return;
+	}
+
+	HotReloadDir *dir = &hot_reload.dirs[hot_reload.dirs_count];
+	snprintf(dir->path, sizeof(dir->path), "%.*s", dir_size, file_path);
+	dir->wd = inotify_add_watch(hot_reload.fd, dir_size ? dir->path : ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (dir->wd < 0) {
+		log_error("could not watch `%s`: %s", dir_size ? dir->path : ".", strerror(errno));
+		errno = 0;
+		return;
+	}
+	hot_reload.dirs_count += 1;
+}
+
+void hot_reload_poll(HotReloadCallback on_change) {
+	if (hot_reload.fd < 0) {
+		return;
+	}
+
+	_Alignas(struct inotify_event) char buffer[4096];
+	for (;;) {
+		ssize_t size = read(hot_reload.fd, buffer, sizeof(buffer));
+		if (size <= 0) {
+			// EAGAIN once the queue is drained
+			errno = 0;
+			return;
+		}
+
+		for (char *p = buffer; p < buffer + size; ) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + event->len;
+			if (event->len == 0) {
+				continue;
+			}
+
+			for (size_t i = 0; i < hot_reload.dirs_count; ++i) {
+				HotReloadDir *dir = &hot_reload.dirs[i];
+				if (dir->wd != event->wd) {
+					continue;
+				}
+				char path[HOT_RELOAD_PATH_SIZE * 2];
+				if (dir->path[0] != '\0') {
+					snprintf(path, sizeof(path), "%s/%s", dir->path, event->name);
+				} else {
+					snprintf(path, sizeof(path), "%s", event->name);
+				}
+				on_change(path);
+				break;
+			}
+		}
+	}
+}
+
+#else
+
+bool hot_reload_init(void) { return false; }
+void hot_reload_watch(const char *file_path) { (void) file_path; }
+void hot_reload_poll(HotReloadCallback on_change) { (void) on_change; }
+
+#endif // ENABLE_HOT_RELOAD
+
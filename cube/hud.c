@@ -0,0 +1,275 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "glad.h"
+
+// On screen statistics overlay.
+// A handful of quads that never move, uploaded once and drawn with a
+// single draw call: the background and a line sample the solid white cell
+// of a tiny font atlas, the text and the frame time graph are one quad
+// each that hud.frag fills in from uniforms. The text is a grid of glyph
+// indices, four to an integer, the graph the frame times themselves. With
+// a quad per glyph and bar, setting up their vertices cost more than
+// everything else together.
+// The overlay times itself, the cost of the previous frame's overlay is
+// shown in it.
+
+#define HUD_GRAPH_FRAMES 120  // a multiple of 4, match u_frame_ms of hud.frag
+#define HUD_MAX_QUADS    4
+#define HUD_SCALE        2    // screen pixels per font pixel
+#define HUD_GLYPH_WIDTH  3
+#define HUD_GLYPH_HEIGHT 5
+#define HUD_CELL_WIDTH   (HUD_GLYPH_WIDTH + 1)
+#define HUD_CELL_HEIGHT  (HUD_GLYPH_HEIGHT + 1)
+#define HUD_LINE_HEIGHT  ((HUD_GLYPH_HEIGHT + 2) * HUD_SCALE)
+#define HUD_GRAPH_HEIGHT 60.0f
+#define HUD_GRAPH_MAX_MS 33.3f
+#define HUD_TEXT_COLUMNS 32 // a multiple of 16, lines are whole uvec4 of hud.frag
+#define HUD_TEXT_LINES   7  // match u_text of hud.frag
+
+// each octal digit is a row of three pixels, top row first, 4 is the left pixel
+#define HUD_GLYPH(r0, r1, r2, r3, r4) ((r0) << 12 | (r1) << 9 | (r2) << 6 | (r3) << 3 | (r4))
+
+static const char hud_font_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ .:-/%()=+_";
+static const uint16_t hud_font_glyphs[sizeof(hud_font_chars) - 1] = {
+	HUD_GLYPH(7,5,5,5,7), HUD_GLYPH(2,6,2,2,7), HUD_GLYPH(7,1,7,4,7), HUD_GLYPH(7,1,7,1,7),
+	HUD_GLYPH(5,5,7,1,1), HUD_GLYPH(7,4,7,1,7), HUD_GLYPH(7,4,7,5,7), HUD_GLYPH(7,1,1,1,1),
+	HUD_GLYPH(7,5,7,5,7), HUD_GLYPH(7,5,7,1,7),
+	HUD_GLYPH(2,5,7,5,5), HUD_GLYPH(6,5,6,5,6), HUD_GLYPH(3,4,4,4,3), HUD_GLYPH(6,5,5,5,6),
+	HUD_GLYPH(7,4,6,4,7), HUD_GLYPH(7,4,6,4,4), HUD_GLYPH(3,4,5,5,3), HUD_GLYPH(5,5,7,5,5),
+	HUD_GLYPH(7,2,2,2,7), HUD_GLYPH(1,1,1,5,2), HUD_GLYPH(5,5,6,5,5), HUD_GLYPH(4,4,4,4,7),
+	HUD_GLYPH(5,7,7,5,5), HUD_GLYPH(6,5,5,5,5), HUD_GLYPH(2,5,5,5,2), HUD_GLYPH(6,5,6,4,4),
+	HUD_GLYPH(2,5,5,6,3), HUD_GLYPH(6,5,6,5,5), HUD_GLYPH(3,4,2,1,6), HUD_GLYPH(7,2,2,2,2),
+	HUD_GLYPH(5,5,5,5,7), HUD_GLYPH(5,5,5,5,2), HUD_GLYPH(5,5,7,7,5), HUD_GLYPH(5,5,2,5,5),
+	HUD_GLYPH(5,5,2,2,2), HUD_GLYPH(7,1,2,4,7),
+	HUD_GLYPH(0,0,0,0,0), HUD_GLYPH(0,0,0,0,2), HUD_GLYPH(0,2,0,2,0), HUD_GLYPH(0,0,7,0,0),
+	HUD_GLYPH(1,1,2,4,4), HUD_GLYPH(5,1,2,4,5), HUD_GLYPH(1,2,2,2,1), HUD_GLYPH(4,2,2,2,4),
+	HUD_GLYPH(0,7,0,7,0), HUD_GLYPH(0,2,7,2,0), HUD_GLYPH(0,0,0,0,7),
+};
+
+#define HUD_FONT_GLYPHS     (sizeof(hud_font_glyphs) / sizeof(hud_font_glyphs[0]))
+#define HUD_ATLAS_WIDTH     ((HUD_FONT_GLYPHS + 1) * HUD_CELL_WIDTH) // the extra cell is solid
+#define HUD_ATLAS_HEIGHT    HUD_CELL_HEIGHT
+
+typedef struct {
+	uint8_t r, g, b, a;
+} HudColor;
+
+typedef struct {
+	float x, y;
+	float u, v;
+	HudColor color;
+} HudVertex;
+
+static struct {
+	bool initialized;
+	bool enabled;
+	ShaderFamily shader;
+	uint32_t screen_size_name, font_name, text_name;
+	uint32_t frame_ms_name, frame_first_name, graph_scale_name;
+	GLuint vao, font;
+	uint8_t glyphs[256]; // of each character, the space for those the font lacks
+	_Alignas(16) uint8_t text_cells[HUD_TEXT_LINES][HUD_TEXT_COLUMNS];
+	BufferHandle vbo;
+	HudVertex vertices[HUD_MAX_QUADS * 6];
+	size_t vertices_count;
+
+	_Alignas(16) float frame_ms[HUD_GRAPH_FRAMES];
+	size_t frame_index; // of the oldest frame
+
+	double cpu_ms; // what the previous hud_render cost
+	double cpu_ms_total;
+	uint64_t frames;
+} hud;
+
+static void hud_quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, HudColor color) {
+	if (hud.vertices_count + 6 > HUD_MAX_QUADS * 6) {
+		return;
+	}
+	HudVertex *v = &hud.vertices[hud.vertices_count];
+	v[0] = (HudVertex){ x0, y0, u0, v0, color };
+	v[1] = (HudVertex){ x0, y1, u0, v1, color };
+	v[2] = (HudVertex){ x1, y1, u1, v1, color };
+	v[3] = (HudVertex){ x0, y0, u0, v0, color };
+	v[4] = (HudVertex){ x1, y1, u1, v1, color };
+	v[5] = (HudVertex){ x1, y0, u1, v0, color };
+	hud.vertices_count += 6;
+}
+
+static void hud_rect(float x0, float y0, float x1, float y1, HudColor color) {
+	// the middle of the solid cell, nearest filtering never leaves it
+	float u = (HUD_FONT_GLYPHS * HUD_CELL_WIDTH + HUD_CELL_WIDTH * 0.5f) / HUD_ATLAS_WIDTH;
+	float v = 0.5f;
+	hud_quad(x0, y0, x1, y1, u, v, u, v, color);
+}
+
+static void hud_layout(void) {
+	const HudColor white  = { 230, 230, 230, 255 };
+	const HudColor panel  = {   0,   0,   0, 160 };
+	const HudColor target = { 255, 255, 255, 110 };
+
+	const float left = 8.0f, top = 8.0f, padding = 6.0f;
+	const float width = HUD_GRAPH_FRAMES * 2.0f;
+	const float x = left + padding, y = top + padding;
+	const float graph_top = y + HUD_TEXT_LINES * HUD_LINE_HEIGHT;
+	const float graph_bottom = graph_top + HUD_GRAPH_HEIGHT;
+
+	hud.vertices_count = 0;
+	hud_rect(left, top, left + width + padding * 2, graph_bottom + padding, panel);
+	// uv below 0 address the text grid, -1 - uv in cells, see hud.frag
+	hud_quad(x, y, x + HUD_TEXT_COLUMNS * HUD_CELL_WIDTH * HUD_SCALE, graph_top,
+			 -1.0f, -1.0f, -1.0f - HUD_TEXT_COLUMNS, -1.0f - HUD_TEXT_LINES, white);
+	// and above 1 the graph, 1 + uv in bars and pixels up from its bottom
+	hud_quad(x, graph_top, x + width, graph_bottom, 1.0f, 1.0f + HUD_GRAPH_HEIGHT, 1.0f + HUD_GRAPH_FRAMES, 1.0f, white);
+	float target_y = graph_bottom - (1000.0f / 60.0f) / HUD_GRAPH_MAX_MS * HUD_GRAPH_HEIGHT;
+	hud_rect(x, target_y, x + width, target_y + 1.0f, target);
+}
+
+void hud_init(void) {
+	hud.shader = shader_family_register("hud.vert", "hud.frag");
+	hud.screen_size_name = shader_name_hash("u_screen_size");
+	hud.font_name = shader_name_hash("u_font");
+	hud.text_name = shader_name_hash("u_text");
+	hud.frame_ms_name = shader_name_hash("u_frame_ms");
+	hud.frame_first_name = shader_name_hash("u_frame_first");
+	hud.graph_scale_name = shader_name_hash("u_graph_scale");
+
+	static uint8_t atlas[HUD_ATLAS_HEIGHT][HUD_ATLAS_WIDTH];
+	for (size_t i = 0; i < HUD_FONT_GLYPHS; ++i) {
+		for (int y = 0; y < HUD_GLYPH_HEIGHT; ++y) {
+			for (int x = 0; x < HUD_GLYPH_WIDTH; ++x) {
+				int bit = (HUD_GLYPH_HEIGHT - 1 - y) * HUD_GLYPH_WIDTH + (HUD_GLYPH_WIDTH - 1 - x);
+				atlas[y][i * HUD_CELL_WIDTH + x] = (hud_font_glyphs[i] >> bit) & 1 ? 255 : 0;
+			}
+		}
+	}
+	for (int y = 0; y < HUD_CELL_HEIGHT; ++y) {
+		for (int x = 0; x < HUD_CELL_WIDTH; ++x) {
+			atlas[y][HUD_FONT_GLYPHS * HUD_CELL_WIDTH + x] = 255;
+		}
+	}
+
+	glGenTextures(1, &hud.font);
+	glBindTexture(GL_TEXTURE_2D, hud.font);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas);
+	gpu_memory_alloc(GPU_MEMORY_TEXTURE, sizeof(atlas));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	const char *space = strchr(hud_font_chars, ' ');
+	for (int c = 0; c < 256; ++c) {
+		const char *found = c != 0 ? strchr(hud_font_chars, toupper(c)) : NULL;
+		hud.glyphs[c] = (uint8_t)((found != NULL ? found : space) - hud_font_chars);
+	}
+	hud_layout();
+	glGenVertexArrays(1, &hud.vao);
+	render_bind_vertex_array(hud.vao);
+	hud.vbo = buffer_create(GL_ARRAY_BUFFER, hud.vertices_count * sizeof(HudVertex), hud.vertices, GL_STATIC_DRAW, "hud");
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, color));
+	glEnableVertexAttribArray(2);
+
+	hud.initialized = true;
+}
+
+void hud_set_enabled(bool enabled) {
+	hud.enabled = enabled;
+}
+
+// one line of the text grid, what doesn't fit is cut off
+static void hud_text(int line, const char *format, ...) {
+	char text[HUD_TEXT_COLUMNS + 1];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if (length < 0) {
+		length = 0;
+	}
+
+	uint8_t *cells = hud.text_cells[line];
+	for (int column = 0; column < HUD_TEXT_COLUMNS; ++column) {
+		cells[column] = hud.glyphs[column < length ? (unsigned char)text[column] : ' '];
+	}
+}
+
+static void hud_build(float frame_ms) {
+	RenderStats stats = render_stats_latest();
+	hud_text(0, "FRAME %6.2f MS %5.0f FPS", frame_ms, frame_ms > 0.0f ? 1000.0f / frame_ms : 0.0f);
+	hud_text(1, "GPU   %6.2f MS", gpu_profiler_last_frame_ms());
+	hud_text(2, "DRAWS %u TRIS %llu", stats.draw_calls, (unsigned long long)stats.triangles);
+	hud_text(3, "STATE %u SHADER %u SKIP %u", stats.state_changes, stats.shader_binds, stats.redundant_skipped);
+	hud_text(4, "UPLOAD %.1f KB", stats.bytes_uploaded / 1024.0);
+	GpuMemoryStats memory = gpu_memory_stats();
+	if (memory.budget != 0) {
+		hud_text(5, "VRAM %.1f/%.1f MB", memory.total / 1048576.0, memory.budget / 1048576.0);
+	} else {
+		hud_text(5, "VRAM %.1f MB", memory.total / 1048576.0);
+	}
+	hud_text(6, "HUD   %6.3f MS", hud.cpu_ms);
+}
+
+// draws over whatever is in the framebuffer, frame_ms is the last frame's time
+void hud_render(int width, int height, float frame_ms) {
+	if (!hud.enabled || !hud.initialized) {
+		return;
+	}
+	ProgramHandle handle = shader_variant_get(hud.shader, 0);
+	GLuint program = shader_batch_program(handle);
+	if (program == 0) {
+		return;
+	}
+
+	PROFILE_ZONE("hud");
+	GPU_PROFILE_BEGIN("hud");
+	double start = clock_now_ms();
+
+	hud.frame_ms[hud.frame_index] = frame_ms;
+	hud.frame_index = (hud.frame_index + 1) % HUD_GRAPH_FRAMES;
+	hud_build(frame_ms);
+
+	const ProgramReflection *reflection = shader_batch_reflection(handle);
+	render_use_program(program);
+	glUniform2f(shader_reflect_location(reflection, hud.screen_size_name), (float)width, (float)height);
+	glUniform1i(shader_reflect_location(reflection, hud.font_name), 0);
+	// bytes in memory order, little endian puts the first in the low bits
+	glUniform4uiv(shader_reflect_location(reflection, hud.text_name), sizeof(hud.text_cells) / 16,
+				  (const GLuint *)hud.text_cells);
+	glUniform4fv(shader_reflect_location(reflection, hud.frame_ms_name), HUD_GRAPH_FRAMES / 4, hud.frame_ms);
+	glUniform1i(shader_reflect_location(reflection, hud.frame_first_name), (GLint)hud.frame_index);
+	glUniform1f(shader_reflect_location(reflection, hud.graph_scale_name), HUD_GRAPH_HEIGHT / HUD_GRAPH_MAX_MS);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, hud.font);
+
+	render_bind_vertex_array(hud.vao);
+
+	render_set_capability(GL_DEPTH_TEST, false);
+	render_set_capability(GL_CULL_FACE, false);
+	render_set_capability(GL_BLEND, true);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	render_draw_arrays(GL_TRIANGLES, 0, hud.vertices_count);
+	render_set_capability(GL_BLEND, false);
+	render_set_capability(GL_CULL_FACE, true);
+	render_set_capability(GL_DEPTH_TEST, true);
+
+	hud.cpu_ms = clock_now_ms() - start;
+	hud.cpu_ms_total += hud.cpu_ms;
+	hud.frames += 1;
+	GPU_PROFILE_END();
+}
+
+// CPU time of an average hud_render so far
+double hud_average_cpu_ms(void) {
+	return hud.frames ? hud.cpu_ms_total / hud.frames : 0.0;
+}
+
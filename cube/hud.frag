@@ -0,0 +1,42 @@
+#version 330 core
+
+in vec2 v_uv;
+in vec4 v_color;
+
+uniform sampler2D u_font;
+// the text grid, a glyph index per byte, 32 columns by 7 lines of hud.c
+uniform uvec4 u_text[14];
+// the last 120 frame times, the oldest at u_frame_first
+uniform vec4 u_frame_ms[30];
+uniform int u_frame_first;
+uniform float u_graph_scale; // pixels per millisecond
+
+layout(location = 0) out vec4 frag_color;
+
+// in font pixels, HUD_CELL_WIDTH and HUD_CELL_HEIGHT of hud.c, and a line
+const ivec2 atlas_cell = ivec2(4, 6);
+const vec2 text_cell = vec2(4.0, 7.0);
+
+void main() {
+	vec4 color = v_color;
+	float coverage;
+	if (v_uv.x < 0.0) {
+		// the text grid, -1 - uv in cells
+		vec2 grid = -1.0 - v_uv;
+		ivec2 pixel = ivec2(fract(grid) * text_cell);
+		int column = int(grid.x), line = int(grid.y);
+		uint word = u_text[line * 2 + column / 16][(column / 4) % 4];
+		int glyph = int((word >> uint(column % 4 * 8)) & 0xffu);
+		coverage = pixel.y < atlas_cell.y ? texelFetch(u_font, ivec2(glyph * atlas_cell.x + pixel.x, pixel.y), 0).r : 0.0;
+	} else if (v_uv.x > 1.0) {
+		// the graph, uv - 1 in bars and pixels up from its bottom, whole
+		// pixels high and colored by the rate they'd keep up
+		int frame = (int(v_uv.x - 1.0) + u_frame_first) % 120;
+		float ms = u_frame_ms[frame / 4][frame % 4];
+		coverage = v_uv.y - 1.0 < floor(ms * u_graph_scale + 0.5) ? 1.0 : 0.0;
+		color.rgb = ms < 1000.0 / 60.0 ? vec3(0.24, 0.78, 0.31) : ms < 1000.0 / 30.0 ? vec3(0.9, 0.78, 0.16) : vec3(0.9, 0.24, 0.2);
+	} else {
+		coverage = texture(u_font, v_uv).r;
+	}
+	frag_color = vec4(color.rgb, color.a * coverage);
+}
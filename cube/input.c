@@ -0,0 +1,253 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "glad.h"
+
+// Input events and motion-to-photon latency.
+// Window system callbacks only append timestamped events to a queue, the
+// frame loop pops them where it wants to apply them: keys and scrolling at
+// the start of the frame, mouse motion as late as possible, right before
+// the camera is written for the draws (see Scene.late_latch). Motion the
+// scene latched is summed up for the thread that draws, which turns the
+// packet's camera by whatever arrived since the packet was built, right
+// before uploading it.
+// Latency is measured from the oldest motion event a frame applied to the
+// moment the GPU finished that frame, read back from a timestamp query a
+// few frames later. The display's scanout comes on top of that and can't
+// be seen from here.
+
+#define INPUT_QUEUE_SIZE     256
+#define INPUT_LATENCY_FRAMES 4 // frames a latency result may lag behind
+
+typedef enum {
+	INPUT_EVENT_CURSOR = 0,
+	INPUT_EVENT_KEY,
+	INPUT_EVENT_SCROLL,
+} InputEventType;
+
+typedef struct {
+	InputEventType type;
+	uint64_t time_ns;
+	double x, y;   // cursor position or scroll offset
+	double dx, dy; // cursor motion since the previous cursor event
+	int key, action;
+} InputEvent;
+
+typedef struct {
+	GLuint query;
+	uint64_t input_ns;
+	bool pending;
+} InputLatencyFrame;
+
+static struct {
+	InputEvent events[INPUT_QUEUE_SIZE];
+	uint32_t count;
+	uint64_t dropped;
+	double cursor_x, cursor_y;
+	bool cursor_known;
+
+	bool latency_initialized;
+	InputLatencyFrame frames[INPUT_LATENCY_FRAMES];
+	uint64_t frame_index;
+	int64_t gpu_to_cpu_ns;
+	double latency_last_ms, latency_sum_ms, latency_max_ms;
+	uint64_t latency_count;
+#if ENABLE_PROFILER
+	ProfilerThread *track;
+#endif
+} input;
+
+// what input_latch_cursor latched, shared with the thread that draws
+static struct {
+	pthread_mutex_t mutex;
+	double dx, dy;      // all of it summed up
+	uint64_t oldest_ns; // oldest motion no frame drew yet, 0 if none
+} input_motion = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+uint64_t input_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// a full queue loses its oldest event, a frame that long is late anyway
+static void input_push(InputEvent event) {
+	event.time_ns = input_now_ns();
+	if (input.count == INPUT_QUEUE_SIZE) {
+		memmove(&input.events[0], &input.events[1], (INPUT_QUEUE_SIZE - 1) * sizeof(InputEvent));
+		input.count -= 1;
+		input.dropped += 1;
+	}
+	input.events[input.count++] = event;
+}
+
+void input_push_cursor(double x, double y) {
+	InputEvent event = { .type = INPUT_EVENT_CURSOR, .x = x, .y = y };
+	if (input.cursor_known) {
+		event.dx = x - input.cursor_x;
+		event.dy = y - input.cursor_y;
+	}
+	input.cursor_x = x;
+	input.cursor_y = y;
+	input.cursor_known = true;
+	input_push(event);
+}
+
+void input_push_key(int key, int action) {
+	input_push((InputEvent){ .type = INPUT_EVENT_KEY, .key = key, .action = action });
+}
+
+void input_push_scroll(double x, double y) {
+	input_push((InputEvent){ .type = INPUT_EVENT_SCROLL, .x = x, .y = y });
+}
+
+// the oldest queued event of that type, in the order they happened
+bool input_pop(InputEventType type, InputEvent *event) {
+	for (uint32_t i = 0; i < input.count; ++i) {
+		if (input.events[i].type == type) {
+			*event = input.events[i];
+			memmove(&input.events[i], &input.events[i + 1], (input.count - i - 1) * sizeof(InputEvent));
+			input.count -= 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Pops every queued cursor event and sums up their motion, for the late
+// latch. Returns false if the mouse didn't move.
+bool input_latch_cursor(double *dx, double *dy) {
+	*dx = 0.0;
+	*dy = 0.0;
+	uint64_t oldest_ns = 0;
+	InputEvent event;
+	while (input_pop(INPUT_EVENT_CURSOR, &event)) {
+		if (event.dx == 0.0 && event.dy == 0.0) {
+			continue;
+		}
+		*dx += event.dx;
+		*dy += event.dy;
+		if (oldest_ns == 0) {
+			oldest_ns = event.time_ns;
+		}
+	}
+	if (oldest_ns == 0) {
+		return false;
+	}
+	pthread_mutex_lock(&input_motion.mutex);
+	input_motion.dx += *dx;
+	input_motion.dy += *dy;
+	if (input_motion.oldest_ns == 0) {
+		input_motion.oldest_ns = oldest_ns;
+	}
+	pthread_mutex_unlock(&input_motion.mutex);
+	return true;
+}
+
+// all the motion latched so far, a packet keeps what its camera includes
+void input_motion_total(double *dx, double *dy) {
+	pthread_mutex_lock(&input_motion.mutex);
+	*dx = input_motion.dx;
+	*dy = input_motion.dy;
+	pthread_mutex_unlock(&input_motion.mutex);
+}
+
+// Like input_motion_total, on the thread that draws right before the
+// camera is uploaded. Returns the oldest motion no frame drew yet, 0 if
+// none, this frame draws it, for input_latency_frame_end.
+uint64_t input_motion_draw(double *dx, double *dy) {
+	pthread_mutex_lock(&input_motion.mutex);
+	*dx = input_motion.dx;
+	*dy = input_motion.dy;
+	uint64_t oldest_ns = input_motion.oldest_ns;
+	input_motion.oldest_ns = 0;
+	pthread_mutex_unlock(&input_motion.mutex);
+	return oldest_ns;
+}
+
+void input_latency_init(void) {
+	for (int i = 0; i < INPUT_LATENCY_FRAMES; ++i) {
+		glGenQueries(1, &input.frames[i].query);
+	}
+#if ENABLE_PROFILER
+	input.track = profiler_track_create("Input");
+#endif
+	input.latency_initialized = true;
+}
+
+static void input_latency_calibrate(void) {
+	GLint64 gpu_ns = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+	input.gpu_to_cpu_ns = (int64_t)input_now_ns() - gpu_ns;
+}
+
+static void input_latency_record(uint64_t input_ns, uint64_t photon_ns) {
+	double ms = (int64_t)(photon_ns - input_ns) / 1000000.0;
+	input.latency_last_ms = ms;
+	input.latency_sum_ms += ms;
+	if (ms > input.latency_max_ms) input.latency_max_ms = ms;
+	input.latency_count += 1;
+#if ENABLE_PROFILER
+	if (input.track != NULL) {
+		// back from now on the profiler's clock, both clocks count nanoseconds
+		double ns_per_tick = profiler_ns_per_tick();
+		uint64_t now_ticks = profiler_ticks();
+		int64_t now_ns = (int64_t)input_now_ns();
+		profiler_track_push(input.track, "motion_to_photon",
+							now_ticks - (uint64_t)((now_ns - (int64_t)input_ns) / ns_per_tick),
+							now_ticks - (uint64_t)((now_ns - (int64_t)photon_ns) / ns_per_tick));
+	}
+#endif
+}
+
+// reads back the frames the GPU finished since, call once per frame
+void input_latency_collect(void) {
+	if (!input.latency_initialized) {
+		return;
+	}
+	input_latency_calibrate();
+	for (uint64_t i = 0; i < INPUT_LATENCY_FRAMES; ++i) {
+		InputLatencyFrame *frame = &input.frames[(input.frame_index + i) % INPUT_LATENCY_FRAMES];
+		if (!frame->pending) {
+			continue;
+		}
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame->query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+		GLuint64 gpu_ns = 0;
+		glGetQueryObjectui64v(frame->query, GL_QUERY_RESULT, &gpu_ns);
+		input_latency_record(frame->input_ns, (uint64_t)((int64_t)gpu_ns + input.gpu_to_cpu_ns));
+		frame->pending = false;
+	}
+}
+
+// after the frame's last GL command, before swapping, input_ns is what
+// input_motion_draw returned for the frame
+void input_latency_frame_end(uint64_t input_ns) {
+	if (!input.latency_initialized) {
+		return;
+	}
+	InputLatencyFrame *frame = &input.frames[input.frame_index % INPUT_LATENCY_FRAMES];
+	// a slot still in flight means the GPU is far behind, skip this frame
+	if (input_ns != 0 && !frame->pending) {
+		glQueryCounter(frame->query, GL_TIMESTAMP);
+		frame->input_ns = input_ns;
+		frame->pending = true;
+	}
+	input.frame_index += 1;
+}
+
+void input_latency_print(void) {
+	if (input.latency_count == 0) {
+		return;
+	}
+	printf("motion to photon: %llu frames, last %.2f ms, mean %.2f ms, max %.2f ms\n",
+		   (unsigned long long)input.latency_count, input.latency_last_ms,
+		   input.latency_sum_ms / input.latency_count, input.latency_max_ms);
+}
+
@@ -0,0 +1,621 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// thread sanitizer has to be told about every switch between fibers
+#ifndef JOBS_TSAN
+#if defined(__SANITIZE_THREAD__)
+#define JOBS_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define JOBS_TSAN 1
+#endif
+#endif
+#endif
+#ifndef JOBS_TSAN
+#define JOBS_TSAN 0
+#endif
+#if JOBS_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+// Work-stealing job system.
+// Every worker owns a Chase-Lev deque (the weak memory model version by Lê
+// et al.): the owner pushes and pops jobs at the bottom, idle workers steal
+// from the top of a random victim. The thread that calls jobs_init becomes
+// worker 0 and works too whenever it waits on a counter.
+// A job decrements its counter when done, jobs_wait runs other jobs until
+// the counter it waits on drops to zero, that's how dependencies are
+// expressed: start the jobs a step needs with one counter, wait on it,
+// then start the step.
+// jobs_parallel_for splits its range lazily: a job runs its range in
+// chunks of the grain and only splits the rest in half while its own deque
+// is empty, which is when other workers are out of work. Balanced loops
+// split about once per worker, unbalanced ones keep splitting where the
+// work is.
+// Jobs run on fibers from a fixed pool, so a job that waits on a counter
+// parks its fiber and the worker goes on with other jobs instead of
+// blocking. The fiber is resumed by whichever worker finds its counter
+// drained first, a job can end on a different thread than it started on:
+// it mustn't hold thread local state or an open profiler zone across
+// jobs_wait. When the pool is out of fibers jobs run on the worker's own
+// stack, where waiting falls back to running other jobs until done.
+// Jobs started from threads that aren't workers, the render thread's for
+// one, go to a shared queue the workers take from between their own jobs
+// and stealing. They run right away on the thread that started them only
+// without worker threads or with that queue full.
+
+#define JOBS_MAX_WORKERS 64
+#define JOBS_DEQUE_SIZE  4096 // power of two, jobs queued per worker
+#define JOBS_SPIN_COUNT  64   // failed steal rounds before a worker sleeps
+#define JOBS_OUTSIDE_SIZE 64  // jobs queued from threads that aren't workers
+#define JOBS_FIBER_COUNT 128
+#define JOBS_FIBER_STACK_SIZE (256 * 1024) // plus a guard page
+
+typedef void (*JobFunction)(void *data, size_t begin, size_t end);
+
+typedef struct {
+	atomic_size_t pending;
+} JobCounter;
+
+typedef struct {
+	JobFunction function;
+	void *data;
+	size_t begin, end;
+	size_t grain; // 0 runs begin to end in one call, otherwise the range splits
+	JobCounter *counter;
+} Job;
+
+// A job is queued by value, as words a thief may read while the owner
+// writes them: a thief copies the job before it claims it, and a copy torn
+// by a push that reused the cell fails the claim, see job_deque_steal.
+typedef struct {
+	_Atomic uintptr_t words[sizeof(Job) / sizeof(uintptr_t)];
+} JobCell;
+
+_Static_assert(sizeof(Job) % sizeof(uintptr_t) == 0, "Job must be whole words");
+
+typedef struct {
+	_Atomic int64_t top, bottom;
+	JobCell buffer[JOBS_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct JobFiber {
+	ucontext_t context;
+	void *stack; // the guard page comes first
+	Job job;
+	JobCounter *waiting_on; // set while parked
+	struct JobFiber *next;  // in the free or the waiting list
+	void *tsan;             // thread sanitizer's handle, JOBS_TSAN only
+} JobFiber;
+
+typedef struct {
+	JobDeque deque;
+	uint32_t index;
+	uint64_t random;
+	pthread_t thread;
+	ucontext_t scheduler; // what the running fiber switches back to
+	JobFiber *fiber;      // running on this worker, NULL on its own stack
+	void *scheduler_tsan; // thread sanitizer's handle of the scheduler
+	uint64_t executed, stolen, parked;
+} JobWorker;
+
+static struct {
+	JobWorker *workers;
+	int count;
+	atomic_bool running;
+	atomic_int queued;   // pushed and not taken yet
+	atomic_int sleeping;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+
+	pthread_mutex_t outside_mutex;
+	Job outside[JOBS_OUTSIDE_SIZE]; // a ring, see jobs_push_outside
+	uint32_t outside_first, outside_count;
+	atomic_int outside_queued; // outside_count, read without the mutex
+
+	JobFiber fibers[JOBS_FIBER_COUNT];
+	size_t page_size;
+	pthread_mutex_t fibers_mutex;
+	JobFiber *free_fibers;
+	JobFiber *waiting_fibers;
+	atomic_int waiting_count;
+} jobs;
+
+static _Thread_local JobWorker *job_worker;
+
+// A fiber may come back on another thread, code that runs on one reads the
+// worker through this after every switch, never from a copy or from a
+// thread local address the compiler kept from before.
+__attribute__((noinline)) static JobWorker *jobs_current_worker(void) {
+	return job_worker;
+}
+
+static void job_cell_store(JobCell *cell, const Job *job) {
+	uintptr_t words[sizeof(Job) / sizeof(uintptr_t)];
+	memcpy(words, job, sizeof(Job));
+	for (size_t i = 0; i < sizeof(Job) / sizeof(uintptr_t); ++i) {
+		atomic_store_explicit(&cell->words[i], words[i], memory_order_relaxed);
+	}
+}
+
+static void job_cell_load(JobCell *cell, Job *job) {
+	uintptr_t words[sizeof(Job) / sizeof(uintptr_t)];
+	for (size_t i = 0; i < sizeof(Job) / sizeof(uintptr_t); ++i) {
+		words[i] = atomic_load_explicit(&cell->words[i], memory_order_relaxed);
+	}
+	memcpy(job, words, sizeof(Job));
+}
+
+static bool job_deque_push(JobDeque *deque, const Job *job) {
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	if (bottom - top >= JOBS_DEQUE_SIZE) {
+		return false;
+	}
+	job_cell_store(&deque->buffer[bottom & (JOBS_DEQUE_SIZE - 1)], job);
+	// a release store rather than the paper's fence, same code on x86 and
+	// thread sanitizer understands it
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+	return true;
+}
+
+// owner only, the newest job
+static bool job_deque_pop(JobDeque *deque, Job *job) {
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	// a seq_cst store and load instead of the paper's fence between them,
+	// same ordering and thread sanitizer understands it, fences it doesn't
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_seq_cst);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+	if (top > bottom) {
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		return false;
+	}
+	job_cell_load(&deque->buffer[bottom & (JOBS_DEQUE_SIZE - 1)], job);
+	bool taken = true;
+	if (top == bottom) {
+		// the last job, a thief may be after it too
+		taken = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+														memory_order_seq_cst, memory_order_relaxed);
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+	return taken;
+}
+
+// Any thread, the oldest job. The copy is taken before the claim: top only
+// grows and the owner doesn't reuse the cell while top is on it, so if the
+// claim succeeds nothing wrote the cell since top was read.
+static bool job_deque_steal(JobDeque *deque, Job *job) {
+	// seq_cst loads for the fence between them, as in job_deque_pop
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_seq_cst);
+	if (top >= bottom) {
+		return false;
+	}
+	job_cell_load(&deque->buffer[top & (JOBS_DEQUE_SIZE - 1)], job);
+	return atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+												   memory_order_seq_cst, memory_order_relaxed);
+}
+
+static bool job_deque_empty(JobDeque *deque) {
+	return atomic_load_explicit(&deque->bottom, memory_order_relaxed)
+		<= atomic_load_explicit(&deque->top, memory_order_relaxed);
+}
+
+static void jobs_queued_one(void) {
+	atomic_fetch_add(&jobs.queued, 1);
+	if (atomic_load(&jobs.sleeping) > 0) {
+		pthread_mutex_lock(&jobs.mutex);
+		pthread_cond_signal(&jobs.wake);
+		pthread_mutex_unlock(&jobs.mutex);
+	}
+}
+
+static bool jobs_push(JobWorker *worker, const Job *job) {
+	if (!job_deque_push(&worker->deque, job)) {
+		return false;
+	}
+	jobs_queued_one();
+	return true;
+}
+
+// from a thread that isn't a worker, false if the queue is full
+static bool jobs_push_outside(const Job *job) {
+	pthread_mutex_lock(&jobs.outside_mutex);
+	bool pushed = jobs.outside_count < JOBS_OUTSIDE_SIZE;
+	if (pushed) {
+		jobs.outside[(jobs.outside_first + jobs.outside_count) % JOBS_OUTSIDE_SIZE] = *job;
+		jobs.outside_count += 1;
+		atomic_fetch_add_explicit(&jobs.outside_queued, 1, memory_order_relaxed);
+	}
+	pthread_mutex_unlock(&jobs.outside_mutex);
+	if (pushed) {
+		jobs_queued_one();
+	}
+	return pushed;
+}
+
+static bool jobs_pop_outside(Job *job) {
+	if (atomic_load_explicit(&jobs.outside_queued, memory_order_relaxed) == 0) {
+		return false;
+	}
+	pthread_mutex_lock(&jobs.outside_mutex);
+	bool popped = jobs.outside_count > 0;
+	if (popped) {
+		*job = jobs.outside[jobs.outside_first];
+		jobs.outside_first = (jobs.outside_first + 1) % JOBS_OUTSIDE_SIZE;
+		jobs.outside_count -= 1;
+		atomic_fetch_sub_explicit(&jobs.outside_queued, 1, memory_order_relaxed);
+	}
+	pthread_mutex_unlock(&jobs.outside_mutex);
+	return popped;
+}
+
+// own jobs first, newest first, then those from outside the workers, then
+// the oldest of somebody else's
+static bool jobs_find(JobWorker *worker, Job *job) {
+	bool found = job_deque_pop(&worker->deque, job) || jobs_pop_outside(job);
+	if (!found && jobs.count > 1) {
+		worker->random ^= worker->random << 13;
+		worker->random ^= worker->random >> 7;
+		worker->random ^= worker->random << 17;
+		uint32_t first = (uint32_t)(worker->random % (uint64_t)jobs.count);
+		for (int i = 0; i < jobs.count && !found; ++i) {
+			JobWorker *victim = &jobs.workers[(first + i) % jobs.count];
+			if (victim != worker) {
+				found = job_deque_steal(&victim->deque, job);
+			}
+		}
+		if (found) worker->stolen += 1;
+	}
+	if (found) {
+		atomic_fetch_sub(&jobs.queued, 1);
+	}
+	return found;
+}
+
+static void job_run_range(Job job) {
+	while (job.begin < job.end) {
+		// split while nobody else has anything of ours to work on
+		JobWorker *worker = jobs_current_worker();
+		if (worker != NULL && job.end - job.begin > 2 * job.grain && job_deque_empty(&worker->deque)) {
+			size_t middle = job.begin + (job.end - job.begin) / 2;
+			Job half = job;
+			half.begin = middle;
+			atomic_fetch_add_explicit(&job.counter->pending, 1, memory_order_relaxed);
+			if (jobs_push(worker, &half)) {
+				job.end = middle;
+				continue;
+			}
+			atomic_fetch_sub_explicit(&job.counter->pending, 1, memory_order_relaxed);
+		}
+		size_t end = job.end - job.begin > job.grain ? job.begin + job.grain : job.end;
+		job.function(job.data, job.begin, end);
+		job.begin = end;
+	}
+}
+
+static void job_execute(Job job) {
+	if (job.grain > 0) {
+		job_run_range(job);
+	} else {
+		job.function(job.data, job.begin, job.end);
+	}
+	JobWorker *worker = jobs_current_worker();
+	if (worker != NULL) worker->executed += 1;
+	if (job.counter != NULL) {
+		atomic_fetch_sub_explicit(&job.counter->pending, 1, memory_order_release);
+	}
+}
+
+// from the scheduler into a fiber
+static void jobs_tsan_enter(JobWorker *worker, JobFiber *fiber) {
+#if JOBS_TSAN
+	worker->scheduler_tsan = __tsan_get_current_fiber();
+	__tsan_switch_to_fiber(fiber->tsan, 0);
+#else
+	(void) worker;
+	(void) fiber;
+#endif
+}
+
+// and back
+static void jobs_tsan_leave(JobWorker *worker) {
+#if JOBS_TSAN
+	__tsan_switch_to_fiber(worker->scheduler_tsan, 0);
+#else
+	(void) worker;
+#endif
+}
+
+// every fiber runs this forever, one job per switch from a scheduler
+static void job_fiber_main(void) {
+	for (;;) {
+		JobFiber *fiber = jobs_current_worker()->fiber;
+		job_execute(fiber->job);
+		JobWorker *worker = jobs_current_worker();
+		jobs_tsan_leave(worker);
+		swapcontext(&fiber->context, &worker->scheduler);
+	}
+}
+
+static bool jobs_fibers_init(void) {
+	jobs.page_size = (size_t)sysconf(_SC_PAGESIZE);
+	jobs.free_fibers = NULL;
+	jobs.waiting_fibers = NULL;
+	atomic_store(&jobs.waiting_count, 0);
+	pthread_mutex_init(&jobs.fibers_mutex, NULL);
+	for (int i = 0; i < JOBS_FIBER_COUNT; ++i) {
+		JobFiber *fiber = &jobs.fibers[i];
+		size_t size = JOBS_FIBER_STACK_SIZE + jobs.page_size;
+		fiber->stack = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+		if (fiber->stack == MAP_FAILED) {
+			fiber->stack = NULL;
+			log_error("could not map a fiber stack: %s", strerror(errno));
+			return false;
+		}
+		// an overflow faults on the guard page instead of corrupting a neighbour
+		mprotect(fiber->stack, jobs.page_size, PROT_NONE);
+		getcontext(&fiber->context);
+		fiber->context.uc_stack.ss_sp = (char *)fiber->stack + jobs.page_size;
+		fiber->context.uc_stack.ss_size = JOBS_FIBER_STACK_SIZE;
+		fiber->context.uc_link = NULL;
+		makecontext(&fiber->context, job_fiber_main, 0);
+#if JOBS_TSAN
+		fiber->tsan = __tsan_create_fiber(0);
+#endif
+		fiber->next = jobs.free_fibers;
+		jobs.free_fibers = fiber;
+	}
+	return true;
+}
+
+static void jobs_fibers_destroy(void) {
+	for (int i = 0; i < JOBS_FIBER_COUNT; ++i) {
+		if (jobs.fibers[i].stack != NULL) {
+			munmap(jobs.fibers[i].stack, JOBS_FIBER_STACK_SIZE + jobs.page_size);
+			jobs.fibers[i].stack = NULL;
+		}
+#if JOBS_TSAN
+		if (jobs.fibers[i].tsan != NULL) {
+			__tsan_destroy_fiber(jobs.fibers[i].tsan);
+			jobs.fibers[i].tsan = NULL;
+		}
+#endif
+	}
+	pthread_mutex_destroy(&jobs.fibers_mutex);
+}
+
+// a parked fiber whose counter drained, or NULL
+static JobFiber *jobs_take_ready_fiber(void) {
+	if (atomic_load_explicit(&jobs.waiting_count, memory_order_relaxed) == 0) {
+		return NULL;
+	}
+	JobFiber *ready = NULL;
+	pthread_mutex_lock(&jobs.fibers_mutex);
+	for (JobFiber **link = &jobs.waiting_fibers; *link != NULL; link = &(*link)->next) {
+		if (atomic_load_explicit(&(*link)->waiting_on->pending, memory_order_acquire) == 0) {
+			ready = *link;
+			*link = ready->next;
+			ready->waiting_on = NULL;
+			atomic_fetch_sub_explicit(&jobs.waiting_count, 1, memory_order_relaxed);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&jobs.fibers_mutex);
+	return ready;
+}
+
+// Runs one ready fiber or one new job until it finishes or parks, on the
+// calling worker's own stack. Returns false if there was nothing to run.
+static bool jobs_schedule(JobWorker *worker) {
+	JobFiber *fiber = jobs_take_ready_fiber();
+	if (fiber == NULL) {
+		Job job;
+		if (!jobs_find(worker, &job)) {
+			return false;
+		}
+		pthread_mutex_lock(&jobs.fibers_mutex);
+		fiber = jobs.free_fibers;
+		if (fiber != NULL) jobs.free_fibers = fiber->next;
+		pthread_mutex_unlock(&jobs.fibers_mutex);
+		if (fiber == NULL) {
+			// out of fibers, a wait in this job helps out instead of parking
+			job_execute(job);
+			return true;
+		}
+		fiber->job = job;
+	}
+
+	worker->fiber = fiber;
+	jobs_tsan_enter(worker, fiber);
+	swapcontext(&worker->scheduler, &fiber->context);
+	worker->fiber = NULL;
+
+	// the fiber is switched out and its context saved, only now may another
+	// worker pick it up again
+	pthread_mutex_lock(&jobs.fibers_mutex);
+	if (fiber->waiting_on != NULL) {
+		fiber->next = jobs.waiting_fibers;
+		jobs.waiting_fibers = fiber;
+		atomic_fetch_add_explicit(&jobs.waiting_count, 1, memory_order_relaxed);
+		worker->parked += 1;
+	} else {
+		fiber->next = jobs.free_fibers;
+		jobs.free_fibers = fiber;
+	}
+	pthread_mutex_unlock(&jobs.fibers_mutex);
+	return true;
+}
+
+static void *job_worker_main(void *arg) {
+	JobWorker *worker = arg;
+	job_worker = worker;
+	char name[PROFILER_THREAD_NAME_SIZE];
+	snprintf(name, sizeof(name), "job worker %u", worker->index);
+	PROFILE_THREAD(name);
+	(void) name;
+
+	int idle = 0;
+	while (atomic_load_explicit(&jobs.running, memory_order_relaxed)) {
+		if (jobs_schedule(worker)) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < JOBS_SPIN_COUNT) {
+			sched_yield();
+			continue;
+		}
+		pthread_mutex_lock(&jobs.mutex);
+		atomic_fetch_add(&jobs.sleeping, 1);
+		// parked fibers are resumed by whoever finishes their last job, that
+		// worker is awake
+		while (atomic_load(&jobs.running) && atomic_load(&jobs.queued) == 0) {
+			pthread_cond_wait(&jobs.wake, &jobs.mutex);
+		}
+		atomic_fetch_sub(&jobs.sleeping, 1);
+		pthread_mutex_unlock(&jobs.mutex);
+		idle = 0;
+	}
+	return NULL;
+}
+
+// threads counts the calling thread, 0 for one per CPU
+bool jobs_init(int threads) {
+	if (threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (int)cpus : 1;
+	}
+	if (threads > JOBS_MAX_WORKERS) threads = JOBS_MAX_WORKERS;
+
+	jobs.workers = calloc(threads, sizeof(JobWorker));
+	if (jobs.workers == NULL) {
+		log_error("out of memory for %d job workers", threads);
+		return false;
+	}
+	jobs.count = threads;
+	atomic_store(&jobs.queued, 0);
+	atomic_store(&jobs.sleeping, 0);
+	atomic_store(&jobs.running, true);
+	pthread_mutex_init(&jobs.mutex, NULL);
+	pthread_cond_init(&jobs.wake, NULL);
+	pthread_mutex_init(&jobs.outside_mutex, NULL);
+	jobs.outside_first = jobs.outside_count = 0;
+	atomic_store(&jobs.outside_queued, 0);
+	if (!jobs_fibers_init()) {
+		jobs_fibers_destroy();
+		free(jobs.workers);
+		jobs.workers = NULL;
+		jobs.count = 0;
+		return false;
+	}
+	for (int i = 0; i < threads; ++i) {
+		jobs.workers[i].index = i;
+		jobs.workers[i].random = 0x9E3779B97F4A7C15ull * (i + 1);
+	}
+	job_worker = &jobs.workers[0];
+
+	for (int i = 1; i < threads; ++i) {
+		int error = pthread_create(&jobs.workers[i].thread, NULL, job_worker_main, &jobs.workers[i]);
+		if (error != 0) {
+			log_warning("could only start %d of %d job workers: %s", i, threads, strerror(error));
+			jobs.count = i;
+			break;
+		}
+	}
+	return true;
+}
+
+// call with no jobs left, from the thread that called jobs_init
+void jobs_shutdown(void) {
+	if (jobs.workers == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&jobs.mutex);
+	atomic_store(&jobs.running, false);
+	pthread_cond_broadcast(&jobs.wake);
+	pthread_mutex_unlock(&jobs.mutex);
+	for (int i = 1; i < jobs.count; ++i) {
+		pthread_join(jobs.workers[i].thread, NULL);
+	}
+	pthread_mutex_destroy(&jobs.mutex);
+	pthread_cond_destroy(&jobs.wake);
+	pthread_mutex_destroy(&jobs.outside_mutex);
+	jobs_fibers_destroy();
+	free(jobs.workers);
+	jobs.workers = NULL;
+	jobs.count = 0;
+	job_worker = NULL;
+}
+
+int jobs_thread_count(void) {
+	return jobs.count > 0 ? jobs.count : 1;
+}
+
+// the calling worker's index, -1 on threads outside the job system
+int jobs_worker_index(void) {
+	JobWorker *worker = jobs_current_worker();
+	return worker != NULL ? (int)worker->index : -1;
+}
+
+// runs function(data, 0, 1) as a job, counter may be NULL
+void jobs_run(JobFunction function, void *data, JobCounter *counter) {
+	Job job = { .function = function, .data = data, .begin = 0, .end = 1, .counter = counter };
+	if (counter != NULL) {
+		atomic_fetch_add_explicit(&counter->pending, 1, memory_order_relaxed);
+	}
+	JobWorker *worker = jobs_current_worker();
+	bool queued = false;
+	if (jobs.count > 1) {
+		queued = worker != NULL ? jobs_push(worker, &job) : jobs_push_outside(&job);
+	}
+	if (!queued) {
+		job_execute(job);
+	}
+}
+
+// Returns once every job counted by counter finished. A job parks its
+// fiber meanwhile, anything else runs other jobs.
+void jobs_wait(JobCounter *counter) {
+	while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0) {
+		JobWorker *worker = jobs_current_worker();
+		if (worker != NULL && worker->fiber != NULL) {
+			JobFiber *fiber = worker->fiber;
+			fiber->waiting_on = counter;
+			jobs_tsan_leave(worker);
+			swapcontext(&fiber->context, &worker->scheduler);
+			continue; // resumed, possibly on another worker
+		}
+		if (worker == NULL || !jobs_schedule(worker)) {
+			sched_yield();
+		}
+	}
+}
+
+// Calls function on disjoint ranges covering 0 to count, at least grain
+// long unless they're the end of it, and returns when all of them are done.
+void jobs_parallel_for(size_t count, size_t grain, JobFunction function, void *data) {
+	if (grain == 0) grain = 1;
+	if (jobs_current_worker() == NULL || jobs.count <= 1 || count <= grain) {
+		function(data, 0, count);
+		return;
+	}
+	JobCounter counter = {0};
+	atomic_init(&counter.pending, 1);
+	Job job = { .function = function, .data = data, .begin = 0, .end = count, .grain = grain, .counter = &counter };
+	// the zone ends before the wait, which may move this to another thread
+	PROFILE_BEGIN("parallel_for");
+	job_execute(job);
+	PROFILE_END();
+	jobs_wait(&counter);
+}
@@ -0,0 +1,137 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#include "log.c"
+#include "math.c"
+#include "profiler.c"
+#include "frame_stats.c"
+#include "jobs.c"
+
+// Scaling benchmark of the job system, no GL involved.
+// Runs each workload as a parallel_for with 1 to --max-threads threads
+// and prints the median time, the speedup over the plain serial loop and
+// the parallel efficiency. "transforms" is what scene_build_packet does
+// per object, "uneven" costs up to 32 times more for some objects than
+// others, which is what the lazy splitting is for.
+
+#define JOBS_BENCH_OBJECTS 16384
+#define JOBS_BENCH_RUNS    200
+#define JOBS_BENCH_WARMUP  20
+#define JOBS_BENCH_GRAIN   256
+
+typedef struct {
+	Transform previous[JOBS_BENCH_OBJECTS];
+	Transform current[JOBS_BENCH_OBJECTS];
+	M4f models[JOBS_BENCH_OBJECTS];
+} JobsBenchData;
+
+static void jobs_bench_transforms(void *data, size_t begin, size_t end) {
+	JobsBenchData *bench = data;
+	for (size_t i = begin; i < end; ++i) {
+		Transform transform = transform_lerp(&bench->previous[i], &bench->current[i], 0.5f);
+		bench->models[i] = calculate_transform_matrix(&transform);
+	}
+}
+
+// every 64th stretch of objects is 32 times as expensive
+static void jobs_bench_uneven(void *data, size_t begin, size_t end) {
+	JobsBenchData *bench = data;
+	for (size_t i = begin; i < end; ++i) {
+		int repeats = (i / 64) % 8 == 0 ? 32 : 1;
+		for (int r = 0; r < repeats; ++r) {
+			Transform transform = transform_lerp(&bench->previous[i], &bench->current[i], r / 32.0f);
+			bench->models[i] = calculate_transform_matrix(&transform);
+		}
+	}
+}
+
+typedef struct {
+	const char *name;
+	JobFunction function;
+} JobsBenchWorkload;
+
+static const JobsBenchWorkload jobs_bench_workloads[] = {
+	{ "transforms", jobs_bench_transforms },
+	{ "uneven",     jobs_bench_uneven },
+};
+
+// threads 0 runs the function over everything without the job system
+static FrameTimeSummary jobs_bench_run(const JobsBenchWorkload *workload, JobsBenchData *data, int threads, FrameTimes *times) {
+	times->count = 0;
+	for (int run = 0; run < JOBS_BENCH_WARMUP + JOBS_BENCH_RUNS; ++run) {
+		double start = clock_now_ms();
+		if (threads == 0) {
+			workload->function(data, 0, JOBS_BENCH_OBJECTS);
+		} else {
+			jobs_parallel_for(JOBS_BENCH_OBJECTS, JOBS_BENCH_GRAIN, workload->function, data);
+		}
+		if (run >= JOBS_BENCH_WARMUP) {
+			frame_times_push(times, clock_now_ms() - start);
+		}
+	}
+	return frame_times_summarize(times);
+}
+
+static uint64_t jobs_bench_stolen(void) {
+	uint64_t stolen = 0;
+	for (int i = 0; i < jobs.count; ++i) {
+		stolen += jobs.workers[i].stolen;
+	}
+	return stolen;
+}
+
+int main(int argc, char **argv) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max_threads = cpus > 0 ? (int)cpus : 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc && (max_threads = atoi(argv[i + 1])) > 0) {
+			++i;
+		} else {
+			fprintf(stderr, "usage: %s [--max-threads N]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (max_threads > JOBS_MAX_WORKERS) max_threads = JOBS_MAX_WORKERS;
+
+	log_init();
+	profiler_init();
+
+	static JobsBenchData data;
+	for (size_t i = 0; i < JOBS_BENCH_OBJECTS; ++i) {
+		data.previous[i] = (Transform){ .position = { i * 0.1f, 0, 0 }, .rotation = { i * 0.01f, 0, 0 }, .scale = {1, 1, 1} };
+		data.current[i] = data.previous[i];
+		data.current[i].rotation.y += 0.5f;
+	}
+	FrameTimes times;
+	if (!frame_times_init(&times, JOBS_BENCH_RUNS)) {
+		log_error("out of memory");
+		return 1;
+	}
+
+	printf("%ld CPUs, %d objects, grain %d, %d runs each, times in ms\n",
+		   cpus, JOBS_BENCH_OBJECTS, JOBS_BENCH_GRAIN, JOBS_BENCH_RUNS);
+	for (size_t w = 0; w < sizeof(jobs_bench_workloads) / sizeof(jobs_bench_workloads[0]); ++w) {
+		const JobsBenchWorkload *workload = &jobs_bench_workloads[w];
+		FrameTimeSummary serial = jobs_bench_run(workload, &data, 0, &times);
+		printf("\n%-10s %8s %9s %9s %9s %11s %9s\n", workload->name, "threads", "p50", "p90", "speedup", "efficiency", "steals");
+		printf("%-10s %8s %9.3f %9.3f %9.2f %10.0f%% %9s\n", "", "serial", serial.p50, serial.p90, 1.0, 100.0, "-");
+		for (int threads = 1; threads <= max_threads; ++threads) {
+			if (!jobs_init(threads)) {
+				return 1;
+			}
+			FrameTimeSummary summary = jobs_bench_run(workload, &data, threads, &times);
+			double speedup = serial.p50 / summary.p50;
+			printf("%-10s %8d %9.3f %9.3f %9.2f %10.0f%% %9.1f\n", "", jobs.count, summary.p50, summary.p90,
+				   speedup, 100.0 * speedup / jobs.count,
+				   (double)jobs_bench_stolen() / (JOBS_BENCH_WARMUP + JOBS_BENCH_RUNS));
+			jobs_shutdown();
+		}
+	}
+
+	frame_times_free(&times);
+	return 0;
+}
@@ -0,0 +1,229 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#include "log.c"
+#include "profiler.c"
+#include "jobs.c"
+
+// Tests of the job system, no GL involved.
+// Every test runs with 1 to --max-threads threads, at least
+// JOBS_TEST_MIN_THREADS even on fewer CPUs since preempted workers are
+// what finds the races. Covers parallel_for ranges, jobs that wait inside
+// jobs, fibers parking on counters and resuming elsewhere, a full deque and
+// jobs started from a thread outside the job system. make jobs-test runs
+// it plain and make jobs-test-tsan under thread sanitizer, which jobs.c is
+// annotated for. Exits with 1 when a check failed.
+
+#define JOBS_TEST_MIN_THREADS 4
+#define JOBS_TEST_ITEMS       100000
+#define JOBS_TEST_ROUNDS      100
+#define JOBS_TEST_NESTED      50   // jobs each running a parallel_for
+#define JOBS_TEST_TREE_DEPTH  5    // JOBS_TEST_TREE_FANOUT^depth leaves
+#define JOBS_TEST_TREE_FANOUT 4
+
+static atomic_int jobs_test_hits[JOBS_TEST_ITEMS];
+// plain ints, so thread sanitizer sees ranges that overlap or jobs that
+// aren't ordered before the wait that returns after them
+static int jobs_test_marks[JOBS_TEST_ITEMS];
+static atomic_int jobs_test_count;
+static int jobs_test_failures;
+
+#define JOBS_TEST_CHECK(condition, ...) do { \
+	if (!(condition)) { \
+		printf("FAIL %s, %d threads: ", __func__, jobs_thread_count()); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+		jobs_test_failures += 1; \
+	} \
+} while (0)
+
+static void jobs_test_clear(void) {
+	for (size_t i = 0; i < JOBS_TEST_ITEMS; ++i) {
+		atomic_store_explicit(&jobs_test_hits[i], 0, memory_order_relaxed);
+	}
+	atomic_store(&jobs_test_count, 0);
+}
+
+// every index of the range once, none outside of it
+static void jobs_test_hit(void *data, size_t begin, size_t end) {
+	(void) data;
+	for (size_t i = begin; i < end; ++i) {
+		atomic_fetch_add_explicit(&jobs_test_hits[i], 1, memory_order_relaxed);
+	}
+}
+
+static void jobs_test_expect_hits(const char *test, size_t count, int times) {
+	for (size_t i = 0; i < JOBS_TEST_ITEMS; ++i) {
+		int hits = atomic_load_explicit(&jobs_test_hits[i], memory_order_relaxed);
+		int expected = i < count ? times : 0;
+		if (hits != expected) {
+			printf("FAIL %s, %d threads: index %zu of %zu hit %d times, not %d\n",
+				   test, jobs_thread_count(), i, count, hits, expected);
+			jobs_test_failures += 1;
+			return;
+		}
+	}
+}
+
+static void jobs_test_mark(void *data, size_t begin, size_t end) {
+	int round = *(const int *)data;
+	for (size_t i = begin; i < end; ++i) {
+		jobs_test_marks[i] = round;
+	}
+}
+
+static void jobs_test_parallel_for(void) {
+	memset(jobs_test_marks, 0xff, sizeof(jobs_test_marks));
+	for (int round = 0; round < JOBS_TEST_ROUNDS; ++round) {
+		size_t count = (size_t)round * 7919 % JOBS_TEST_ITEMS;
+		size_t grain = 1 + round % 50;
+		jobs_test_clear();
+		jobs_parallel_for(count, grain, jobs_test_hit, NULL);
+		jobs_test_expect_hits(__func__, count, 1);
+
+		jobs_parallel_for(count, grain, jobs_test_mark, &round);
+		size_t wrong = 0;
+		while (wrong < count && jobs_test_marks[wrong] == round) ++wrong;
+		JOBS_TEST_CHECK(wrong == count, "index %zu of %zu not marked", wrong, count);
+	}
+}
+
+static void jobs_test_nested_job(void *data, size_t begin, size_t end) {
+	jobs_parallel_for(1000, 7, jobs_test_hit, data);
+}
+
+// parallel_fors inside jobs, their waits park the jobs' fibers
+static void jobs_test_nested(void) {
+	jobs_test_clear();
+	JobCounter counter = {0};
+	for (int i = 0; i < JOBS_TEST_NESTED; ++i) {
+		jobs_run(jobs_test_nested_job, NULL, &counter);
+	}
+	jobs_wait(&counter);
+	jobs_test_expect_hits(__func__, 1000, JOBS_TEST_NESTED);
+}
+
+// every level starts its children and waits for them
+static void jobs_test_tree_job(void *data, size_t begin, size_t end) {
+	intptr_t depth = (intptr_t)data;
+	if (depth == 0) {
+		atomic_fetch_add(&jobs_test_count, 1);
+		return;
+	}
+	JobCounter children = {0};
+	for (int i = 0; i < JOBS_TEST_TREE_FANOUT; ++i) {
+		jobs_run(jobs_test_tree_job, (void *)(depth - 1), &children);
+	}
+	jobs_wait(&children);
+}
+
+static uint64_t jobs_test_parked_total(void) {
+	uint64_t parked = 0;
+	for (int i = 0; i < jobs.count; ++i) {
+		parked += jobs.workers[i].parked;
+	}
+	return parked;
+}
+
+static void jobs_test_parked(void) {
+	int leaves = 1;
+	for (int i = 0; i < JOBS_TEST_TREE_DEPTH; ++i) leaves *= JOBS_TEST_TREE_FANOUT;
+	uint64_t parked = jobs_test_parked_total();
+	for (int round = 0; round < 5; ++round) {
+		jobs_test_clear();
+		JobCounter counter = {0};
+		jobs_run(jobs_test_tree_job, (void *)(intptr_t)JOBS_TEST_TREE_DEPTH, &counter);
+		jobs_wait(&counter);
+		int count = atomic_load(&jobs_test_count);
+		JOBS_TEST_CHECK(count == leaves, "%d leaves, not %d", count, leaves);
+	}
+	// with workers the root runs on a fiber and parks on its children
+	JOBS_TEST_CHECK(jobs.count <= 1 || jobs_test_parked_total() > parked, "no fiber parked");
+}
+
+static void jobs_test_count_one(void *data, size_t begin, size_t end) {
+	atomic_fetch_add(&jobs_test_count, 1);
+}
+
+// more jobs than a deque holds, the rest run right away
+static void jobs_test_full_deque(void) {
+	jobs_test_clear();
+	JobCounter counter = {0};
+	for (int i = 0; i < 2 * JOBS_DEQUE_SIZE; ++i) {
+		jobs_run(jobs_test_count_one, NULL, &counter);
+	}
+	jobs_wait(&counter);
+	int count = atomic_load(&jobs_test_count);
+	JOBS_TEST_CHECK(count == 2 * JOBS_DEQUE_SIZE, "%d jobs ran, not %d", count, 2 * JOBS_DEQUE_SIZE);
+}
+
+static void jobs_test_outside_job(void *data, size_t begin, size_t end) {
+	atomic_fetch_add(&jobs_test_count, 1);
+	jobs_parallel_for(1000, 7, jobs_test_hit, data);
+}
+
+// like the render thread, more at once than the shared queue holds
+static void *jobs_test_outside_main(void *arg) {
+	JobCounter counter = {0};
+	for (int i = 0; i < 4 * JOBS_OUTSIDE_SIZE; ++i) {
+		jobs_run(jobs_test_outside_job, NULL, &counter);
+	}
+	jobs_wait(&counter);
+	return NULL;
+}
+
+static void jobs_test_outside(void) {
+	jobs_test_clear();
+	pthread_t thread;
+	int error = pthread_create(&thread, NULL, jobs_test_outside_main, NULL);
+	JOBS_TEST_CHECK(error == 0, "could not start a thread: %s", strerror(error));
+	if (error != 0) {
+		return;
+	}
+	pthread_join(thread, NULL);
+	int count = atomic_load(&jobs_test_count);
+	JOBS_TEST_CHECK(count == 4 * JOBS_OUTSIDE_SIZE, "%d jobs ran, not %d", count, 4 * JOBS_OUTSIDE_SIZE);
+	jobs_test_expect_hits(__func__, 1000, 4 * JOBS_OUTSIDE_SIZE);
+}
+
+int main(int argc, char **argv) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max_threads = cpus > JOBS_TEST_MIN_THREADS ? (int)cpus : JOBS_TEST_MIN_THREADS;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc && (max_threads = atoi(argv[i + 1])) > 0) {
+			++i;
+		} else {
+			fprintf(stderr, "usage: %s [--max-threads N]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (max_threads > JOBS_MAX_WORKERS) max_threads = JOBS_MAX_WORKERS;
+
+	log_init();
+	profiler_init();
+
+	for (int threads = 1; threads <= max_threads; ++threads) {
+		if (!jobs_init(threads)) {
+			return 1;
+		}
+		jobs_test_parallel_for();
+		jobs_test_nested();
+		jobs_test_parked();
+		jobs_test_full_deque();
+		jobs_test_outside();
+		printf("%d threads: %llu parked\n", jobs.count, (unsigned long long)jobs_test_parked_total());
+		jobs_shutdown();
+	}
+
+	if (jobs_test_failures > 0) {
+		printf("%d checks failed\n", jobs_test_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,7 @@
+uniform vec3 u_light_dir;  // should be normalized
+
+vec3 lighting_diffuse(vec3 N, vec3 albedo) {
+	vec3 L = normalize(-u_light_dir); // assuming dir *toward* the surface
+	float diff = max(dot(N, L), 0.0);
+	return albedo * diff;
+}
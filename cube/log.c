@@ -0,0 +1,305 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Asynchronous logger.
+// Any thread formats its message straight into a slot of a bounded lock-free
+// queue (Vyukov's, with a sequence number per slot) and returns, a flusher
+// thread writes the queue out to stderr every few milliseconds. A full
+// queue drops the message and counts it instead of blocking.
+// Messages carry an id, the GL message id for driver messages and the call
+// site otherwise. Each id may log LOG_RATE_LIMIT messages per second, the
+// rest are suppressed and counted in its next message, and runs of the same
+// message are collapsed by the flusher into one line and a repeat count.
+// Before log_init, and if the thread can't be started, messages are written
+// synchronously.
+
+#define LOG_QUEUE_SIZE   1024 // power of two
+#define LOG_MESSAGE_SIZE 240
+#define LOG_RATE_SLOTS   256  // power of two
+#define LOG_RATE_PROBES  8
+#define LOG_RATE_LIMIT   10   // messages per id per window
+#define LOG_RATE_WINDOW_NS  1000000000ull
+#define LOG_FLUSH_INTERVAL_NS  2000000 // how long the flusher sleeps when idle
+
+typedef enum {
+	LOG_DEBUG = 0,
+	LOG_INFO,
+	LOG_WARNING,
+	LOG_ERROR,
+	LOG_LEVEL_COUNT,
+} LogLevel;
+
+const char *log_level_names[LOG_LEVEL_COUNT] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+typedef struct {
+	_Atomic size_t sequence; // == position: free, == position + 1: written
+	LogLevel level;
+	uint64_t id;
+	char text[LOG_MESSAGE_SIZE];
+} LogSlot;
+
+typedef struct {
+	_Atomic uint64_t id; // 0 while unclaimed
+	_Atomic uint64_t window_start_ns;
+	atomic_uint count;
+	atomic_uint suppressed;
+} LogRate;
+
+static struct {
+	LogSlot slots[LOG_QUEUE_SIZE];
+	_Atomic size_t tail; // next position producers claim
+	size_t head;         // next position the flusher reads, flusher only
+	_Atomic size_t flushed; // positions written out so far
+	atomic_int level;
+	atomic_bool running;
+	_Atomic uint64_t dropped;
+	LogRate rates[LOG_RATE_SLOTS];
+	pthread_t thread;
+
+	// flusher only: the message being collapsed and how often it came again
+	LogLevel last_level;
+	uint64_t last_id;
+	char last_text[LOG_MESSAGE_SIZE];
+	uint32_t repeats;
+	char out[16384];
+	size_t out_size;
+} logger = { .level = LOG_INFO };
+
+static uint64_t log_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void log_set_level(LogLevel level) {
+	atomic_store_explicit(&logger.level, level, memory_order_relaxed);
+}
+
+LogLevel log_level(void) {
+	return atomic_load_explicit(&logger.level, memory_order_relaxed);
+}
+
+// Returns false when the message goes over its id's budget. suppressed gets
+// how many were dropped since the last message that went through.
+static bool log_rate_admit(uint64_t id, uint32_t *suppressed) {
+	*suppressed = 0;
+	LogRate *rate = NULL;
+	for (uint32_t i = 0; i < LOG_RATE_PROBES; ++i) {
+		LogRate *slot = &logger.rates[(id + i) & (LOG_RATE_SLOTS - 1)];
+		uint64_t slot_id = atomic_load_explicit(&slot->id, memory_order_relaxed);
+		if (slot_id == 0) {
+			atomic_compare_exchange_strong_explicit(&slot->id, &slot_id, id, memory_order_relaxed, memory_order_relaxed);
+			// slot_id now holds whoever won, possibly us
+			if (slot_id == 0) slot_id = id;
+		}
+		if (slot_id == id) {
+			rate = slot;
+			break;
+		}
+	}
+	// too many distinct ids to track, let it through unlimited
+	if (rate == NULL) {
+		return true;
+	}
+
+	uint64_t now = log_now_ns();
+	uint64_t window_start = atomic_load_explicit(&rate->window_start_ns, memory_order_relaxed);
+	if (now - window_start >= LOG_RATE_WINDOW_NS
+		&& atomic_compare_exchange_strong_explicit(&rate->window_start_ns, &window_start, now,
+												   memory_order_relaxed, memory_order_relaxed)) {
+		atomic_store_explicit(&rate->count, 0, memory_order_relaxed);
+	}
+	if (atomic_fetch_add_explicit(&rate->count, 1, memory_order_relaxed) >= LOG_RATE_LIMIT) {
+		atomic_fetch_add_explicit(&rate->suppressed, 1, memory_order_relaxed);
+		return false;
+	}
+	*suppressed = atomic_exchange_explicit(&rate->suppressed, 0, memory_order_relaxed);
+	return true;
+}
+
+static void log_out_flush(void) {
+	if (logger.out_size > 0) {
+		fwrite(logger.out, 1, logger.out_size, stderr);
+		fflush(stderr);
+		logger.out_size = 0;
+	}
+}
+
+static void log_out(const char *format, ...) {
+	if (logger.out_size + LOG_MESSAGE_SIZE + 64 > sizeof(logger.out)) {
+		log_out_flush();
+	}
+	va_list args;
+	va_start(args, format);
+	int size = vsnprintf(logger.out + logger.out_size, sizeof(logger.out) - logger.out_size, format, args);
+	va_end(args);
+	if (size > 0) {
+		size_t left = sizeof(logger.out) - logger.out_size - 1;
+		logger.out_size += (size_t)size < left ? (size_t)size : left;
+	}
+}
+
+static void log_out_repeats(void) {
+	if (logger.repeats > 0) {
+		log_out("[%s]: last message repeated %u times\n", log_level_names[logger.last_level], logger.repeats);
+		logger.repeats = 0;
+	}
+}
+
+static void log_out_slot(const LogSlot *slot) {
+	if (slot->id == logger.last_id && strcmp(slot->text, logger.last_text) == 0) {
+		logger.repeats += 1;
+		return;
+	}
+	log_out_repeats();
+	log_out("[%s]: %s\n", log_level_names[slot->level], slot->text);
+	logger.last_level = slot->level;
+	logger.last_id = slot->id;
+	memcpy(logger.last_text, slot->text, sizeof(logger.last_text));
+}
+
+// flusher only, returns how many messages were written
+static size_t log_drain(void) {
+	size_t count = 0;
+	for (;;) {
+		LogSlot *slot = &logger.slots[logger.head & (LOG_QUEUE_SIZE - 1)];
+		if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != logger.head + 1) {
+			break;
+		}
+		log_out_slot(slot);
+		atomic_store_explicit(&slot->sequence, logger.head + LOG_QUEUE_SIZE, memory_order_release);
+		logger.head += 1;
+		count += 1;
+	}
+	uint64_t dropped = atomic_exchange_explicit(&logger.dropped, 0, memory_order_relaxed);
+	if (dropped > 0) {
+		log_out_repeats();
+		log_out("[WARNING]: log queue full, %llu messages dropped\n", (unsigned long long)dropped);
+	}
+	// a repeat count is only known once something else arrives, or nothing does
+	if (count == 0) {
+		log_out_repeats();
+		logger.last_id = 0;
+	}
+	log_out_flush();
+	atomic_store_explicit(&logger.flushed, logger.head, memory_order_release);
+	return count;
+}
+
+static void *log_thread_main(void *arg) {
+	(void) arg;
+	while (atomic_load_explicit(&logger.running, memory_order_acquire)) {
+		if (log_drain() == 0) {
+			struct timespec idle = { 0, LOG_FLUSH_INTERVAL_NS };
+			nanosleep(&idle, NULL);
+		}
+	}
+	return NULL;
+}
+
+// stops the flusher after writing out everything queued, runs at exit too
+void log_shutdown(void) {
+	if (!atomic_exchange(&logger.running, false)) {
+		return;
+	}
+	pthread_join(logger.thread, NULL);
+	log_drain();
+	log_drain(); // an empty drain writes out the last repeat count
+}
+
+void log_init(void) {
+	if (atomic_load(&logger.running)) {
+		return;
+	}
+	logger.head = 0;
+	atomic_store(&logger.tail, 0);
+	atomic_store(&logger.flushed, 0);
+	for (size_t i = 0; i < LOG_QUEUE_SIZE; ++i) {
+		atomic_init(&logger.slots[i].sequence, i);
+	}
+	atomic_store(&logger.running, true);
+	int error = pthread_create(&logger.thread, NULL, log_thread_main, NULL);
+	if (error != 0) {
+		atomic_store(&logger.running, false);
+		fprintf(stderr, "[WARNING]: could not start the log thread, logging synchronously: %s\n", strerror(error));
+		return;
+	}
+	atexit(log_shutdown);
+}
+
+// waits until everything logged before the call is written out
+void log_flush(void) {
+	size_t target = atomic_load_explicit(&logger.tail, memory_order_relaxed);
+	while (atomic_load_explicit(&logger.running, memory_order_relaxed)
+		   && atomic_load_explicit(&logger.flushed, memory_order_acquire) < target) {
+		struct timespec wait = { 0, LOG_FLUSH_INTERVAL_NS / 2 };
+		nanosleep(&wait, NULL);
+	}
+}
+
+// id 0 uses the format string's address, one id per call site
+__attribute__((format(printf, 3, 4)))
+void log_message(LogLevel level, uint64_t id, const char *format, ...) {
+	if (level < log_level()) {
+		return;
+	}
+	if (id == 0) {
+		id = (uintptr_t)format;
+	}
+	uint32_t suppressed = 0;
+	if (!log_rate_admit(id, &suppressed)) {
+		return;
+	}
+
+	va_list args;
+	if (!atomic_load_explicit(&logger.running, memory_order_acquire)) {
+		char text[LOG_MESSAGE_SIZE];
+		va_start(args, format);
+		vsnprintf(text, sizeof(text), format, args);
+		va_end(args);
+		fprintf(stderr, "[%s]: %s\n", log_level_names[level], text);
+		return;
+	}
+
+	size_t position = atomic_load_explicit(&logger.tail, memory_order_relaxed);
+	LogSlot *slot;
+	for (;;) {
+		slot = &logger.slots[position & (LOG_QUEUE_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+		if (difference == 0) {
+			if (atomic_compare_exchange_weak_explicit(&logger.tail, &position, position + 1,
+													  memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+			return;
+		} else {
+			position = atomic_load_explicit(&logger.tail, memory_order_relaxed);
+		}
+	}
+
+	slot->level = level;
+	slot->id = id;
+	va_start(args, format);
+	int size = vsnprintf(slot->text, sizeof(slot->text), format, args);
+	va_end(args);
+	if (suppressed > 0 && size >= 0 && (size_t)size < sizeof(slot->text)) {
+		snprintf(slot->text + size, sizeof(slot->text) - size, " (%u like it suppressed)", suppressed);
+	}
+	atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+}
+
+#define log_debug(format, ...)   log_message(LOG_DEBUG,   0, format, ##__VA_ARGS__)
+#define log_info(format, ...)    log_message(LOG_INFO,    0, format, ##__VA_ARGS__)
+#define log_warning(format, ...) log_message(LOG_WARNING, 0, format, ##__VA_ARGS__)
+#define log_error(format, ...)   log_message(LOG_ERROR,   0, format, ##__VA_ARGS__)
+
@@ -1,4 +1,5 @@
 #include <math.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "glad.h"
@@ -24,13 +25,13 @@ typedef struct {
 } Vertex;
 
 typedef uint32_t Index;
+// the CPU side of a mesh, mesh_create in mesh.c uploads it
 typedef struct {
 	Vertex* vertices;
 	Index* indices;
 	size_t vertices_count;
 	size_t indices_count;
-	GLuint vao, vbo, ebo;
-	GLint loc_mvp, loc_color, loc_model, loc_light_dir;
+	bool owned; // vertices and indices were malloced and go with the mesh
 } Mesh;
 
 
@@ -243,6 +244,19 @@ float v3f_dot(V3f a, V3f b) {
 	return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
+V3f v3f_lerp(V3f a, V3f b, float t) {
+	return (V3f){ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+}
+
+// rotations are Euler angles that never wrap, so they lerp like the rest
+Transform transform_lerp(const Transform *a, const Transform *b, float t) {
+	return (Transform){
+		.position = v3f_lerp(a->position, b->position, t),
+		.rotation = v3f_lerp(a->rotation, b->rotation, t),
+		.scale    = v3f_lerp(a->scale,    b->scale,    t),
+	};
+}
+
 
 
 
@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "glad.h"
+
+// Uploaded meshes behind MeshHandles, see pool.c.
+// A draw reads the vertex array, where the mesh is in it and the index
+// count and nothing else, so those are the whole hot part, plus the frame
+// it was last drawn in. Where its ranges are in the mesh heap, the CPU copy
+// of the vertices and the name are cold, see mesh_heap.c.
+// Over the GPU memory budget, the meshes of the heap page drawn longest ago
+// give up their ranges, which releases the page, and keep only the CPU
+// copy. mesh_use uploads them again the next time they're drawn.
+
+#define MESH_MAX 256
+#define MESH_RELOCATIONS 4 // per frame at most, of meshes in fragmented pages
+
+typedef uint32_t MeshHandle; // 0 is never a valid handle
+
+typedef struct {
+	GLuint vao; // of its heap page, 0 while evicted
+	uint32_t indices_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t used; // the frame mesh_use last saw it in
+} MeshHot;
+
+typedef struct {
+	MeshHeapRange range;
+	Mesh data;
+	const char *name; // not owned, must outlive the mesh
+} MeshCold;
+
+static struct {
+	HandlePool pool;
+	MeshHot hot[MESH_MAX];
+	MeshCold cold[MESH_MAX];
+	uint32_t frame;
+} meshes = { .pool = POOL_INIT("meshes", MESH_MAX) };
+
+static void mesh_place(uint32_t position) {
+	MeshHot *hot = &meshes.hot[position];
+	const MeshHeapRange *range = &meshes.cold[position].range;
+	hot->vao = mesh_heap_vertex_array(range);
+	hot->first_index = range->first[MESH_HEAP_INDICES];
+	hot->base_vertex = (int32_t)range->first[MESH_HEAP_VERTICES];
+}
+
+// leaves the vertex array bound if it takes a new heap page, false if the
+// mesh heap has no room
+static bool mesh_upload(uint32_t position) {
+	if (!mesh_heap_alloc(&meshes.cold[position].data, &meshes.cold[position].range)) {
+		return false;
+	}
+	mesh_place(position);
+	return true;
+}
+
+// the ranges are given back once the GPU is done with the frames that drew it
+static void mesh_unload(uint32_t position) {
+	mesh_heap_free(&meshes.cold[position].range);
+	meshes.hot[position].vao = 0;
+}
+
+// Uploads data, the mesh keeps it and frees it on destruction if it's
+// owned. 0 if there's no room for it, data stays the caller's then.
+MeshHandle mesh_create(const Mesh *data, const char *name) {
+	uint32_t position = 0;
+	MeshHandle handle = pool_acquire(&meshes.pool, &position);
+	if (handle == 0) {
+		return 0;
+	}
+	meshes.hot[position] = (MeshHot){ .indices_count = (uint32_t)data->indices_count, .used = meshes.frame };
+	meshes.cold[position] = (MeshCold){ .data = *data, .name = name };
+	if (!mesh_upload(position)) {
+		uint32_t to = 0, from = 0;
+		pool_release(&meshes.pool, handle, &to, &from);
+		meshes.hot[to] = meshes.hot[from];
+		meshes.cold[to] = meshes.cold[from];
+		return 0;
+	}
+	return handle;
+}
+
+// NULL once the mesh was destroyed. Any thread may read the index count,
+// the vertex array is only valid after mesh_use.
+const MeshHot *mesh_get(MeshHandle handle) {
+	uint32_t position = 0;
+	return pool_find(&meshes.pool, handle, &position) ? &meshes.hot[position] : NULL;
+}
+
+// mesh_get for drawing on the GL thread, reloads an evicted mesh. NULL
+// if there's no room to.
+const MeshHot *mesh_use(MeshHandle handle) {
+	uint32_t position = 0;
+	if (!pool_find(&meshes.pool, handle, &position)) {
+		return NULL;
+	}
+	MeshHot *hot = &meshes.hot[position];
+	if (hot->vao == 0) {
+		if (!mesh_upload(position)) {
+			return NULL;
+		}
+		gpu_memory_count_reload();
+	}
+	hot->used = meshes.frame;
+	return hot;
+}
+
+void mesh_destroy(MeshHandle handle) {
+	uint32_t position = 0;
+	if (!pool_find(&meshes.pool, handle, &position)) {
+		log_error("destroyed stale mesh handle %08x", handle);
+		return;
+	}
+	MeshCold *cold = &meshes.cold[position];
+	if (meshes.hot[position].vao != 0) {
+		mesh_unload(position);
+	}
+	if (cold->data.owned) {
+		free(cold->data.vertices);
+		free(cold->data.indices);
+	}
+	uint32_t to = 0, from = 0;
+	pool_release(&meshes.pool, handle, &to, &from);
+	meshes.hot[to] = meshes.hot[from];
+	meshes.cold[to] = meshes.cold[from];
+}
+
+// moves a few meshes of fragmented heap pages lower down in them
+static void mesh_defragment(void) {
+	uint32_t relocations = 0;
+	for (uint32_t i = 0; i < meshes.pool.count && relocations < MESH_RELOCATIONS; ++i) {
+		MeshCold *cold = &meshes.cold[i];
+		if (meshes.hot[i].vao != 0 && mesh_heap_fragmented(&cold->range) && mesh_heap_relocate(&cold->range)) {
+			mesh_place(i);
+			relocations += 1;
+		}
+	}
+}
+
+// The heap page whose last drawn mesh was drawn longest ago, of those
+// without a mesh this frame drew or one that couldn't be reloaded.
+// MESH_HEAP_MAX_PAGES if there's none.
+static uint32_t mesh_oldest_page(void) {
+	uint32_t newest[MESH_HEAP_MAX_PAGES]; // frames since a mesh of it was drawn
+	bool pinned[MESH_HEAP_MAX_PAGES] = { false };
+	for (uint32_t page = 0; page < MESH_HEAP_MAX_PAGES; ++page) {
+		newest[page] = UINT32_MAX;
+	}
+	for (uint32_t i = 0; i < meshes.pool.count; ++i) {
+		const MeshHot *hot = &meshes.hot[i];
+		if (hot->vao == 0) {
+			continue;
+		}
+		uint32_t page = meshes.cold[i].range.page;
+		uint32_t age = meshes.frame - hot->used;
+		// without a CPU copy there'd be nothing to reload from
+		if (age == 0 || meshes.cold[i].data.vertices == NULL) {
+			pinned[page] = true;
+		}
+		if (age < newest[page]) {
+			newest[page] = age;
+		}
+	}
+	uint32_t oldest = MESH_HEAP_MAX_PAGES;
+	for (uint32_t page = 0; page < MESH_HEAP_MAX_PAGES; ++page) {
+		if (!pinned[page] && newest[page] != UINT32_MAX
+			&& (oldest == MESH_HEAP_MAX_PAGES || newest[page] > newest[oldest])) {
+			oldest = page;
+		}
+	}
+	return oldest;
+}
+
+// Call once per frame on the GL thread after the last draw. While GPU
+// memory is over budget, drops the recycled buffers, then evicts the
+// meshes of the heap page drawn longest ago, which releases it. Pages with
+// a mesh this frame drew stay. Then moves a few meshes to defragment the
+// mesh heap.
+void mesh_frame_end(void) {
+	while (gpu_memory_over_budget() > 0) {
+		retire_drop_recycled();
+		if (gpu_memory_over_budget() == 0) {
+			break;
+		}
+		uint32_t page = mesh_oldest_page();
+		if (page == MESH_HEAP_MAX_PAGES) {
+			break;
+		}
+		for (uint32_t i = 0; i < meshes.pool.count; ++i) {
+			if (meshes.hot[i].vao != 0 && meshes.cold[i].range.page == page) {
+				mesh_unload(i);
+				gpu_memory_count_eviction();
+			}
+		}
+	}
+	mesh_defragment();
+	meshes.frame += 1;
+}
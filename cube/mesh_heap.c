@@ -0,0 +1,335 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "glad.h"
+
+// Vertices and indices of meshes, sub-allocated from a few large buffers.
+// A pair of buffers per mesh costs a driver allocation each time one is
+// created, and meshes streaming in and out fragment the driver's heap as
+// much as they would ours. So meshes share pages instead, a vertex buffer,
+// an index buffer and the vertex array over both, and take ranges of them
+// from a Tlsf per buffer counting in vertices and indices, see tlsf.c.
+// Meshes draw with a base vertex and an index offset, which lets the ones
+// in the same page share its vertex array too.
+// Freed ranges are given back once the GPU is done with the frames that
+// drew them, see retire.c, they count as heap free from the start. The
+// budget counts pages whole, so a page goes as soon as no range of it is
+// in use, its buffers retire like any other. Ranges of it still retiring
+// are dropped then, the page's generation tells them apart from ranges of
+// a page that took its place.
+// Churn leaves free space in holes, maybe too small for the next mesh.
+// mesh_heap_relocate moves a range into a hole lower down, copying on the
+// GPU, mesh_frame_end calls it for a few meshes of fragmented pages.
+// GL thread only.
+
+#define MESH_HEAP_MAX_PAGES     8
+#define MESH_HEAP_PAGE_VERTICES (1u << 16) // 1.5 MB
+#define MESH_HEAP_PAGE_INDICES  (1u << 18) // 1 MB
+#define MESH_HEAP_FRAGMENTED    0.25f // fragmentation worth moving ranges for
+
+typedef enum {
+	MESH_HEAP_VERTICES = 0,
+	MESH_HEAP_INDICES,
+	MESH_HEAP_KINDS,
+} MeshHeapKind;
+
+static const char *mesh_heap_names[MESH_HEAP_KINDS] = { "vertices", "indices" };
+static const uint32_t mesh_heap_units[MESH_HEAP_KINDS] = { sizeof(Vertex), sizeof(Index) };
+static const uint32_t mesh_heap_page_units[MESH_HEAP_KINDS] = { MESH_HEAP_PAGE_VERTICES, MESH_HEAP_PAGE_INDICES };
+static const GpuMemoryCategory mesh_heap_categories[MESH_HEAP_KINDS] = { GPU_MEMORY_VERTEX, GPU_MEMORY_INDEX };
+
+// where a mesh's vertices and indices are, in units of each
+typedef struct {
+	uint32_t page;
+	uint32_t blocks[MESH_HEAP_KINDS];
+	uint32_t first[MESH_HEAP_KINDS];
+} MeshHeapRange;
+
+typedef struct {
+	GLuint vao; // 0 while the slot has no page
+	BufferHandle buffers[MESH_HEAP_KINDS];
+	Tlsf tlsf[MESH_HEAP_KINDS];
+	uint32_t retiring[MESH_HEAP_KINDS]; // units freed and not given back yet
+	uint16_t generation; // of the slot, counts pages released from it
+} MeshHeapPage;
+
+typedef struct {
+	uint32_t pages;
+	TlsfStats kinds[MESH_HEAP_KINDS]; // summed over pages, the worst fragmentation
+	uint64_t moves, moved_bytes; // by mesh_heap_relocate, since the start
+} MeshHeapStats;
+
+static struct {
+	MeshHeapPage pages[MESH_HEAP_MAX_PAGES];
+	uint32_t pages_count; // slots ever used, some may be empty again
+	uint64_t moves, moved_bytes;
+} mesh_heap;
+
+// in the first empty slot, leaves the page's vertex array bound
+static bool mesh_heap_add_page(uint32_t *page_index) {
+	uint32_t index = 0;
+	while (index < mesh_heap.pages_count && mesh_heap.pages[index].vao != 0) {
+		index += 1;
+	}
+	if (index == MESH_HEAP_MAX_PAGES) {
+		return false;
+	}
+	MeshHeapPage *page = &mesh_heap.pages[index];
+	glGenVertexArrays(1, &page->vao);
+	render_bind_vertex_array(page->vao);
+	page->buffers[MESH_HEAP_VERTICES] = buffer_create(GL_ARRAY_BUFFER, MESH_HEAP_PAGE_VERTICES * sizeof(Vertex),
+													  NULL, GL_STATIC_DRAW, "mesh heap vertices");
+	// the element buffer binding is part of the vertex array
+	page->buffers[MESH_HEAP_INDICES] = buffer_create(GL_ELEMENT_ARRAY_BUFFER, MESH_HEAP_PAGE_INDICES * sizeof(Index),
+													 NULL, GL_STATIC_DRAW, "mesh heap indices");
+	if (page->buffers[MESH_HEAP_VERTICES] == 0 || page->buffers[MESH_HEAP_INDICES] == 0) {
+		for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+			if (page->buffers[kind] != 0) {
+				buffer_destroy(page->buffers[kind]);
+			}
+		}
+		render_state_forget_vertex_array(page->vao);
+		retire_vertex_array(page->vao);
+		*page = (MeshHeapPage){ .generation = page->generation };
+		return false;
+	}
+	render_bind_buffer(GL_ARRAY_BUFFER, buffer_name(page->buffers[MESH_HEAP_VERTICES]));
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+
+	for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+		buffer_set_category(page->buffers[kind], GPU_MEMORY_HEAP_FREE);
+		tlsf_init(&page->tlsf[kind], mesh_heap_page_units[kind]);
+		page->retiring[kind] = 0;
+	}
+	if (index == mesh_heap.pages_count) {
+		mesh_heap.pages_count += 1;
+	}
+	*page_index = index;
+	return true;
+}
+
+// Destroys the page's buffers and vertex array, which retire until the GPU
+// is done with them. The ranges still retiring count as part of them.
+static void mesh_heap_release_page(MeshHeapPage *page) {
+	for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+		buffer_destroy(page->buffers[kind]);
+	}
+	render_state_forget_vertex_array(page->vao);
+	retire_vertex_array(page->vao);
+	*page = (MeshHeapPage){ .generation = (uint16_t)(page->generation + 1) };
+}
+
+// units of ranges in use, not counting those retiring
+static uint32_t mesh_heap_live(const MeshHeapPage *page, MeshHeapKind kind) {
+	const Tlsf *tlsf = &page->tlsf[kind];
+	return tlsf->size - tlsf->free - page->retiring[kind];
+}
+
+static bool mesh_heap_take(MeshHeapPage *page, MeshHeapKind kind, uint32_t count, uint32_t *block, uint32_t *first) {
+	if (!tlsf_alloc(&page->tlsf[kind], count, 1, block, first)) {
+		return false;
+	}
+	gpu_memory_shift(GPU_MEMORY_HEAP_FREE, mesh_heap_categories[kind], (uint64_t)count * mesh_heap_units[kind]);
+	return true;
+}
+
+// value is the page's generation, its index, the kind and the block from
+// the high bits down
+static void mesh_heap_retired(uint64_t value) {
+	uint16_t generation = (uint16_t)(value >> 48);
+	uint32_t page_index = (uint32_t)((value >> 40) & 0xff);
+	MeshHeapKind kind = (MeshHeapKind)((value >> 32) & 0xff);
+	uint32_t block = (uint32_t)value;
+	// the page went with the range, or mesh_heap_shutdown took everything
+	if (page_index >= mesh_heap.pages_count || mesh_heap.pages[page_index].generation != generation) {
+		return;
+	}
+	MeshHeapPage *page = &mesh_heap.pages[page_index];
+	page->retiring[kind] -= tlsf_size(&page->tlsf[kind], block);
+	tlsf_free(&page->tlsf[kind], block);
+}
+
+// Back to the page once the GPU is done with it. Releases the page if that
+// was the last range in use.
+static void mesh_heap_give_back(uint32_t page_index, MeshHeapKind kind, uint32_t block) {
+	MeshHeapPage *page = &mesh_heap.pages[page_index];
+	uint32_t count = tlsf_size(&page->tlsf[kind], block);
+	gpu_memory_shift(mesh_heap_categories[kind], GPU_MEMORY_HEAP_FREE, (uint64_t)count * mesh_heap_units[kind]);
+	page->retiring[kind] += count;
+	if (mesh_heap_live(page, MESH_HEAP_VERTICES) == 0 && mesh_heap_live(page, MESH_HEAP_INDICES) == 0) {
+		mesh_heap_release_page(page);
+		return;
+	}
+	retire_call(mesh_heap_retired, ((uint64_t)page->generation << 48) | ((uint64_t)page_index << 40)
+				| ((uint64_t)kind << 32) | block);
+}
+
+static void mesh_heap_upload(const MeshHeapPage *page, MeshHeapKind kind, uint32_t first, uint32_t count,
+							 const void *data) {
+	// not the element array binding, that would change the bound vertex array
+	render_bind_buffer(GL_COPY_WRITE_BUFFER, buffer_name(page->buffers[kind]));
+	render_buffer_sub_data(GL_COPY_WRITE_BUFFER, (GLintptr)first * mesh_heap_units[kind],
+						   (GLsizeiptr)count * mesh_heap_units[kind], data);
+}
+
+static bool mesh_heap_alloc_in(uint32_t page_index, const uint32_t counts[MESH_HEAP_KINDS], MeshHeapRange *range) {
+	MeshHeapPage *page = &mesh_heap.pages[page_index];
+	if (!mesh_heap_take(page, MESH_HEAP_VERTICES, counts[MESH_HEAP_VERTICES], &range->blocks[MESH_HEAP_VERTICES],
+						&range->first[MESH_HEAP_VERTICES])) {
+		return false;
+	}
+	if (!mesh_heap_take(page, MESH_HEAP_INDICES, counts[MESH_HEAP_INDICES], &range->blocks[MESH_HEAP_INDICES],
+						&range->first[MESH_HEAP_INDICES])) {
+		// nothing read it yet, it can go back right away
+		gpu_memory_shift(GPU_MEMORY_VERTEX, GPU_MEMORY_HEAP_FREE, (uint64_t)counts[MESH_HEAP_VERTICES] * sizeof(Vertex));
+		tlsf_free(&page->tlsf[MESH_HEAP_VERTICES], range->blocks[MESH_HEAP_VERTICES]);
+		return false;
+	}
+	range->page = page_index;
+	return true;
+}
+
+// Takes ranges for data's vertices and indices in the first page with room
+// for both, a new one if none has, and uploads them. False if they don't
+// fit a page or there can't be more pages.
+bool mesh_heap_alloc(const Mesh *data, MeshHeapRange *range) {
+	uint32_t counts[MESH_HEAP_KINDS] = { (uint32_t)data->vertices_count, (uint32_t)data->indices_count };
+	bool found = false;
+	if (counts[MESH_HEAP_VERTICES] <= MESH_HEAP_PAGE_VERTICES && counts[MESH_HEAP_INDICES] <= MESH_HEAP_PAGE_INDICES) {
+		for (uint32_t i = 0; i < mesh_heap.pages_count && !found; ++i) {
+			found = mesh_heap.pages[i].vao != 0 && mesh_heap_alloc_in(i, counts, range);
+		}
+		uint32_t added = 0;
+		if (!found && mesh_heap_add_page(&added)) {
+			found = mesh_heap_alloc_in(added, counts, range);
+		}
+	}
+	if (!found) {
+		log_error("no room for a mesh of %u vertices and %u indices in the mesh heap",
+				  counts[MESH_HEAP_VERTICES], counts[MESH_HEAP_INDICES]);
+		return false;
+	}
+	const MeshHeapPage *page = &mesh_heap.pages[range->page];
+	mesh_heap_upload(page, MESH_HEAP_VERTICES, range->first[MESH_HEAP_VERTICES], counts[MESH_HEAP_VERTICES],
+					 data->vertices);
+	mesh_heap_upload(page, MESH_HEAP_INDICES, range->first[MESH_HEAP_INDICES], counts[MESH_HEAP_INDICES],
+					 data->indices);
+	return true;
+}
+
+void mesh_heap_free(const MeshHeapRange *range) {
+	for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+		mesh_heap_give_back(range->page, (MeshHeapKind)kind, range->blocks[kind]);
+	}
+}
+
+// the vertex array drawing the page's ranges
+GLuint mesh_heap_vertex_array(const MeshHeapRange *range) {
+	return mesh_heap.pages[range->page].vao;
+}
+
+// whether either buffer of the range's page is worth moving ranges for
+bool mesh_heap_fragmented(const MeshHeapRange *range) {
+	const MeshHeapPage *page = &mesh_heap.pages[range->page];
+	return tlsf_fragmentation(&page->tlsf[MESH_HEAP_VERTICES]) > MESH_HEAP_FRAGMENTED
+		|| tlsf_fragmentation(&page->tlsf[MESH_HEAP_INDICES]) > MESH_HEAP_FRAGMENTED;
+}
+
+// Moves each of the range's vertices and indices to a free block of the
+// same page at a lower offset if there's one, glCopyBufferSubData copies
+// them there on the GPU. The GPU still reads the old place for frames
+// already submitted, it's given back after them. True if anything moved,
+// the range is updated.
+bool mesh_heap_relocate(MeshHeapRange *range) {
+	MeshHeapPage *page = &mesh_heap.pages[range->page];
+	bool moved = false;
+	for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+		Tlsf *tlsf = &page->tlsf[kind];
+		uint32_t count = tlsf_size(tlsf, range->blocks[kind]);
+		uint32_t block = 0, first = 0;
+		if (!tlsf_alloc(tlsf, count, 1, &block, &first)) {
+			continue;
+		}
+		if (first >= range->first[kind]) {
+			tlsf_free(tlsf, block);
+			continue;
+		}
+		gpu_memory_shift(GPU_MEMORY_HEAP_FREE, mesh_heap_categories[kind], (uint64_t)count * mesh_heap_units[kind]);
+		GLuint name = buffer_name(page->buffers[kind]);
+		render_bind_buffer(GL_COPY_READ_BUFFER, name);
+		render_bind_buffer(GL_COPY_WRITE_BUFFER, name);
+		// the blocks don't overlap, both are allocated
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)range->first[kind] * mesh_heap_units[kind],
+							(GLintptr)first * mesh_heap_units[kind], (GLsizeiptr)count * mesh_heap_units[kind]);
+		mesh_heap_give_back(range->page, (MeshHeapKind)kind, range->blocks[kind]);
+		range->blocks[kind] = block;
+		range->first[kind] = first;
+		mesh_heap.moves += 1;
+		mesh_heap.moved_bytes += (uint64_t)count * mesh_heap_units[kind];
+		moved = true;
+	}
+	return moved;
+}
+
+MeshHeapStats mesh_heap_stats(void) {
+	MeshHeapStats stats = { .moves = mesh_heap.moves, .moved_bytes = mesh_heap.moved_bytes };
+	for (uint32_t i = 0; i < mesh_heap.pages_count; ++i) {
+		if (mesh_heap.pages[i].vao == 0) {
+			continue;
+		}
+		stats.pages += 1;
+		for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+			TlsfStats page = tlsf_stats(&mesh_heap.pages[i].tlsf[kind]);
+			TlsfStats *sum = &stats.kinds[kind];
+			sum->size += page.size;
+			sum->used += page.used;
+			sum->free += page.free;
+			sum->used_blocks += page.used_blocks;
+			sum->free_blocks += page.free_blocks;
+			if (page.largest_free > sum->largest_free) {
+				sum->largest_free = page.largest_free;
+			}
+			if (page.fragmentation > sum->fragmentation) {
+				sum->fragmentation = page.fragmentation;
+			}
+		}
+	}
+	return stats;
+}
+
+void mesh_heap_print(MeshHeapStats stats) {
+	printf("mesh heap: %u pages, %llu ranges moved, %.1f KB\n", stats.pages,
+		   (unsigned long long)stats.moves, stats.moved_bytes / 1024.0);
+	for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+		const TlsfStats *s = &stats.kinds[kind];
+		// used includes ranges still retiring
+		printf("  %-8s %10.1f of %.1f KB used in %u, %u free blocks, largest %.1f KB, %.0f%% fragmented\n",
+			   mesh_heap_names[kind], (double)s->used * mesh_heap_units[kind] / 1024.0,
+			   (double)s->size * mesh_heap_units[kind] / 1024.0, s->used_blocks, s->free_blocks,
+			   (double)s->largest_free * mesh_heap_units[kind] / 1024.0, s->fragmentation * 100.0);
+	}
+}
+
+// Destroys the pages left, call after the meshes are gone and before
+// retire_shutdown.
+void mesh_heap_shutdown(void) {
+	for (uint32_t i = 0; i < mesh_heap.pages_count; ++i) {
+		MeshHeapPage *page = &mesh_heap.pages[i];
+		if (page->vao == 0) {
+			continue;
+		}
+		for (int kind = 0; kind < MESH_HEAP_KINDS; ++kind) {
+			uint64_t live = (uint64_t)mesh_heap_live(page, (MeshHeapKind)kind) * mesh_heap_units[kind];
+			if (live != 0) {
+				log_warning("mesh heap %s still in use at shutdown", mesh_heap_names[kind]);
+			}
+			gpu_memory_shift(mesh_heap_categories[kind], GPU_MEMORY_HEAP_FREE, live);
+		}
+		mesh_heap_release_page(page);
+	}
+	mesh_heap.pages_count = 0;
+}
@@ -0,0 +1,122 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "glad.h"
+
+// Overdraw visualization, a debug mode.
+// While the geometry pass runs every fragment that passes the depth test
+// increments the stencil buffer, so afterwards each pixel holds how many
+// times it was shaded. The stencil is read back to compute the depth
+// complexity, then drawn over the frame as a heat map with one full screen
+// triangle per level, each stencil tested for its count.
+// The read back stalls the pipeline, don't trust frame times in this mode.
+
+#define OVERDRAW_LEVELS 8 // the last level is everything from 8 up
+
+typedef struct {
+	double average;         // over all pixels
+	double average_covered; // over pixels shaded at least once
+	uint32_t max;
+	double covered;         // fraction of pixels shaded at least once
+} OverdrawStats;
+
+static const float overdraw_colors[OVERDRAW_LEVELS][3] = {
+	{0.0f, 0.0f, 0.6f}, // 1, no overdraw
+	{0.0f, 0.5f, 1.0f},
+	{0.0f, 0.8f, 0.4f},
+	{0.5f, 0.9f, 0.0f},
+	{1.0f, 0.9f, 0.0f},
+	{1.0f, 0.5f, 0.0f},
+	{1.0f, 0.0f, 0.0f},
+	{1.0f, 1.0f, 1.0f}, // 8 or more
+};
+
+static struct {
+	ShaderFamily shader;
+	uint32_t color_name;
+	GLuint vao; // core profile won't draw without one, even with no attributes
+	uint8_t *pixels;
+	size_t pixels_size;
+	OverdrawStats latest;
+} overdraw;
+
+void overdraw_init(void) {
+	overdraw.shader = shader_family_register("overdraw.vert", "overdraw.frag");
+	overdraw.color_name = shader_name_hash("u_color");
+	glGenVertexArrays(1, &overdraw.vao);
+}
+
+// the framebuffer needs a stencil attachment, call before the geometry pass
+void overdraw_begin(void) {
+	glClearStencil(0);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	render_set_capability(GL_STENCIL_TEST, true);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+static void overdraw_measure(int width, int height) {
+	size_t size = (size_t)width * height;
+	if (size > overdraw.pixels_size) {
+		alloc_track_excuse();
+		uint8_t *pixels = realloc(overdraw.pixels, size);
+		if (pixels == NULL) {
+			return;
+		}
+		overdraw.pixels = pixels;
+		overdraw.pixels_size = size;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, overdraw.pixels);
+
+	uint64_t sum = 0;
+	size_t covered = 0;
+	uint32_t max = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint32_t count = overdraw.pixels[i];
+		sum += count;
+		covered += count > 0;
+		if (count > max) max = count;
+	}
+	overdraw.latest = (OverdrawStats){
+		.average = size ? (double)sum / size : 0.0,
+		.average_covered = covered ? (double)sum / covered : 0.0,
+		.max = max,
+		.covered = size ? (double)covered / size : 0.0,
+	};
+}
+
+// after the geometry pass, measures and replaces the frame with the heat map
+void overdraw_end(int width, int height) {
+	overdraw_measure(width, height);
+
+	ProgramHandle handle = shader_variant_get(overdraw.shader, 0);
+	GLuint program = shader_batch_program(handle);
+	if (program != 0) {
+		GLint color = shader_reflect_location(shader_batch_reflection(handle), overdraw.color_name);
+		render_use_program(program);
+		render_bind_vertex_array(overdraw.vao);
+		render_set_capability(GL_DEPTH_TEST, false);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		for (int level = 1; level <= OVERDRAW_LEVELS; ++level) {
+			// GL_LEQUAL passes where level <= stencil
+			glStencilFunc(level < OVERDRAW_LEVELS ? GL_EQUAL : GL_LEQUAL, level, 0xFF);
+			glUniform3fv(color, 1, overdraw_colors[level - 1]);
+			render_draw_arrays(GL_TRIANGLES, 0, 3);
+		}
+		render_set_capability(GL_DEPTH_TEST, true);
+	}
+	render_set_capability(GL_STENCIL_TEST, false);
+}
+
+OverdrawStats overdraw_latest(void) {
+	return overdraw.latest;
+}
+
+void overdraw_print(OverdrawStats stats) {
+	printf("overdraw: average %.2f, average covered %.2f, max %u, covered %.1f%%\n",
+		   stats.average, stats.average_covered, stats.max, stats.covered * 100.0);
+}
+
@@ -0,0 +1,204 @@
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "glad.h"
+
+// Frame pacing.
+// The mode picks the swap interval: vsync waits for the display, adaptive
+// vsync waits unless the frame is already late and tears instead of
+// dropping to half rate, uncapped never waits and capped doesn't either but
+// holds every swap back until its slot on a fixed target rate.
+// The cap sleeps until shortly before the deadline and spins the rest of
+// the way, the sleep's own overshoot is measured so the spin is only as
+// long as the scheduler needs, which keeps the wake-up within tens of
+// microseconds without burning a core for the whole wait.
+// A fence after every swap keeps the CPU at most max_frames_in_flight
+// frames ahead of the GPU, so a slow GPU shows up as a steady wait on the
+// CPU instead of a queue of frames growing in the driver.
+
+#define PACING_MAX_FRAMES_IN_FLIGHT 4
+#define PACING_MIN_SPIN_NS   50000   // never trust a sleep closer than this
+#define PACING_MAX_SPIN_NS   2000000
+#define PACING_FENCE_TIMEOUT_NS 1000000000ull
+
+typedef enum {
+	PACING_VSYNC = 0,
+	PACING_ADAPTIVE,
+	PACING_UNCAPPED,
+	PACING_CAPPED,
+	PACING_MODE_COUNT,
+} PacingMode;
+
+const char *pacing_mode_names[PACING_MODE_COUNT] = { "vsync", "adaptive", "uncapped", "capped" };
+
+typedef struct {
+	PacingMode requested; // what was asked for
+	PacingMode mode;      // in effect, see pacing_set_mode
+	double target_fps;         // capped only
+	int max_frames_in_flight;  // 1 to PACING_MAX_FRAMES_IN_FLIGHT
+	GLsync fences[PACING_MAX_FRAMES_IN_FLIGHT];
+	uint64_t frame_index;
+
+	uint64_t deadline_ns;      // next swap slot, 0 to start over
+	int64_t spin_ns;           // how far ahead of a deadline sleeping stops
+	double overshoot_ns;       // running average of the sleeps' overshoot
+
+	// since the last pacing_print
+	uint64_t last_swap_ns;
+	uint64_t intervals;
+	double interval_sum_ms, interval_squares_ms, interval_max_ms;
+	double wake_error_sum_us, wake_error_max_us;
+	uint64_t wakes;
+	uint64_t fence_waits;
+	double fence_wait_ms;
+} FramePacer;
+
+static uint64_t pacing_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void pacing_init(FramePacer *pacer, PacingMode mode, double target_fps, int max_frames_in_flight) {
+	if (max_frames_in_flight < 1) max_frames_in_flight = 1;
+	if (max_frames_in_flight > PACING_MAX_FRAMES_IN_FLIGHT) max_frames_in_flight = PACING_MAX_FRAMES_IN_FLIGHT;
+	*pacer = (FramePacer){
+		.requested = mode,
+		.mode = mode,
+		.target_fps = target_fps,
+		.max_frames_in_flight = max_frames_in_flight,
+		.spin_ns = PACING_MAX_SPIN_NS,
+	};
+}
+
+// mode is what the driver can do of the requested one
+void pacing_set_mode(FramePacer *pacer, PacingMode requested, PacingMode mode) {
+	pacer->requested = requested;
+	pacer->mode = mode;
+	pacer->deadline_ns = 0;
+}
+
+// for glfwSwapInterval, -1 needs the swap_control_tear extension
+int pacing_swap_interval(const FramePacer *pacer) {
+	switch (pacer->mode) {
+		case PACING_VSYNC:    return 1;
+		case PACING_ADAPTIVE: return -1;
+		default:              return 0;
+	}
+}
+
+static void pacing_sleep_until(FramePacer *pacer, uint64_t deadline) {
+	uint64_t wake = deadline - (uint64_t)pacer->spin_ns;
+	uint64_t now = pacing_now_ns();
+	if (now < wake) {
+		struct timespec ts = { (time_t)(wake / 1000000000u), (long)(wake % 1000000000u) };
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+		now = pacing_now_ns();
+		// spin twice the usual overshoot, an unusually late wake still lands
+		pacer->overshoot_ns += ((double)(int64_t)(now - wake) - pacer->overshoot_ns) / 8.0;
+		int64_t spin = (int64_t)(2.0 * pacer->overshoot_ns) + PACING_MIN_SPIN_NS;
+		pacer->spin_ns = spin < PACING_MIN_SPIN_NS ? PACING_MIN_SPIN_NS : spin > PACING_MAX_SPIN_NS ? PACING_MAX_SPIN_NS : spin;
+	}
+	while (now < deadline) {
+		now = pacing_now_ns();
+	}
+	double error_us = (now - deadline) / 1000.0;
+	pacer->wake_error_sum_us += error_us;
+	if (error_us > pacer->wake_error_max_us) pacer->wake_error_max_us = error_us;
+	pacer->wakes += 1;
+}
+
+// Waits until the GPU is done with the frame max_frames_in_flight frames
+// back. Call at the start of the frame, before polling input.
+void pacing_frame_begin(FramePacer *pacer) {
+	PROFILE_ZONE("frames_in_flight");
+	GLsync *fence = &pacer->fences[pacer->frame_index % pacer->max_frames_in_flight];
+	if (*fence == NULL) {
+		return;
+	}
+	uint64_t start = pacing_now_ns();
+	GLenum result = glClientWaitSync(*fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		pacer->fence_waits += 1;
+		do {
+			result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, PACING_FENCE_TIMEOUT_NS);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		pacer->fence_wait_ms += (pacing_now_ns() - start) / 1000000.0;
+	}
+	glDeleteSync(*fence);
+	*fence = NULL;
+}
+
+// holds a capped frame back until its slot, call right before swapping
+void pacing_limit(FramePacer *pacer) {
+	if (pacer->mode != PACING_CAPPED || pacer->target_fps <= 0.0) {
+		return;
+	}
+	PROFILE_ZONE("frame_limit");
+	uint64_t period = (uint64_t)(1000000000.0 / pacer->target_fps);
+	uint64_t now = pacing_now_ns();
+	// a frame that missed its slot by more than a period starts the schedule
+	// over instead of rushing the next ones to catch up
+	if (pacer->deadline_ns == 0 || now > pacer->deadline_ns + period) {
+		pacer->deadline_ns = now;
+	}
+	pacing_sleep_until(pacer, pacer->deadline_ns);
+	pacer->deadline_ns += period;
+}
+
+// fences the frame just swapped, call right after swapping
+void pacing_frame_end(FramePacer *pacer) {
+	pacer->fences[pacer->frame_index % pacer->max_frames_in_flight] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pacer->frame_index += 1;
+
+	uint64_t now = pacing_now_ns();
+	if (pacer->last_swap_ns != 0) {
+		double ms = (now - pacer->last_swap_ns) / 1000000.0;
+		pacer->interval_sum_ms += ms;
+		pacer->interval_squares_ms += ms * ms;
+		if (ms > pacer->interval_max_ms) pacer->interval_max_ms = ms;
+		pacer->intervals += 1;
+	}
+	pacer->last_swap_ns = now;
+}
+
+// the swap intervals since the last call, their spread is the jitter
+void pacing_print(FramePacer *pacer) {
+	if (pacer->intervals == 0) {
+		return;
+	}
+	double mean = pacer->interval_sum_ms / pacer->intervals;
+	double variance = pacer->interval_squares_ms / pacer->intervals - mean * mean;
+	printf("pacing: %s", pacing_mode_names[pacer->requested]);
+	if (pacer->mode != pacer->requested) printf(" as %s", pacing_mode_names[pacer->mode]);
+	if (pacer->mode == PACING_CAPPED) printf(" %.0f fps", pacer->target_fps);
+	printf(", %d in flight, swap interval mean %.3f ms, stddev %.3f ms, max %.3f ms",
+		   pacer->max_frames_in_flight, mean, variance > 0.0 ? sqrt(variance) : 0.0, pacer->interval_max_ms);
+	if (pacer->wakes > 0) {
+		printf(", wake error mean %.1f us, max %.1f us",
+			   pacer->wake_error_sum_us / pacer->wakes, pacer->wake_error_max_us);
+	}
+	if (pacer->fence_waits > 0) {
+		printf(", %llu fence waits %.2f ms", (unsigned long long)pacer->fence_waits, pacer->fence_wait_ms);
+	}
+	printf("\n");
+
+	pacer->intervals = 0;
+	pacer->interval_sum_ms = pacer->interval_squares_ms = pacer->interval_max_ms = 0.0;
+	pacer->wakes = 0;
+	pacer->wake_error_sum_us = pacer->wake_error_max_us = 0.0;
+	pacer->fence_waits = 0;
+	pacer->fence_wait_ms = 0.0;
+}
+
+void pacing_destroy(FramePacer *pacer) {
+	for (int i = 0; i < PACING_MAX_FRAMES_IN_FLIGHT; ++i) {
+		if (pacer->fences[i] != NULL) {
+			glDeleteSync(pacer->fences[i]);
+			pacer->fences[i] = NULL;
+		}
+	}
+}
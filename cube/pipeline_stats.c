@@ -0,0 +1,234 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "glad.h"
+
+// Pipeline statistics per render pass, a debug mode.
+// Each pass runs inside one ARB_pipeline_statistics_query query per
+// counter. Like the GPU profiler the queries go through a ring a few
+// frames deep and are read back once available, frames whose slot is
+// still in flight are skipped. Passes can't nest, GL allows only one
+// active query per target.
+
+#define PIPELINE_STATS_FRAMES     4
+#define PIPELINE_STATS_MAX_PASSES 8
+
+typedef enum {
+	PIPELINE_STAT_VERTICES = 0,
+	PIPELINE_STAT_PRIMITIVES,
+	PIPELINE_STAT_VERTEX_INVOCATIONS,
+	PIPELINE_STAT_FRAGMENT_INVOCATIONS,
+	PIPELINE_STAT_CLIPPING_INPUT,
+	PIPELINE_STAT_CLIPPING_OUTPUT,
+	PIPELINE_STAT_COUNT,
+} PipelineStat;
+
+static const GLenum pipeline_stat_targets[PIPELINE_STAT_COUNT] = {
+	GL_VERTICES_SUBMITTED_ARB,
+	GL_PRIMITIVES_SUBMITTED_ARB,
+	GL_VERTEX_SHADER_INVOCATIONS_ARB,
+	GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+	GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+	GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+};
+
+const char *pipeline_stat_names[PIPELINE_STAT_COUNT] = {
+	"vertices", "primitives", "vs_invocations", "fs_invocations", "clip_in", "clip_out",
+};
+
+typedef struct {
+	const char *name;
+	uint64_t values[PIPELINE_STAT_COUNT];
+} PipelineStatsPass;
+
+typedef struct {
+	PipelineStatsPass passes[PIPELINE_STATS_MAX_PASSES];
+	GLuint queries[PIPELINE_STATS_MAX_PASSES][PIPELINE_STAT_COUNT];
+	uint32_t count;
+	bool pending;
+} PipelineStatsFrame;
+
+static struct {
+	bool initialized;
+	bool enabled;
+	bool recording;
+	bool in_pass;
+	PipelineStatsFrame frames[PIPELINE_STATS_FRAMES];
+	uint64_t frame_index;
+
+	// the newest frame read back
+	PipelineStatsPass latest[PIPELINE_STATS_MAX_PASSES];
+	uint32_t latest_count;
+
+	// sums over every frame read back since the mode was enabled
+	PipelineStatsPass totals[PIPELINE_STATS_MAX_PASSES];
+	uint32_t totals_count;
+	uint64_t totals_frames;
+} pipeline_stats;
+
+bool pipeline_stats_init(void) {
+	if (!gl_ext_pipeline_statistics) {
+		log_error("pipeline statistics queries are not supported by this driver");
+		return false;
+	}
+	for (int i = 0; i < PIPELINE_STATS_FRAMES; ++i) {
+		glGenQueries(PIPELINE_STATS_MAX_PASSES * PIPELINE_STAT_COUNT, &pipeline_stats.frames[i].queries[0][0]);
+	}
+	pipeline_stats.initialized = true;
+	return true;
+}
+
+// takes effect at the next frame, does nothing before pipeline_stats_init
+void pipeline_stats_set_enabled(bool enabled) {
+	if (enabled && !pipeline_stats.enabled) {
+		pipeline_stats.totals_count = 0;
+		pipeline_stats.totals_frames = 0;
+	}
+	pipeline_stats.enabled = enabled;
+}
+
+bool pipeline_stats_enabled(void) {
+	return pipeline_stats.initialized && pipeline_stats.enabled;
+}
+
+static void pipeline_stats_accumulate(const PipelineStatsPass *pass) {
+	PipelineStatsPass *total = NULL;
+	for (uint32_t i = 0; i < pipeline_stats.totals_count; ++i) {
+		if (strcmp(pipeline_stats.totals[i].name, pass->name) == 0) {
+			total = &pipeline_stats.totals[i];
+			break;
+		}
+	}
+	if (total == NULL) {
+		if (pipeline_stats.totals_count >= PIPELINE_STATS_MAX_PASSES) {
+			return;
+		}
+		total = &pipeline_stats.totals[pipeline_stats.totals_count++];
+		*total = (PipelineStatsPass){ .name = pass->name };
+	}
+	for (int i = 0; i < PIPELINE_STAT_COUNT; ++i) {
+		total->values[i] += pass->values[i];
+	}
+}
+
+static bool pipeline_stats_collect(PipelineStatsFrame *frame) {
+	// queries finish in order, the last one being done means all are
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(frame->queries[frame->count - 1][PIPELINE_STAT_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < frame->count; ++i) {
+		PipelineStatsPass *pass = &frame->passes[i];
+		for (int j = 0; j < PIPELINE_STAT_COUNT; ++j) {
+			GLuint64 value = 0;
+			glGetQueryObjectui64v(frame->queries[i][j], GL_QUERY_RESULT, &value);
+			pass->values[j] = value;
+		}
+		pipeline_stats.latest[i] = *pass;
+		if (pipeline_stats.enabled) {
+			pipeline_stats_accumulate(pass);
+		}
+	}
+	pipeline_stats.latest_count = frame->count;
+	pipeline_stats.totals_frames += pipeline_stats.enabled;
+	frame->pending = false;
+	return true;
+}
+
+void pipeline_stats_frame_begin(void) {
+	if (!pipeline_stats.initialized) {
+		return;
+	}
+	for (uint64_t i = 0; i < PIPELINE_STATS_FRAMES; ++i) {
+		PipelineStatsFrame *frame = &pipeline_stats.frames[(pipeline_stats.frame_index + i) % PIPELINE_STATS_FRAMES];
+		if (frame->pending && !pipeline_stats_collect(frame)) {
+			break;
+		}
+	}
+
+	PipelineStatsFrame *frame = &pipeline_stats.frames[pipeline_stats.frame_index % PIPELINE_STATS_FRAMES];
+	pipeline_stats.recording = pipeline_stats.enabled && !frame->pending;
+	if (pipeline_stats.recording) {
+		frame->count = 0;
+	}
+}
+
+void pipeline_stats_frame_end(void) {
+	if (!pipeline_stats.initialized) {
+		return;
+	}
+	PipelineStatsFrame *frame = &pipeline_stats.frames[pipeline_stats.frame_index % PIPELINE_STATS_FRAMES];
+	if (pipeline_stats.recording && frame->count > 0) {
+		frame->pending = true;
+	}
+	pipeline_stats.recording = false;
+	pipeline_stats.frame_index += 1;
+}
+
+void pipeline_stats_begin(const char *name) {
+	PipelineStatsFrame *frame = &pipeline_stats.frames[pipeline_stats.frame_index % PIPELINE_STATS_FRAMES];
+	if (!pipeline_stats.recording || pipeline_stats.in_pass || frame->count >= PIPELINE_STATS_MAX_PASSES) {
+		return;
+	}
+	frame->passes[frame->count].name = name;
+	for (int i = 0; i < PIPELINE_STAT_COUNT; ++i) {
+		glBeginQuery(pipeline_stat_targets[i], frame->queries[frame->count][i]);
+	}
+	pipeline_stats.in_pass = true;
+}
+
+void pipeline_stats_end(void) {
+	if (!pipeline_stats.in_pass) {
+		return;
+	}
+	for (int i = 0; i < PIPELINE_STAT_COUNT; ++i) {
+		glEndQuery(pipeline_stat_targets[i]);
+	}
+	pipeline_stats.frames[pipeline_stats.frame_index % PIPELINE_STATS_FRAMES].count += 1;
+	pipeline_stats.in_pass = false;
+}
+
+// the passes of the newest frame read back
+uint32_t pipeline_stats_latest(const PipelineStatsPass **passes) {
+	*passes = pipeline_stats.latest;
+	return pipeline_stats.latest_count;
+}
+
+static void pipeline_stats_print_pass(const PipelineStatsPass *pass, double divisor) {
+	printf("%-10s", pass->name);
+	for (int i = 0; i < PIPELINE_STAT_COUNT; ++i) {
+		printf(" %15.0f", pass->values[i] / divisor);
+	}
+	printf("\n");
+}
+
+static void pipeline_stats_print_header(void) {
+	printf("%-10s", "pass");
+	for (int i = 0; i < PIPELINE_STAT_COUNT; ++i) {
+		printf(" %15s", pipeline_stat_names[i]);
+	}
+	printf("\n");
+}
+
+void pipeline_stats_print_latest(void) {
+	pipeline_stats_print_header();
+	for (uint32_t i = 0; i < pipeline_stats.latest_count; ++i) {
+		pipeline_stats_print_pass(&pipeline_stats.latest[i], 1.0);
+	}
+}
+
+// per frame averages since the mode was enabled
+void pipeline_stats_print_summary(void) {
+	if (pipeline_stats.totals_frames == 0) {
+		return;
+	}
+	printf("pipeline statistics, average of %llu frames\n", (unsigned long long)pipeline_stats.totals_frames);
+	pipeline_stats_print_header();
+	for (uint32_t i = 0; i < pipeline_stats.totals_count; ++i) {
+		pipeline_stats_print_pass(&pipeline_stats.totals[i], (double)pipeline_stats.totals_frames);
+	}
+}
+
@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+// Generational handle pools.
+// A pool hands out 32 bit handles to the resources of a typed table, the
+// low 16 bits pick a slot and the high 16 are that slot's generation, which
+// goes up every time the slot is released. A handle kept past the release
+// of its resource carries an old generation and stops resolving, even after
+// the slot was reused, until the generation wraps 65535 reuses later.
+// The resources themselves stay dense: the owner keeps them in the first
+// count entries of its arrays, in no particular order, and the pool maps
+// slots to those positions. Releasing moves the last resource into the
+// hole, the owner moves its arrays along. Owners keep what draws read per
+// frame apart from what only creation, destruction and tools read, so the
+// hot arrays stay small.
+// 0 is never a valid handle. Pools belong to the GL thread, other threads
+// may look handles up while nothing is acquired or released. A pool needs
+// no init, only its name and a capacity of at most POOL_MAX_SLOTS, the
+// size of the owner's arrays:
+//     static struct { HandlePool pool; ... } things = { .pool = POOL_INIT("things", THINGS_MAX) };
+
+#define POOL_MAX_SLOTS  4096
+#define POOL_SLOT_BITS  16
+#define POOL_SLOT_MASK  ((1u << POOL_SLOT_BITS) - 1)
+
+#define POOL_INIT(name_, capacity_) { .name = (name_), .capacity = (capacity_) }
+
+typedef struct {
+	const char *name; // of what the handles are for, in messages
+	uint32_t capacity;
+	uint32_t count;      // live resources, at positions 0 to count - 1
+	uint32_t slots_used; // slots handed out at least once
+	uint32_t free_slot;  // 1 + the most recently released slot, 0 if none
+	uint16_t generations[POOL_MAX_SLOTS];
+	uint32_t positions[POOL_MAX_SLOTS]; // of each live slot, 1 + the next free slot for released ones
+	uint32_t slots[POOL_MAX_SLOTS];     // of each position
+} HandlePool;
+
+static uint32_t pool_handle_of(const HandlePool *pool, uint32_t slot) {
+	return ((uint32_t)pool->generations[slot] << POOL_SLOT_BITS) | slot;
+}
+
+// A new handle, position is where the owner puts the resource, always the
+// end of its arrays. 0 once the pool is full.
+uint32_t pool_acquire(HandlePool *pool, uint32_t *position) {
+	if (pool->count == pool->capacity || pool->count == POOL_MAX_SLOTS) {
+		log_error("too many %s, at most %u", pool->name, pool->capacity);
+		return 0;
+	}
+	// released slots are reused before new ones are touched
+	uint32_t slot = 0;
+	if (pool->free_slot != 0) {
+		slot = pool->free_slot - 1;
+		pool->free_slot = pool->positions[slot];
+	} else {
+		slot = pool->slots_used++;
+		pool->generations[slot] = 1;
+	}
+	*position = pool->count++;
+	pool->positions[slot] = *position;
+	pool->slots[*position] = slot;
+	return pool_handle_of(pool, slot);
+}
+
+// false for 0 and for handles whose resource was released
+bool pool_find(const HandlePool *pool, uint32_t handle, uint32_t *position) {
+	uint32_t slot = handle & POOL_SLOT_MASK;
+	if (slot >= pool->slots_used || pool->generations[slot] != handle >> POOL_SLOT_BITS) {
+		return false;
+	}
+	*position = pool->positions[slot];
+	return true;
+}
+
+// Frees the handle's slot, the resource at position from has to move to
+// position to, which held the released one. Nothing moves if they're the
+// same. Releasing a stale handle is a bug and reported.
+bool pool_release(HandlePool *pool, uint32_t handle, uint32_t *to, uint32_t *from) {
+	uint32_t position = 0;
+	if (!pool_find(pool, handle, &position)) {
+		log_error("released a stale or invalid handle %08x of %s", handle, pool->name);
+		return false;
+	}
+	uint32_t slot = handle & POOL_SLOT_MASK;
+	uint32_t last = --pool->count;
+	uint32_t moved = pool->slots[last];
+	pool->slots[position] = moved;
+	pool->positions[moved] = position;
+	*to = position;
+	*from = last;
+
+	// 0 is skipped when the generation wraps, handles are never 0
+	pool->generations[slot] += 1;
+	if (pool->generations[slot] == 0) {
+		pool->generations[slot] = 1;
+	}
+	pool->positions[slot] = pool->free_slot;
+	pool->free_slot = slot + 1;
+	return true;
+}
+
+// the handle of the resource at position, for iterating the owner's arrays
+uint32_t pool_handle_at(const HandlePool *pool, uint32_t position) {
+	return pool_handle_of(pool, pool->slots[position]);
+}
@@ -0,0 +1,241 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// CPU frame profiler.
+// Zones are nested, named with string literals and recorded into a ring
+// buffer owned by the thread that opened them, so recording never takes a
+// lock: the owner is the only writer and publishes events by bumping the
+// ring's head with a release store. The newest PROFILER_EVENTS_PER_THREAD
+// events of every thread can be exported as Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev both open.
+// Timestamps come from rdtsc where available and are converted to
+// microseconds at export time against CLOCK_MONOTONIC.
+// With ENABLE_PROFILER set to 0 every macro expands to nothing.
+
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+#define PROFILER_EVENTS_PER_THREAD (1 << 16) // power of two
+#define PROFILER_MAX_DEPTH         32
+#define PROFILER_THREAD_NAME_SIZE  32
+
+#if ENABLE_PROFILER
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profiler_ticks(void) {
+	return __rdtsc();
+}
+#else
+static inline uint64_t profiler_ticks(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+typedef struct {
+	const char *name;
+	uint64_t start, end; // ticks
+} ProfileEvent;
+
+typedef struct ProfilerThread {
+	ProfileEvent events[PROFILER_EVENTS_PER_THREAD];
+	_Atomic uint64_t head; // events written so far, the ring holds the newest ones
+	uint64_t stack[PROFILER_MAX_DEPTH]; // start ticks of the open zones
+	const char *stack_names[PROFILER_MAX_DEPTH];
+	uint32_t depth;
+	uint32_t id;
+	char name[PROFILER_THREAD_NAME_SIZE];
+	struct ProfilerThread *next;
+} ProfilerThread;
+
+static struct {
+	_Atomic(ProfilerThread *) threads; // lock-free list, threads are only ever added
+	atomic_uint threads_count;
+	uint64_t start_ticks;
+	uint64_t start_ns;
+} profiler;
+
+static _Thread_local ProfilerThread *profiler_thread;
+
+static uint64_t profiler_monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// call once before any zone, the trace's time 0
+void profiler_init(void) {
+	profiler.start_ns = profiler_monotonic_ns();
+	profiler.start_ticks = profiler_ticks();
+}
+
+static ProfilerThread *profiler_thread_create(const char *name) {
+	ProfilerThread *thread = calloc(1, sizeof(ProfilerThread));
+	if (thread == NULL) {
+		return NULL;
+	}
+	thread->id = atomic_fetch_add(&profiler.threads_count, 1) + 1;
+	if (name != NULL) {
+		snprintf(thread->name, sizeof(thread->name), "%s", name);
+	} else {
+		snprintf(thread->name, sizeof(thread->name), "thread %u", thread->id);
+	}
+
+	thread->next = atomic_load_explicit(&profiler.threads, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak_explicit(&profiler.threads, &thread->next, thread,
+												  memory_order_release, memory_order_relaxed)) {}
+	return thread;
+}
+
+// Names the calling thread in the trace. Threads that never call this are
+// registered on their first zone as "thread N". Returns NULL out of memory.
+ProfilerThread *profiler_thread_register(const char *name) {
+	if (profiler_thread != NULL) {
+		if (name != NULL) snprintf(profiler_thread->name, sizeof(profiler_thread->name), "%s", name);
+		return profiler_thread;
+	}
+	profiler_thread = profiler_thread_create(name);
+	return profiler_thread;
+}
+
+// A track is a timeline that isn't a CPU thread, the GPU for example.
+// Its events come with their own timestamps and must all be pushed from
+// the same thread.
+ProfilerThread *profiler_track_create(const char *name) {
+	return profiler_thread_create(name);
+}
+
+static inline void profiler_track_push(ProfilerThread *track, const char *name, uint64_t start, uint64_t end) {
+	uint64_t head = atomic_load_explicit(&track->head, memory_order_relaxed);
+	ProfileEvent *event = &track->events[head & (PROFILER_EVENTS_PER_THREAD - 1)];
+	event->name = name;
+	event->start = start;
+	event->end = end;
+	atomic_store_explicit(&track->head, head + 1, memory_order_release);
+}
+
+static inline void profiler_begin(const char *name) {
+	ProfilerThread *thread = profiler_thread;
+	if (thread == NULL && (thread = profiler_thread_register(NULL)) == NULL) {
+		return;
+	}
+	// zones deeper than the stack are dropped, their ends are ignored below
+	if (thread->depth < PROFILER_MAX_DEPTH) {
+		thread->stack_names[thread->depth] = name;
+		thread->stack[thread->depth] = profiler_ticks();
+	}
+	thread->depth += 1;
+}
+
+static inline void profiler_end(void) {
+	ProfilerThread *thread = profiler_thread;
+	if (thread == NULL || thread->depth == 0) {
+		return;
+	}
+	thread->depth -= 1;
+	if (thread->depth >= PROFILER_MAX_DEPTH) {
+		return;
+	}
+
+	profiler_track_push(thread, thread->stack_names[thread->depth], thread->stack[thread->depth], profiler_ticks());
+}
+
+static inline const char *profiler_zone_begin(const char *name) {
+	profiler_begin(name);
+	return name;
+}
+
+static inline void profiler_zone_end(const char **zone) {
+	(void) zone;
+	profiler_end();
+}
+
+static double profiler_ticks_to_us(uint64_t ticks, double ns_per_tick) {
+	return (double)(int64_t)(ticks - profiler.start_ticks) * ns_per_tick / 1000.0;
+}
+
+static double profiler_ns_per_tick(void) {
+	uint64_t ticks = profiler_ticks() - profiler.start_ticks;
+	uint64_t ns = profiler_monotonic_ns() - profiler.start_ns;
+	return ticks ? (double)ns / ticks : 1.0;
+}
+
+static void profiler_write_events(FILE *file, ProfilerThread *thread, double ns_per_tick, bool *first) {
+	fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			*first ? "" : ",", thread->id, thread->name);
+	*first = false;
+
+	uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+	uint64_t begin = head > PROFILER_EVENTS_PER_THREAD ? head - PROFILER_EVENTS_PER_THREAD : 0;
+	for (uint64_t i = begin; i < head; ++i) {
+		const ProfileEvent *event = &thread->events[i & (PROFILER_EVENTS_PER_THREAD - 1)];
+		double start = profiler_ticks_to_us(event->start, ns_per_tick);
+		double end = profiler_ticks_to_us(event->end, ns_per_tick);
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event->name, thread->id, start, end - start);
+	}
+}
+
+// Writes the events of every thread as Chrome trace JSON. Events recorded
+// while this runs may or may not make it in, call it when the other
+// threads are idle so none of them laps its ring during the export.
+bool profiler_write_chrome_trace(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		log_error("could not open `%s` for writing: %s", path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	double ns_per_tick = profiler_ns_per_tick();
+	bool first = true;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (ProfilerThread *thread = atomic_load_explicit(&profiler.threads, memory_order_acquire);
+		 thread != NULL; thread = thread->next) {
+		profiler_write_events(file, thread, ns_per_tick, &first);
+	}
+	fprintf(file, "\n]}\n");
+
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		log_error("could not write `%s`", path);
+	}
+	return ok;
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// PROFILE_ZONE("name") times the rest of the enclosing block,
+// PROFILE_BEGIN/PROFILE_END for spans that don't line up with a block
+#define PROFILE_ZONE(name) \
+	const char *PROFILE_CONCAT(profile_zone_, __LINE__) __attribute__((cleanup(profiler_zone_end), unused)) = profiler_zone_begin(name)
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_THREAD(name) profiler_thread_register(name)
+
+#else
+
+void profiler_init(void) {}
+bool profiler_write_chrome_trace(const char *path) {
+	log_error("built without the profiler, `%s` not written", path);
+	return false;
+}
+
+#define PROFILE_ZONE(name) do {} while (0)
+#define PROFILE_BEGIN(name) do {} while (0)
+#define PROFILE_END() do {} while (0)
+#define PROFILE_THREAD(name) do {} while (0)
+
+#endif // ENABLE_PROFILER
+
@@ -0,0 +1,185 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "glad.h"
+
+// Per frame renderer counters.
+// Draws, binds, capability toggles and buffer uploads go through the
+// render_* wrappers below instead of straight to GL. They count the work
+// and drop calls that would set state to what it already is, which only
+// works as long as nothing else changes that state behind their back; call
+// render_state_invalidate after code that does.
+
+typedef struct {
+	uint32_t draw_calls;
+	uint64_t triangles;
+	uint32_t state_changes;     // binds and capability toggles that reached GL
+	uint32_t shader_binds;      // included in state_changes
+	uint32_t redundant_skipped; // calls dropped because the state was already set
+	uint64_t bytes_uploaded;    // glBufferData and glBufferSubData
+} RenderStats;
+
+enum {
+	RENDER_CAP_DEPTH_TEST = 0,
+	RENDER_CAP_CULL_FACE,
+	RENDER_CAP_STENCIL_TEST,
+	RENDER_CAP_BLEND,
+	RENDER_CAP_COUNT,
+};
+
+static struct {
+	RenderStats current;
+	RenderStats latest;
+	bool program_known, vertex_array_known, array_buffer_known;
+	GLuint program, vertex_array, array_buffer;
+	uint32_t caps_known, caps_enabled; // bit per RENDER_CAP_*
+} render_state;
+
+void render_state_invalidate(void) {
+	render_state.program_known = false;
+	render_state.vertex_array_known = false;
+	render_state.array_buffer_known = false;
+	render_state.caps_known = 0;
+}
+
+// call before deleting a program, so a new one that gets its name is bound
+void render_state_forget_program(GLuint program) {
+	if (render_state.program == program) {
+		render_state.program_known = false;
+	}
+}
+
+// and before deleting a vertex array or buffer
+void render_state_forget_vertex_array(GLuint vertex_array) {
+	if (render_state.vertex_array == vertex_array) {
+		render_state.vertex_array_known = false;
+	}
+}
+
+void render_state_forget_buffer(GLuint buffer) {
+	if (render_state.array_buffer == buffer) {
+		render_state.array_buffer_known = false;
+	}
+}
+
+// the counters of the frame that just ended become the latest
+void render_stats_frame_begin(void) {
+	render_state.latest = render_state.current;
+	render_state.current = (RenderStats){0};
+}
+
+// the last complete frame
+RenderStats render_stats_latest(void) {
+	return render_state.latest;
+}
+
+void render_stats_print(RenderStats stats) {
+	printf("render: %u draws, %llu triangles, %u state changes, %u shader binds, %u redundant skipped, %llu bytes uploaded\n",
+		   stats.draw_calls, (unsigned long long)stats.triangles, stats.state_changes, stats.shader_binds,
+		   stats.redundant_skipped, (unsigned long long)stats.bytes_uploaded);
+}
+
+void render_use_program(GLuint program) {
+	if (render_state.program_known && render_state.program == program) {
+		render_state.current.redundant_skipped += 1;
+		return;
+	}
+	glUseProgram(program);
+	render_state.program = program;
+	render_state.program_known = true;
+	render_state.current.state_changes += 1;
+	render_state.current.shader_binds += 1;
+}
+
+void render_bind_vertex_array(GLuint vertex_array) {
+	if (render_state.vertex_array_known && render_state.vertex_array == vertex_array) {
+		render_state.current.redundant_skipped += 1;
+		return;
+	}
+	glBindVertexArray(vertex_array);
+	render_state.vertex_array = vertex_array;
+	render_state.vertex_array_known = true;
+	render_state.current.state_changes += 1;
+}
+
+// GL_ELEMENT_ARRAY_BUFFER belongs to the bound vertex array, only
+// GL_ARRAY_BUFFER is cached
+void render_bind_buffer(GLenum target, GLuint buffer) {
+	if (target == GL_ARRAY_BUFFER) {
+		if (render_state.array_buffer_known && render_state.array_buffer == buffer) {
+			render_state.current.redundant_skipped += 1;
+			return;
+		}
+		render_state.array_buffer = buffer;
+		render_state.array_buffer_known = true;
+	}
+	glBindBuffer(target, buffer);
+	render_state.current.state_changes += 1;
+}
+
+static int render_cap_index(GLenum cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST:   return RENDER_CAP_DEPTH_TEST;
+	case GL_CULL_FACE:    return RENDER_CAP_CULL_FACE;
+	case GL_STENCIL_TEST: return RENDER_CAP_STENCIL_TEST;
+	case GL_BLEND:        return RENDER_CAP_BLEND;
+	default:              return -1;
+	}
+}
+
+void render_set_capability(GLenum cap, bool enabled) {
+	int index = render_cap_index(cap);
+	if (index >= 0) {
+		uint32_t bit = 1u << index;
+		if ((render_state.caps_known & bit) && ((render_state.caps_enabled & bit) != 0) == enabled) {
+			render_state.current.redundant_skipped += 1;
+			return;
+		}
+		render_state.caps_known |= bit;
+		render_state.caps_enabled = enabled ? render_state.caps_enabled | bit : render_state.caps_enabled & ~bit;
+	}
+	if (enabled) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+	render_state.current.state_changes += 1;
+}
+
+static uint64_t render_triangles(GLenum mode, GLsizei count) {
+	switch (mode) {
+	case GL_TRIANGLES:      return count / 3;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN:   return count > 2 ? count - 2 : 0;
+	default:                return 0;
+	}
+}
+
+void render_draw_elements(GLenum mode, GLsizei count, GLenum type, const void *offset) {
+	glDrawElements(mode, count, type, offset);
+	render_state.current.draw_calls += 1;
+	render_state.current.triangles += render_triangles(mode, count);
+}
+
+void render_draw_elements_base_vertex(GLenum mode, GLsizei count, GLenum type, const void *offset, GLint base_vertex) {
+	glDrawElementsBaseVertex(mode, count, type, offset, base_vertex);
+	render_state.current.draw_calls += 1;
+	render_state.current.triangles += render_triangles(mode, count);
+}
+
+void render_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+	glDrawArrays(mode, first, count);
+	render_state.current.draw_calls += 1;
+	render_state.current.triangles += render_triangles(mode, count);
+}
+
+void render_buffer_data(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+	glBufferData(target, size, data, usage);
+	render_state.current.bytes_uploaded += data ? size : 0;
+}
+
+void render_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+	glBufferSubData(target, offset, size, data);
+	render_state.current.bytes_uploaded += size;
+}
+
@@ -0,0 +1,228 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "glad.h"
+
+// Deferred destruction of GL objects.
+// A frame the GPU hasn't finished may still read an object the CPU is done
+// with, deleting it right away makes the driver either wait for the GPU or
+// keep the object alive behind our back. So objects are only queued here
+// when they're destroyed and deleted once a fence placed after the frame
+// that queued them signalled, by then nothing can use them anymore. A
+// fence also covers every frame before its own, so frames that queue
+// nothing don't place one, and while every fence is in use the next frame
+// that gets one covers the ones that didn't.
+// Retired buffers aren't deleted right away but kept for a while, buffer.c
+// takes one of the same size and usage before creating a new one, which
+// saves the driver allocating storage for streamed data over and over.
+// Not while GPU memory is over budget though, see gpu_memory.c.
+// What isn't a GL object of its own, a range of a shared buffer say, is
+// given back by a callback queued the same way.
+// GL thread only.
+
+#define RETIRE_MAX_OBJECTS  1024 // queued and not yet retired
+#define RETIRE_MAX_FENCES   8    // frames in flight with queued objects
+#define RETIRE_MAX_RECYCLED 64   // retired buffers kept for reuse
+#define RETIRE_RECYCLE_FRAMES 120 // unused recycled buffers are deleted after that
+
+typedef enum {
+	RETIRE_BUFFER = 0,
+	RETIRE_VERTEX_ARRAY,
+	RETIRE_PROGRAM,
+	RETIRE_TEXTURE,
+	RETIRE_CALLBACK,
+} RetireKind;
+
+typedef struct {
+	RetireKind kind;
+	GLuint name;
+	GLsizeiptr size; // buffers only
+	GLenum usage;    // buffers only
+	void (*callback)(uint64_t value); // callbacks only
+	uint64_t value;  // callbacks only
+	uint64_t frame;  // the frame it was queued in
+} RetireObject;
+
+typedef struct {
+	GLuint name;
+	GLsizeiptr size;
+	GLenum usage;
+	uint64_t frame; // the frame it was retired in
+} RetireRecycled;
+
+static struct {
+	RetireObject objects[RETIRE_MAX_OBJECTS]; // a ring, oldest first
+	uint32_t objects_head, objects_count;
+	struct { GLsync sync; uint64_t frame; } fences[RETIRE_MAX_FENCES]; // a ring, oldest first
+	uint32_t fences_head, fences_count;
+	uint64_t frame;     // the one being recorded, counts from 1
+	uint64_t fenced;    // the newest frame with a fence
+	uint64_t completed; // the GPU finished every frame up to this one
+	RetireRecycled recycled[RETIRE_MAX_RECYCLED];
+	uint32_t recycled_count;
+} retire = { .frame = 1 };
+
+static void retire_delete(const RetireObject *object) {
+	switch (object->kind) {
+	case RETIRE_BUFFER:       glDeleteBuffers(1, &object->name); break;
+	case RETIRE_VERTEX_ARRAY: glDeleteVertexArrays(1, &object->name); break;
+	case RETIRE_PROGRAM:      glDeleteProgram(object->name); break;
+	case RETIRE_TEXTURE:      glDeleteTextures(1, &object->name); break;
+	case RETIRE_CALLBACK:     object->callback(object->value); break;
+	}
+}
+
+static void retire_queue(RetireObject object) {
+	if (retire.objects_count == RETIRE_MAX_OBJECTS) {
+		log_warning("destruction queue is full, deleting a GL object the GPU may still use");
+		retire_delete(&object);
+		if (object.kind == RETIRE_BUFFER) {
+			gpu_memory_free(GPU_MEMORY_RETIRING, object.size);
+		}
+		return;
+	}
+	object.frame = retire.frame;
+	retire.objects[(retire.objects_head + retire.objects_count) % RETIRE_MAX_OBJECTS] = object;
+	retire.objects_count += 1;
+}
+
+// Queue objects the caller won't touch again. The caller also makes sure
+// the render_state cache forgets them, see render_stats.c.
+void retire_buffer(GLuint name, GLsizeiptr size, GLenum usage) {
+	retire_queue((RetireObject){ .kind = RETIRE_BUFFER, .name = name, .size = size, .usage = usage });
+}
+
+void retire_vertex_array(GLuint name) {
+	retire_queue((RetireObject){ .kind = RETIRE_VERTEX_ARRAY, .name = name });
+}
+
+void retire_program(GLuint name) {
+	retire_queue((RetireObject){ .kind = RETIRE_PROGRAM, .name = name });
+}
+
+void retire_texture(GLuint name) {
+	retire_queue((RetireObject){ .kind = RETIRE_TEXTURE, .name = name });
+}
+
+// calls callback with value on the GL thread once the GPU is done with
+// everything submitted so far
+void retire_call(void (*callback)(uint64_t value), uint64_t value) {
+	retire_queue((RetireObject){ .kind = RETIRE_CALLBACK, .callback = callback, .value = value });
+}
+
+// the buffer recycled longest ago makes room if there's none left
+static void retire_recycle(const RetireObject *object) {
+	if (object->size <= 0 || gpu_memory_over_budget() > 0) {
+		glDeleteBuffers(1, &object->name);
+		gpu_memory_free(GPU_MEMORY_RETIRING, object->size);
+		return;
+	}
+	gpu_memory_move(GPU_MEMORY_RETIRING, GPU_MEMORY_RECYCLED, object->size);
+	uint32_t index = retire.recycled_count;
+	if (index == RETIRE_MAX_RECYCLED) {
+		index = 0;
+		for (uint32_t i = 1; i < retire.recycled_count; ++i) {
+			if (retire.recycled[i].frame < retire.recycled[index].frame) {
+				index = i;
+			}
+		}
+		glDeleteBuffers(1, &retire.recycled[index].name);
+		gpu_memory_free(GPU_MEMORY_RECYCLED, retire.recycled[index].size);
+	} else {
+		retire.recycled_count += 1;
+	}
+	retire.recycled[index] = (RetireRecycled){
+		.name = object->name, .size = object->size, .usage = object->usage, .frame = retire.frame,
+	};
+}
+
+// A retired buffer with storage of exactly size bytes and usage, 0 if
+// there's none. Its contents are undefined.
+GLuint retire_take_buffer(GLsizeiptr size, GLenum usage) {
+	// newest first, it's the most likely to still be in the driver's caches
+	for (uint32_t i = retire.recycled_count; i-- > 0;) {
+		RetireRecycled *recycled = &retire.recycled[i];
+		if (recycled->size == size && recycled->usage == usage) {
+			GLuint name = recycled->name;
+			*recycled = retire.recycled[--retire.recycled_count];
+			return name;
+		}
+	}
+	return 0;
+}
+
+// deletes every recycled buffer, they're the first to go over budget
+void retire_drop_recycled(void) {
+	for (uint32_t i = 0; i < retire.recycled_count; ++i) {
+		glDeleteBuffers(1, &retire.recycled[i].name);
+		gpu_memory_free(GPU_MEMORY_RECYCLED, retire.recycled[i].size);
+	}
+	retire.recycled_count = 0;
+}
+
+// deletes or recycles everything queued up to and including frame
+static void retire_objects(uint64_t frame) {
+	while (retire.objects_count > 0 && retire.objects[retire.objects_head].frame <= frame) {
+		const RetireObject *object = &retire.objects[retire.objects_head];
+		if (object->kind == RETIRE_BUFFER) {
+			retire_recycle(object);
+		} else {
+			retire_delete(object);
+		}
+		retire.objects_head = (retire.objects_head + 1) % RETIRE_MAX_OBJECTS;
+		retire.objects_count -= 1;
+	}
+}
+
+// Call once per frame on the GL thread after its last GL call. Retires
+// what the GPU is done with without waiting for it, then fences this
+// frame if it queued anything.
+void retire_frame_end(void) {
+	PROFILE_ZONE("retire");
+	while (retire.fences_count > 0) {
+		GLsync sync = retire.fences[retire.fences_head].sync;
+		GLenum result = glClientWaitSync(sync, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(sync);
+		retire.completed = retire.fences[retire.fences_head].frame;
+		retire.fences_head = (retire.fences_head + 1) % RETIRE_MAX_FENCES;
+		retire.fences_count -= 1;
+	}
+	retire_objects(retire.completed);
+
+	for (uint32_t i = 0; i < retire.recycled_count;) {
+		if (retire.frame - retire.recycled[i].frame > RETIRE_RECYCLE_FRAMES) {
+			glDeleteBuffers(1, &retire.recycled[i].name);
+			gpu_memory_free(GPU_MEMORY_RECYCLED, retire.recycled[i].size);
+			retire.recycled[i] = retire.recycled[--retire.recycled_count];
+		} else {
+			i += 1;
+		}
+	}
+
+	// objects of frames that couldn't get a fence are covered by this one
+	bool unfenced = retire.objects_count > 0
+		&& retire.objects[(retire.objects_head + retire.objects_count - 1) % RETIRE_MAX_OBJECTS].frame > retire.fenced;
+	if (unfenced && retire.fences_count < RETIRE_MAX_FENCES) {
+		uint32_t index = (retire.fences_head + retire.fences_count) % RETIRE_MAX_FENCES;
+		retire.fences[index].sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		retire.fences[index].frame = retire.frame;
+		retire.fences_count += 1;
+		retire.fenced = retire.frame;
+	}
+	retire.frame += 1;
+}
+
+// Waits for the GPU and deletes everything queued and recycled, call at
+// shutdown with the context current.
+void retire_shutdown(void) {
+	glFinish();
+	while (retire.fences_count > 0) {
+		glDeleteSync(retire.fences[retire.fences_head].sync);
+		retire.fences_head = (retire.fences_head + 1) % RETIRE_MAX_FENCES;
+		retire.fences_count -= 1;
+	}
+	retire_objects(UINT64_MAX);
+	retire_drop_recycled();
+}
@@ -0,0 +1,219 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Benchmark scenarios.
+// Each line of a scenario file describes one scenario as a name followed
+// by key=value settings, anything left out keeps its default:
+//     <name> [objects=N] [mesh=cube|sphere] [camera=static|orbit|dolly]
+//            [features=NAME,NAME|none] [submit=direct|commands]
+//            [frames=N] [warmup=N] [repetitions=N]
+// `#` starts a comment.
+
+#define SCENARIO_MAX           64
+#define SCENARIO_NAME_SIZE     64
+#define SCENARIO_DEFAULT_FRAMES      300
+#define SCENARIO_DEFAULT_WARMUP      30
+#define SCENARIO_DEFAULT_REPETITIONS 5
+#define SCENARIO_MAX_REPETITIONS     64
+
+// the scene draws every object with its own u_model, so only these can be toggled
+#define SCENARIO_SUPPORTED_FEATURES SHADER_FEATURE_LIGHTING
+
+typedef struct {
+	char name[SCENARIO_NAME_SIZE];
+	size_t objects;
+	SceneMesh mesh;
+	SceneCameraPath camera;
+	uint32_t features;
+	SceneSubmit submit;
+	int frames;
+	int warmup;
+	int repetitions;
+} Scenario;
+
+typedef struct {
+	Scenario items[SCENARIO_MAX];
+	size_t count;
+} Scenarios;
+
+static bool scenario_parse_count(const char *value, int min, int max, long *out) {
+	char *end = NULL;
+	long number = strtol(value, &end, 10);
+	if (end == value || *end != '\0' || number < min || number > max) {
+		return false;
+	}
+	*out = number;
+	return true;
+}
+
+static bool scenario_parse_name(const char *value, const char **names, int names_count, int *out) {
+	for (int i = 0; i < names_count; ++i) {
+		if (strcmp(names[i], value) == 0) {
+			*out = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool scenario_parse_features(char *value, uint32_t *features) {
+	*features = 0;
+	if (strcmp(value, "none") == 0) {
+		return true;
+	}
+	char *save_name = NULL;
+	for (char *name = strtok_r(value, ",", &save_name); name != NULL; name = strtok_r(NULL, ",", &save_name)) {
+		uint32_t feature = 0;
+		if (!shader_feature_from_name(name, &feature) || !(feature & SCENARIO_SUPPORTED_FEATURES)) {
+			return false;
+		}
+		*features |= feature;
+	}
+	return true;
+}
+
+// names end up in JSON and on the command line, keep them plain
+static bool scenario_valid_name(const char *name) {
+	for (const char *c = name; *c != '\0'; ++c) {
+		if (!isalnum((unsigned char)*c) && *c != '_' && *c != '-' && *c != '.') {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool scenario_parse_setting(Scenario *scenario, const char *key, char *value) {
+	long number = 0;
+	int index = 0;
+	if (strcmp(key, "objects") == 0) {
+		if (!scenario_parse_count(value, 1, SCENE_MAX_OBJECTS, &number)) return false;
+		scenario->objects = number;
+	} else if (strcmp(key, "mesh") == 0) {
+		if (!scenario_parse_name(value, scene_mesh_names, SCENE_MESH_COUNT, &index)) return false;
+		scenario->mesh = index;
+	} else if (strcmp(key, "camera") == 0) {
+		if (!scenario_parse_name(value, scene_camera_names, SCENE_CAMERA_COUNT, &index)) return false;
+		scenario->camera = index;
+	} else if (strcmp(key, "features") == 0) {
+		if (!scenario_parse_features(value, &scenario->features)) return false;
+	} else if (strcmp(key, "submit") == 0) {
+		if (!scenario_parse_name(value, scene_submit_names, SCENE_SUBMIT_COUNT, &index)) return false;
+		scenario->submit = index;
+	} else if (strcmp(key, "frames") == 0) {
+		if (!scenario_parse_count(value, 1, 1000000, &number)) return false;
+		scenario->frames = number;
+	} else if (strcmp(key, "warmup") == 0) {
+		if (!scenario_parse_count(value, 0, 1000000, &number)) return false;
+		scenario->warmup = number;
+	} else if (strcmp(key, "repetitions") == 0) {
+		if (!scenario_parse_count(value, 2, SCENARIO_MAX_REPETITIONS, &number)) return false;
+		scenario->repetitions = number;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool scenarios_load(const char *path, Scenarios *scenarios) {
+	scenarios->count = 0;
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *text = read_entire_file_arena(path, scratch);
+	if (text == NULL) {
+		log_error("failed to read file `%s`: %s", path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	bool ok = true;
+	int line_number = 0;
+	for (char *line = text, *next = NULL; line != NULL; line = next) {
+		line_number += 1;
+		next = strchr(line, '\n');
+		if (next != NULL) *next++ = '\0';
+
+		char *comment = strchr(line, '#');
+		if (comment != NULL) *comment = '\0';
+
+		char *save_word = NULL;
+		const char *name = strtok_r(line, " \t\r", &save_word);
+		if (name == NULL) continue;
+
+		if (!scenario_valid_name(name) || strlen(name) >= SCENARIO_NAME_SIZE) {
+			log_error("%s:%d: invalid scenario name `%s`", path, line_number, name);
+			ok = false;
+			continue;
+		}
+		if (scenarios->count >= SCENARIO_MAX) {
+			log_error("%s:%d: too many scenarios", path, line_number);
+			ok = false;
+			break;
+		}
+
+		Scenario *scenario = &scenarios->items[scenarios->count];
+		*scenario = (Scenario){
+			.objects = 2,
+			.mesh = SCENE_MESH_CUBE,
+			.camera = SCENE_CAMERA_STATIC,
+			.features = SHADER_FEATURE_LIGHTING,
+			.submit = SCENE_SUBMIT_DIRECT,
+			.frames = SCENARIO_DEFAULT_FRAMES,
+			.warmup = SCENARIO_DEFAULT_WARMUP,
+			.repetitions = SCENARIO_DEFAULT_REPETITIONS,
+		};
+		snprintf(scenario->name, sizeof(scenario->name), "%s", name);
+
+		bool line_ok = true;
+		for (char *word = strtok_r(NULL, " \t\r", &save_word); word != NULL; word = strtok_r(NULL, " \t\r", &save_word)) {
+			char *value = strchr(word, '=');
+			if (value == NULL) {
+				log_error("%s:%d: expected key=value, got `%s`", path, line_number, word);
+				line_ok = false;
+				break;
+			}
+			*value++ = '\0';
+			if (!scenario_parse_setting(scenario, word, value)) {
+				log_error("%s:%d: invalid %s `%s`", path, line_number, word, value);
+				line_ok = false;
+				break;
+			}
+		}
+		if (!line_ok) {
+			ok = false;
+			continue;
+		}
+		scenarios->count += 1;
+	}
+
+	arena_rewind(scratch, mark);
+	return ok;
+}
+
+// writes the feature names joined by commas, or "none"
+void scenario_features_string(uint32_t features, char *buffer, size_t size) {
+	size_t length = 0;
+	buffer[0] = '\0';
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+		if (features & (1u << i)) {
+			length += snprintf(buffer + length, length < size ? size - length : 0, "%s%s",
+							   length ? "," : "", shader_feature_names[i]);
+		}
+	}
+	if (length == 0) {
+		snprintf(buffer, size, "none");
+	}
+}
+
+// puts the scene into the scenario's starting state
+void scenario_apply(const Scenario *scenario, Scene *scene) {
+	scene->mesh = scenario->mesh;
+	scene->camera_path = scenario->camera;
+	scene->shader_features = scenario->features;
+	scene->submit = scenario->submit;
+	scene_layout_grid(scene, scenario->objects);
+}
+
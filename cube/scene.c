@@ -0,0 +1,555 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "glad.h"
+
+// The demo scene, shared by the windowed loop and the headless benchmark.
+
+#define SCENE_MAX_OBJECTS 16384
+#define SCENE_STEP        (1.0 / 60.0) // seconds per scene_update
+#define SCENE_MAX_STEPS   5            // per frame, see timestep.c
+#define SCENE_CAMERA_BINDING 0 // uniform buffer binding of the Camera block
+#define SCENE_OBJECT_BINDING 1 // and of the Object block, see SCENE_SUBMIT_COMMANDS
+#define SCENE_JOB_GRAIN   256          // objects per job at least, see jobs_parallel_for
+// the first sets up the pass, the others draw SCENE_JOB_GRAIN objects each
+#define SCENE_COMMAND_LISTS (1 + (SCENE_MAX_OBJECTS + SCENE_JOB_GRAIN - 1) / SCENE_JOB_GRAIN)
+
+// hashed once, looked up in the reflection of whatever program is bound
+static struct {
+	uint32_t camera_block, object_block, model, color, light_dir;
+} uniform_names;
+
+// the view projection comes from the Camera block, see scene_render_packet
+void draw_mesh(const MeshHot* mesh, const ProgramReflection* program, const M4f* model) {
+	PROFILE_ZONE("draw_mesh");
+
+	render_bind_vertex_array(mesh->vao);
+	glUniformMatrix4fv(shader_reflect_location(program, uniform_names.model), 1, GL_TRUE, &model->m[0][0]);
+	glUniform3f(shader_reflect_location(program, uniform_names.color), 0.8f, 0.2f, 0.2f);
+	glUniform3f(shader_reflect_location(program, uniform_names.light_dir), -0.5f, -1.0f, -0.5f);
+
+	render_draw_elements_base_vertex(GL_TRIANGLES, mesh->indices_count, GL_UNSIGNED_INT,
+									 (const void *)((size_t)mesh->first_index * sizeof(Index)), mesh->base_vertex);
+	//glDrawElements(GL_POINTS, mesh.indices_count, GL_UNSIGNED_INT, 0);
+}
+
+Mesh cube_generate_mesh() {
+	static const Vertex vertices[24] = {
+		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
+		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
+		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
+		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  0.0f,  1.0f} },
+
+		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
+		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
+		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
+		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  0.0f, -1.0f} },
+
+		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
+		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
+		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
+		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = {-1.0f,  0.0f,  0.0f} },
+
+		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
+		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
+		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
+		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 1.0f,  0.0f,  0.0f} },
+
+		{ .pos = {-0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
+		{ .pos = { 0.5f,  0.5f, -0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
+		{ .pos = { 0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
+		{ .pos = {-0.5f,  0.5f,  0.5f}, .normal = { 0.0f,  1.0f,  0.0f} },
+
+		{ .pos = {-0.5f, -0.5f, -0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
+		{ .pos = { 0.5f, -0.5f, -0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
+		{ .pos = { 0.5f, -0.5f,  0.5f}, .normal = { 0.0f, -1.0f,  0.0f} },
+		{ .pos = {-0.5f, -0.5f,  0.5f}, .normal = { 0.0f, -1.0f,  0.0f} }
+	};
+	static const Index indices[36] = {
+		0,  1,  2,   0,  2,  3,
+		4,  6,  5,   4,  7,  6,
+		8,  9, 10,   8, 10, 11,
+		12, 14, 13,  12, 15, 14,
+		16, 18, 17,  16, 19, 18,
+		20, 21, 22,  20, 22, 23
+	};
+	// static, so not owned
+	Mesh cube_mesh = {0};
+	cube_mesh.vertices = (Vertex*)vertices;
+	cube_mesh.indices = (Index*)indices;
+	cube_mesh.vertices_count = sizeof(vertices) / sizeof(Vertex);
+	cube_mesh.indices_count = sizeof(indices) / sizeof(Index);
+	return cube_mesh;
+}
+
+// unit diameter like the cube, rings run from pole to pole
+Mesh sphere_generate_mesh(int rings, int segments) {
+	Mesh sphere_mesh = {0};
+	sphere_mesh.vertices_count = (size_t)(rings + 1) * (segments + 1);
+	sphere_mesh.indices_count = (size_t)rings * segments * 6;
+	sphere_mesh.vertices = malloc(sphere_mesh.vertices_count * sizeof(Vertex));
+	sphere_mesh.indices = malloc(sphere_mesh.indices_count * sizeof(Index));
+	sphere_mesh.owned = true;
+	if (sphere_mesh.vertices == NULL || sphere_mesh.indices == NULL) {
+		free(sphere_mesh.vertices);
+		free(sphere_mesh.indices);
+		return (Mesh){0};
+	}
+
+	const float pi = 3.14159265f;
+	Vertex *vertex = sphere_mesh.vertices;
+	for (int i = 0; i <= rings; ++i) {
+		float theta = pi * i / rings;
+		for (int j = 0; j <= segments; ++j) {
+			float phi = 2.0f * pi * j / segments;
+			V3f normal = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+			*vertex++ = (Vertex){ .pos = { normal.x * 0.5f, normal.y * 0.5f, normal.z * 0.5f }, .normal = normal };
+		}
+	}
+
+	Index *index = sphere_mesh.indices;
+	for (int i = 0; i < rings; ++i) {
+		for (int j = 0; j < segments; ++j) {
+			Index a = i * (segments + 1) + j;
+			Index b = a + segments + 1;
+			*index++ = a;     *index++ = a + 1; *index++ = b;
+			*index++ = a + 1; *index++ = b + 1; *index++ = b;
+		}
+	}
+	return sphere_mesh;
+}
+
+typedef enum {
+	SCENE_MESH_CUBE = 0,
+	SCENE_MESH_SPHERE,
+	SCENE_MESH_COUNT,
+} SceneMesh;
+
+const char *scene_mesh_names[SCENE_MESH_COUNT] = { "cube", "sphere" };
+
+// how scene_update moves the camera, STATIC leaves it to the caller
+typedef enum {
+	SCENE_CAMERA_STATIC = 0,
+	SCENE_CAMERA_ORBIT,
+	SCENE_CAMERA_DOLLY,
+	SCENE_CAMERA_COUNT,
+} SceneCameraPath;
+
+const char *scene_camera_names[SCENE_CAMERA_COUNT] = { "static", "orbit", "dolly" };
+
+// How the draws reach GL. Direct calls draw_mesh per object on the GL
+// thread, commands records command lists on the workers while the packet
+// is built and the GL thread only replays them.
+typedef enum {
+	SCENE_SUBMIT_DIRECT = 0,
+	SCENE_SUBMIT_COMMANDS,
+	SCENE_SUBMIT_COUNT,
+} SceneSubmit;
+
+const char *scene_submit_names[SCENE_SUBMIT_COUNT] = { "direct", "commands" };
+
+typedef struct {
+	Transform transform;
+	Transform previous; // before the newest step, rendering interpolates
+	float spin; // radians per second around every axis
+} SceneObject;
+
+// Everything a frame draws, interpolated and turned into matrices, so
+// drawing it needs nothing else from the scene and can happen on another
+// thread while the scene steps on.
+typedef struct {
+	Camera camera; // interpolated, scene_packet_rotate can still turn it
+	SceneMesh mesh;
+	uint32_t shader_features;
+	bool debug_overdraw;
+	SceneSubmit submit;
+	size_t objects_count;
+	M4f models[SCENE_MAX_OBJECTS]; // direct only
+	CommandList command_lists[SCENE_COMMAND_LISTS]; // commands only
+	size_t command_lists_count;
+	FrameArena arena; // what the packet allocates, reset when it's built again
+} ScenePacket;
+
+typedef struct Scene {
+	Camera camera;
+	Transform camera_previous;
+	SceneCameraPath camera_path;
+	float camera_distance;
+	float time;
+	MeshHandle meshes[SCENE_MESH_COUNT];
+	SceneMesh mesh; // every object is drawn with this one
+	ShaderFamily shader;
+	uint32_t shader_features;
+	bool debug_overdraw; // draw the overdraw heat map instead of the shaded scene
+	SceneSubmit submit;
+	SceneObject objects[SCENE_MAX_OBJECTS];
+	size_t objects_count;
+	BufferHandle camera_buffer; // the Camera uniform block
+
+	// called right before the camera is written into the packet, the last
+	// chance to apply input to the scene, see scene_packet_rotate for after
+	void (*late_latch)(struct Scene *scene, void *user);
+	void *late_latch_user;
+
+	ScenePacket packet; // headless_run's, where build and draw go together
+} Scene;
+
+// makes the current state the previous one too, after teleporting things
+void scene_snap(Scene* scene) {
+	scene->camera_previous = scene->camera.transform;
+	for (size_t i = 0; i < scene->objects_count; ++i) {
+		scene->objects[i].previous = scene->objects[i].transform;
+	}
+}
+
+// a job, one mesh per index
+static void scene_generate_meshes(void *data, size_t begin, size_t end) {
+	Mesh *meshes = data;
+	for (size_t i = begin; i < end; ++i) {
+		switch (i) {
+			case SCENE_MESH_CUBE:   meshes[i] = cube_generate_mesh(); break;
+			case SCENE_MESH_SPHERE: meshes[i] = sphere_generate_mesh(16, 32); break;
+		}
+	}
+}
+
+void scene_init(Scene* scene, float aspect) {
+	uniform_names.camera_block = shader_name_hash("Camera");
+	uniform_names.object_block = shader_name_hash("Object");
+	uniform_names.model     = shader_name_hash("u_model");
+	uniform_names.color     = shader_name_hash("u_color");
+	uniform_names.light_dir = shader_name_hash("u_light_dir");
+
+	scene->shader = shader_family_register("cube.vert", "cube.frag");
+	overdraw_init();
+	scene->shader_features = SHADER_FEATURE_LIGHTING;
+
+	Mesh meshes[SCENE_MESH_COUNT];
+	jobs_parallel_for(SCENE_MESH_COUNT, 1, scene_generate_meshes, meshes);
+	for (int i = 0; i < SCENE_MESH_COUNT; ++i) {
+		scene->meshes[i] = mesh_create(&meshes[i], scene_mesh_names[i]);
+	}
+	scene->mesh = SCENE_MESH_CUBE;
+	scene->camera_path = SCENE_CAMERA_STATIC;
+	scene->time = 0.0f;
+	scene->debug_overdraw = false;
+	scene->submit = SCENE_SUBMIT_DIRECT;
+	command_replay_init();
+
+	scene->camera_buffer = buffer_create(GL_UNIFORM_BUFFER, sizeof(M4f), NULL, GL_DYNAMIC_DRAW, "camera");
+	glBindBufferBase(GL_UNIFORM_BUFFER, SCENE_CAMERA_BINDING, buffer_name(scene->camera_buffer));
+
+	render_set_capability(GL_DEPTH_TEST, true);
+	render_set_capability(GL_CULL_FACE, true);
+	glCullFace(GL_BACK);
+	//glFrontFace(GL_CW);
+
+	scene->camera = (Camera){0};
+	scene->camera.transform.position.z = 2;
+	scene->camera.transform.scale = (V3f){1,1,1};
+	scene->camera.fov = 50;
+	scene->camera.aspect = aspect;
+	camera_update(&scene->camera);
+
+	scene->objects[0] = (SceneObject){
+		.transform = { .position = {0, 0, 0}, .scale = {1, 1, 1} },
+		.spin = 2.0f,
+	};
+	scene->objects[1] = scene->objects[0];
+	scene->objects[1].transform.position.x += 2;
+	scene->objects[1].spin = 1.0f;
+	scene->objects_count = 2;
+	scene_snap(scene);
+}
+
+// Replaces the objects with a cube shaped grid of count of them and
+// backs the camera off far enough to see all of it.
+void scene_layout_grid(Scene* scene, size_t count) {
+	if (count > SCENE_MAX_OBJECTS) {
+		count = SCENE_MAX_OBJECTS;
+	}
+	int side = 1;
+	while ((size_t)side * side * side < count) {
+		side += 1;
+	}
+
+	const float spacing = 2.0f;
+	float offset = (side - 1) * spacing * 0.5f;
+	for (size_t i = 0; i < count; ++i) {
+		int x = i % side;
+		int y = (i / side) % side;
+		int z = i / ((size_t)side * side);
+		scene->objects[i] = (SceneObject){
+			.transform = {
+				.position = { x * spacing - offset, y * spacing - offset, z * spacing - offset },
+				.scale = {1, 1, 1},
+			},
+			.spin = 0.5f + (i % 7) * 0.25f,
+		};
+	}
+	scene->objects_count = count;
+
+	scene->time = 0.0f;
+	scene->camera_distance = side * spacing * 1.2f + 2.0f;
+	scene->camera.transform.position = (V3f){0, 0, scene->camera_distance};
+	scene->camera.transform.rotation = (V3f){0, 0, 0};
+	scene_snap(scene);
+}
+
+static void scene_look(Transform *transform, float yaw, float pitch) {
+	V3f *rotation = &transform->rotation;
+	rotation->y += yaw;
+	rotation->x += pitch;
+	if (rotation->x >  1.5f) rotation->x =  1.5f;
+	if (rotation->x < -1.5f) rotation->x = -1.5f;
+}
+
+// looking around is applied to both states, mouse input is never interpolated
+void scene_camera_rotate(Scene* scene, float yaw, float pitch) {
+	scene_look(&scene->camera.transform, yaw, pitch);
+	scene_look(&scene->camera_previous, yaw, pitch);
+}
+
+// Turns the camera of a built packet, for mouse motion that arrived after
+// it was built. Only the packet changes, the scene's camera gets the same
+// motion through the late latch of a later packet.
+void scene_packet_rotate(ScenePacket* packet, float yaw, float pitch) {
+	if (yaw == 0.0f && pitch == 0.0f) {
+		return;
+	}
+	scene_look(&packet->camera.transform, yaw, pitch);
+	camera_update(&packet->camera);
+}
+
+static void scene_update_camera(Scene* scene) {
+	Transform *transform = &scene->camera.transform;
+	switch (scene->camera_path) {
+	case SCENE_CAMERA_ORBIT: {
+		float angle = scene->time * 0.5f;
+		transform->position = (V3f){ sinf(angle) * scene->camera_distance, 0, cosf(angle) * scene->camera_distance };
+		transform->rotation = (V3f){ 0, angle, 0 };
+	} break;
+	case SCENE_CAMERA_DOLLY:
+		transform->position = (V3f){ 0, 0, scene->camera_distance * (0.75f + 0.25f * sinf(scene->time)) };
+		transform->rotation = (V3f){ 0, 0, 0 };
+		break;
+	default:
+		break;
+	}
+}
+
+typedef struct {
+	Scene *scene;
+	float delta_time;
+} SceneUpdateJob;
+
+static void scene_update_objects(void *data, size_t begin, size_t end) {
+	SceneUpdateJob *job = data;
+	for (size_t i = begin; i < end; ++i) {
+		SceneObject *object = &job->scene->objects[i];
+		object->previous = object->transform;
+		float angle = object->spin * job->delta_time;
+		object->transform.rotation.x += angle;
+		object->transform.rotation.y += angle;
+		object->transform.rotation.z += angle;
+	}
+}
+
+// one fixed step of SCENE_STEP, the state before it is kept for interpolation
+void scene_update(Scene* scene, float delta_time) {
+	PROFILE_ZONE("scene_update");
+	scene->camera_previous = scene->camera.transform;
+	scene->time += delta_time;
+	scene_update_camera(scene);
+	SceneUpdateJob job = { scene, delta_time };
+	jobs_parallel_for(scene->objects_count, SCENE_JOB_GRAIN, scene_update_objects, &job);
+}
+
+// the scene's features plus what the way of submitting needs
+static uint32_t scene_draw_features(const Scene* scene) {
+	return scene->shader_features | (scene->submit == SCENE_SUBMIT_COMMANDS ? SHADER_FEATURE_OBJECT_BLOCK : 0);
+}
+
+// the variant the scene draws with, PROGRAM_FAILED if it can't be built
+ProgramState scene_program_state(Scene* scene) {
+	ProgramHandle program = shader_variant_get(scene->shader, scene_draw_features(scene));
+	return program ? shader_batch_state(program) : PROGRAM_FAILED;
+}
+
+// a pass shows up in the CPU and GPU profiles and the pipeline statistics
+static void scene_pass_begin(const char *name) {
+	PROFILE_BEGIN(name);
+	GPU_PROFILE_BEGIN(name);
+	pipeline_stats_begin(name);
+}
+
+static void scene_pass_end(void) {
+	pipeline_stats_end();
+	GPU_PROFILE_END();
+	PROFILE_END();
+}
+
+typedef struct {
+	Scene *scene;
+	ScenePacket *packet;
+	float alpha;
+} SceneBuildJob;
+
+static void scene_build_models(void *data, size_t begin, size_t end) {
+	SceneBuildJob *job = data;
+	for (size_t i = begin; i < end; ++i) {
+		SceneObject *object = &job->scene->objects[i];
+		Transform transform = transform_lerp(&object->previous, &object->transform, job->alpha);
+		job->packet->models[i] = calculate_transform_matrix(&transform);
+	}
+}
+
+// a job, records the draws of SCENE_JOB_GRAIN objects per list
+static void scene_record_draws(void *data, size_t begin, size_t end) {
+	SceneBuildJob *job = data;
+	MeshHandle mesh = job->scene->meshes[job->packet->mesh];
+	// meshes are only created and destroyed outside of frames
+	const MeshHot *hot = mesh_get(mesh);
+	uint32_t indices_count = hot ? hot->indices_count : 0;
+	for (size_t chunk = begin; chunk < end; ++chunk) {
+		size_t first = chunk * SCENE_JOB_GRAIN;
+		size_t last = first + SCENE_JOB_GRAIN;
+		if (last > job->packet->objects_count) last = job->packet->objects_count;
+
+		CommandList *list = &job->packet->command_lists[1 + chunk];
+		command_list_begin(list, frame_arena_thread(&job->packet->arena),
+						   1 + 2 * (last - first), (last - first) * command_uniform_stride(sizeof(M4f)));
+		command_bind_mesh(list, mesh);
+		for (size_t i = first; i < last; ++i) {
+			uint32_t offset = 0;
+			M4f *model = command_list_alloc_uniforms(list, sizeof(M4f), &offset);
+			if (model == NULL) {
+				break;
+			}
+			SceneObject *object = &job->scene->objects[i];
+			Transform transform = transform_lerp(&object->previous, &object->transform, job->alpha);
+			// the block is row_major, M4f goes in as it is
+			*model = calculate_transform_matrix(&transform);
+			command_bind_uniforms(list, SCENE_OBJECT_BINDING, offset, sizeof(M4f));
+			command_draw(list, indices_count, 0);
+		}
+	}
+}
+
+// the program and everything that stays the same for all draws
+static void scene_record_setup(Scene* scene, ScenePacket* packet) {
+	CommandList *list = &packet->command_lists[0];
+	command_list_begin(list, frame_arena_thread(&packet->arena), 5, 0);
+	command_bind_program(list, scene->shader, packet->shader_features);
+	command_uniform_block(list, uniform_names.camera_block, SCENE_CAMERA_BINDING);
+	command_uniform_block(list, uniform_names.object_block, SCENE_OBJECT_BINDING);
+	command_uniform_v3(list, uniform_names.color, (V3f){ 0.8f, 0.2f, 0.2f });
+	command_uniform_v3(list, uniform_names.light_dir, (V3f){ -0.5f, -1.0f, -0.5f });
+}
+
+// Fills packet with the frame alpha of the way past the previous step
+// towards the newest. The late latch runs first, it's the last chance to
+// apply input to the scene for this frame.
+void scene_build_packet(Scene* scene, ScenePacket* packet, float aspect, float alpha) {
+	PROFILE_ZONE("scene_build_packet");
+
+	PROFILE_BEGIN("late_latch");
+	if (scene->late_latch != NULL) {
+		scene->late_latch(scene, scene->late_latch_user);
+	}
+	scene->camera.aspect = aspect;
+	packet->camera = scene->camera;
+	packet->camera.transform = transform_lerp(&scene->camera_previous, &scene->camera.transform, alpha);
+	camera_update(&packet->camera);
+	scene->camera.view_projection_matrix = packet->camera.view_projection_matrix;
+	PROFILE_END();
+
+	// the packet came back from the GL side, nothing reads the last frame's data
+	frame_arena_reset(&packet->arena);
+	packet->mesh = scene->mesh;
+	packet->shader_features = scene_draw_features(scene);
+	packet->debug_overdraw = scene->debug_overdraw;
+	packet->submit = scene->submit;
+	packet->objects_count = scene->objects_count;
+	SceneBuildJob job = { scene, packet, alpha };
+	if (packet->submit == SCENE_SUBMIT_COMMANDS) {
+		PROFILE_ZONE("record_commands");
+		size_t chunks = (scene->objects_count + SCENE_JOB_GRAIN - 1) / SCENE_JOB_GRAIN;
+		scene_record_setup(scene, packet);
+		packet->command_lists_count = 1 + chunks;
+		jobs_parallel_for(chunks, 1, scene_record_draws, &job);
+	} else {
+		packet->command_lists_count = 0;
+		jobs_parallel_for(scene->objects_count, SCENE_JOB_GRAIN, scene_build_models, &job);
+	}
+}
+
+// gives back the packet's arenas, it can still be built again
+void scene_packet_free(ScenePacket* packet) {
+	frame_arena_destroy(&packet->arena);
+	packet->command_lists_count = 0;
+}
+
+// with the context current, deletes the scene's meshes and buffers
+void scene_destroy(Scene* scene) {
+	for (int i = 0; i < SCENE_MESH_COUNT; ++i) {
+		mesh_destroy(scene->meshes[i]);
+		scene->meshes[i] = 0;
+	}
+	buffer_destroy(scene->camera_buffer);
+	scene->camera_buffer = 0;
+	scene_packet_free(&scene->packet);
+}
+
+// draws a packet, only the meshes, programs and buffers of the scene are used
+void scene_render_packet(Scene* scene, const ScenePacket* packet, int width, int height) {
+	PROFILE_ZONE("scene_render");
+
+	scene_pass_begin("clear");
+	const float bg_color = 20.0f/255.0f;
+	glClearColor(bg_color, bg_color, bg_color, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	scene_pass_end();
+
+	// the reflection belongs to the program, so a reloaded program
+	// brings its own locations along
+	ProgramHandle handle = shader_variant_get(scene->shader, packet->shader_features);
+	GLuint program = shader_batch_program(handle);
+	const ProgramReflection *reflection = shader_batch_reflection(handle);
+
+	// nothing to draw with until the program finished compiling
+	if (program == 0) {
+		return;
+	}
+
+	scene_pass_begin("geometry");
+	if (packet->debug_overdraw) {
+		overdraw_begin();
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer_name(scene->camera_buffer));
+	// the block is row_major, M4f goes in as it is
+	render_buffer_sub_data(GL_UNIFORM_BUFFER, 0, sizeof(M4f), &packet->camera.view_projection_matrix);
+
+	if (packet->submit == SCENE_SUBMIT_COMMANDS) {
+		command_lists_replay(packet->command_lists, packet->command_lists_count);
+	} else {
+		render_use_program(program);
+		const ShaderReflectEntry *camera_block = shader_reflect_find(reflection, uniform_names.camera_block);
+		if (camera_block != NULL) {
+			glUniformBlockBinding(program, camera_block->block_index, SCENE_CAMERA_BINDING);
+		}
+		const MeshHot *mesh = mesh_use(scene->meshes[packet->mesh]);
+		for (size_t i = 0; mesh != NULL && i < packet->objects_count; ++i) {
+			draw_mesh(mesh, reflection, &packet->models[i]);
+		}
+	}
+	scene_pass_end();
+
+	if (packet->debug_overdraw) {
+		scene_pass_begin("overdraw");
+		overdraw_end(width, height);
+		scene_pass_end();
+	}
+}
@@ -1,4 +1,5 @@
 #include "file.c"
+#include "gl_ext.c"
 #include "glad.h"
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,19 +13,18 @@ const char *shader_type_as_cstr(GLuint shader) {
 	}
 }
 
-bool shader_compile_source(const GLchar *source, GLenum shader_type, GLuint *shader) {
-	*shader = glCreateShader(shader_type);
-	glShaderSource(*shader, 1, &source, NULL);
-	glCompileShader(*shader);
-
+// querying the status waits for the driver to finish the compile
+bool shader_check_compiled(GLuint shader, GLenum shader_type) {
 	GLint compiled = 0;
-	glGetShaderiv(*shader, GL_COMPILE_STATUS, &compiled);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 
 	if (!compiled) {
 		GLchar message[1024];
 		GLsizei message_size = 0;
-		glGetShaderInfoLog(*shader, sizeof(message), &message_size, message);
-		fprintf(stderr, "[ERROR]: could not compile %s\n", shader_type_as_cstr(shader_type));
+		glGetShaderInfoLog(shader, sizeof(message), &message_size, message);
+		log_error("could not compile %s", shader_type_as_cstr(shader_type));
+		// info logs run longer than a log message, keep them after its header
+		log_flush();
 		fprintf(stderr, "%.*s\n", message_size, message);
 		return false;
 	}
@@ -32,18 +32,45 @@ bool shader_compile_source(const GLchar *source, GLenum shader_type, GLuint *sha
 	return true;
 }
 
+bool shader_check_linked(GLuint program) {
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		GLsizei message_size = 0;
+		GLchar message[1024];
+
+		glGetProgramInfoLog(program, sizeof(message), &message_size, message);
+		log_error("Program Linking:");
+		log_flush();
+		fprintf(stderr, "%.*s\n", message_size, message);
+		return false;
+	}
+
+	return true;
+}
+
+bool shader_compile_source(const GLchar *source, GLenum shader_type, GLuint *shader) {
+	*shader = glCreateShader(shader_type);
+	glShaderSource(*shader, 1, &source, NULL);
+	glCompileShader(*shader);
+
+	return shader_check_compiled(*shader, shader_type);
+}
+
 bool shader_compile_file(const char *file_path, GLenum shader_type, GLuint *shader) {
-	char *source = read_entire_file(file_path);
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *source = read_entire_file_arena(file_path, scratch);
 	if (source == NULL) {
-		fprintf(stderr, "[ERROR]: failed to read file `%s`: %s\n", file_path, strerror(errno));
+		log_error("failed to read file `%s`: %s", file_path, strerror(errno));
 		errno = 0;
 		return false;
 	}
 	bool ok = shader_compile_source(source, shader_type, shader);
 	if (!ok) {
-		fprintf(stderr, "[ERROR]: failed to compile `%s` shader file\n", file_path);
+		log_error("failed to compile `%s` shader file", file_path);
 	}
-	free(source);
+	arena_rewind(scratch, mark);
 	return ok;
 }
 
@@ -52,22 +79,17 @@ bool shader_link_program(GLuint vert_shader, GLuint frag_shader, GLuint *program
 
 	glAttachShader(*program, vert_shader);
 	glAttachShader(*program, frag_shader);
+	if (glProgramParameteri != NULL) {
+		glProgramParameteri(*program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(*program);
 
-	GLint linked = 0;
-	glGetProgramiv(*program, GL_LINK_STATUS, &linked);
-	if (!linked) {
-		GLsizei message_size = 0;
-		GLchar message[1024];
-
-		glGetProgramInfoLog(*program, sizeof(message), &message_size, message);
-		fprintf(stderr, "[ERROR]: Program Linking: %.*s\n", message_size, message);
-	}
+	bool linked = shader_check_linked(*program);
 
 	glDeleteShader(vert_shader);
 	glDeleteShader(frag_shader);
 
-	return program;
+	return linked;
 }
 
 bool shader_load_program(const char *vertex_file_path, const char *fragment_file_path, GLuint *program) {
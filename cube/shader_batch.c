@@ -0,0 +1,234 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glad.h"
+
+// Non-blocking program builds.
+// shader_batch_submit only issues the compile and link calls, nothing reads
+// back a status until shader_batch_poll. With KHR_parallel_shader_compile the
+// poll asks GL_COMPLETION_STATUS_KHR first so it never waits on the driver,
+// without it the status query blocks, but only after everything else was
+// submitted, so drivers that compile on their own threads still overlap.
+// Programs are pooled, see pool.c. Binding reads the state and the GL
+// program, everything that's only needed while building is cold, the
+// reflection is looked up once per bind and kept apart from both.
+
+#define SHADER_BATCH_MAX_PROGRAMS 256
+
+typedef enum {
+	PROGRAM_NONE = 0,
+	PROGRAM_PENDING,
+	PROGRAM_READY,
+	PROGRAM_FAILED,
+} ProgramState;
+
+// 0 is never a valid handle
+typedef uint32_t ProgramHandle;
+
+typedef struct {
+	ProgramState state;
+	GLuint program;
+} ShaderBatchHot;
+
+typedef struct {
+	GLuint vert, frag;
+	uint64_t cache_key;
+	const char *name; // not owned, must outlive the program
+} ShaderBatchCold;
+
+static struct {
+	HandlePool pool;
+	ShaderBatchHot hot[SHADER_BATCH_MAX_PROGRAMS];
+	ShaderBatchCold cold[SHADER_BATCH_MAX_PROGRAMS];
+	ProgramReflection reflections[SHADER_BATCH_MAX_PROGRAMS];
+	uint32_t pending;
+} shader_batch = { .pool = POOL_INIT("programs", SHADER_BATCH_MAX_PROGRAMS) };
+
+void shader_batch_init(void) {
+	if (gl_ext_parallel_shader_compile) {
+		// let the driver pick how many threads it wants
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+}
+
+// NULL for stale handles
+static ShaderBatchHot *shader_batch_find(ProgramHandle handle, uint32_t *position) {
+	return pool_find(&shader_batch.pool, handle, position) ? &shader_batch.hot[*position] : NULL;
+}
+
+ProgramHandle shader_batch_submit(const char *vert_source, const char *frag_source, const char *name) {
+	uint32_t position = 0;
+	ProgramHandle handle = pool_acquire(&shader_batch.pool, &position);
+	if (handle == 0) {
+		log_error("could not submit `%s`", name);
+		return 0;
+	}
+
+	ShaderBatchHot *hot = &shader_batch.hot[position];
+	ShaderBatchCold *cold = &shader_batch.cold[position];
+	*hot = (ShaderBatchHot){0};
+	*cold = (ShaderBatchCold){ .name = name, .cache_key = shader_cache_key(vert_source, frag_source) };
+
+	if (shader_cache_load(cold->cache_key, &hot->program)) {
+		hot->state = PROGRAM_READY;
+		shader_reflect_build(hot->program, &shader_batch.reflections[position]);
+		return handle;
+	}
+
+	cold->vert = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(cold->vert, 1, &vert_source, NULL);
+	glCompileShader(cold->vert);
+
+	cold->frag = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(cold->frag, 1, &frag_source, NULL);
+	glCompileShader(cold->frag);
+
+	// linking with a failed shader just fails the link, the compile logs
+	// are picked up once the link status is known
+	hot->program = glCreateProgram();
+	glAttachShader(hot->program, cold->vert);
+	glAttachShader(hot->program, cold->frag);
+	if (glProgramParameteri != NULL) {
+		glProgramParameteri(hot->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(hot->program);
+
+	hot->state = PROGRAM_PENDING;
+	shader_batch.pending += 1;
+	return handle;
+}
+
+static void shader_batch_finish(uint32_t position) {
+	ShaderBatchHot *hot = &shader_batch.hot[position];
+	ShaderBatchCold *cold = &shader_batch.cold[position];
+	GLint linked = 0;
+	glGetProgramiv(hot->program, GL_LINK_STATUS, &linked);
+
+	if (linked) {
+		hot->state = PROGRAM_READY;
+		shader_reflect_build(hot->program, &shader_batch.reflections[position]);
+		shader_cache_store(cold->cache_key, hot->program);
+	} else {
+		shader_check_compiled(cold->vert, GL_VERTEX_SHADER);
+		shader_check_compiled(cold->frag, GL_FRAGMENT_SHADER);
+		shader_check_linked(hot->program);
+		log_error("failed to build program `%s`", cold->name);
+		glDeleteProgram(hot->program);
+		hot->program = 0;
+		hot->state = PROGRAM_FAILED;
+	}
+
+	glDeleteShader(cold->vert);
+	glDeleteShader(cold->frag);
+	cold->vert = 0;
+	cold->frag = 0;
+	shader_batch.pending -= 1;
+}
+
+// returns the number of programs still compiling
+uint32_t shader_batch_poll(void) {
+	if (shader_batch.pending == 0) {
+		return 0;
+	}
+	// finished programs go to the shader cache through the heap
+	alloc_track_excuse();
+
+	for (uint32_t i = 0; i < shader_batch.pool.count; ++i) {
+		const ShaderBatchHot *hot = &shader_batch.hot[i];
+		if (hot->state != PROGRAM_PENDING) {
+			continue;
+		}
+
+		if (gl_ext_parallel_shader_compile) {
+			GLint completed = 0;
+			glGetProgramiv(hot->program, GL_COMPLETION_STATUS_KHR, &completed);
+			if (!completed) {
+				continue;
+			}
+		}
+		shader_batch_finish(i);
+	}
+
+	return shader_batch.pending;
+}
+
+// queues the program for deletion, the handle reads as PROGRAM_NONE afterwards
+void shader_batch_release(ProgramHandle handle) {
+	uint32_t position = 0;
+	ShaderBatchHot *hot = shader_batch_find(handle, &position);
+	if (hot == NULL) {
+		return;
+	}
+
+	if (hot->state == PROGRAM_PENDING) {
+		glDeleteShader(shader_batch.cold[position].vert);
+		glDeleteShader(shader_batch.cold[position].frag);
+		shader_batch.pending -= 1;
+	}
+	// GL may hand the name out again, the state cache must not match it,
+	// it's deleted once frames in flight are done with it
+	render_state_forget_program(hot->program);
+	retire_program(hot->program);
+
+	uint32_t to = 0, from = 0;
+	pool_release(&shader_batch.pool, handle, &to, &from);
+	shader_batch.hot[to] = shader_batch.hot[from];
+	shader_batch.cold[to] = shader_batch.cold[from];
+	if (to != from) {
+		shader_batch.reflections[to] = shader_batch.reflections[from];
+	}
+}
+
+ProgramState shader_batch_state(ProgramHandle handle) {
+	uint32_t position = 0;
+	ShaderBatchHot *hot = shader_batch_find(handle, &position);
+	return hot ? hot->state : PROGRAM_NONE;
+}
+
+// 0 until the program is ready
+GLuint shader_batch_program(ProgramHandle handle) {
+	uint32_t position = 0;
+	ShaderBatchHot *hot = shader_batch_find(handle, &position);
+	if (hot == NULL || hot->state != PROGRAM_READY) {
+		return 0;
+	}
+	return hot->program;
+}
+
+ProgramHandle shader_batch_submit_files(const char *vertex_file_path, const char *fragment_file_path) {
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *vert_source = read_entire_file_arena(vertex_file_path, scratch);
+	if (vert_source == NULL) {
+		log_error("failed to read file `%s`: %s", vertex_file_path, strerror(errno));
+		errno = 0;
+		return 0;
+	}
+
+	char *frag_source = read_entire_file_arena(fragment_file_path, scratch);
+	if (frag_source == NULL) {
+		log_error("failed to read file `%s`: %s", fragment_file_path, strerror(errno));
+		errno = 0;
+		arena_rewind(scratch, mark);
+		return 0;
+	}
+
+	// GL copies the sources in glShaderSource
+	ProgramHandle handle = shader_batch_submit(vert_source, frag_source, fragment_file_path);
+	arena_rewind(scratch, mark);
+	return handle;
+}
+
+// NULL until the program is ready
+const ProgramReflection *shader_batch_reflection(ProgramHandle handle) {
+	uint32_t position = 0;
+	ShaderBatchHot *hot = shader_batch_find(handle, &position);
+	if (hot == NULL || hot->state != PROGRAM_READY) {
+		return NULL;
+	}
+	return &shader_batch.reflections[position];
+}
+
@@ -0,0 +1,213 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "glad.h"
+
+// On-disk cache of linked program binaries.
+// Entries are keyed by a hash of the shader sources and the driver strings,
+// so a driver update or a shader edit simply misses the cache.
+
+#define SHADER_CACHE_MAGIC   0x43485350u // "PSHC"
+#define SHADER_CACHE_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+} ShaderCacheHeader;
+
+static struct {
+	bool enabled;
+	char dir[256];
+	uint64_t driver_hash;
+} shader_cache;
+
+bool shader_cache_init(const char *dir) {
+	shader_cache.enabled = false;
+
+	if (glGetProgramBinary == NULL || glProgramBinary == NULL) {
+		return false;
+	}
+
+	GLint format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+	if (format_count <= 0) {
+		return false;
+	}
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		log_error("could not create shader cache directory `%s`: %s", dir, strerror(errno));
+		errno = 0;
+		return false;
+	}
+	errno = 0;
+
+	snprintf(shader_cache.dir, sizeof(shader_cache.dir), "%s", dir);
+	shader_cache.driver_hash = hash_cstr((const char *)glGetString(GL_RENDERER), HASH_FNV1A64_SEED);
+	shader_cache.driver_hash = hash_cstr((const char *)glGetString(GL_VERSION), shader_cache.driver_hash);
+	shader_cache.enabled = true;
+	return true;
+}
+
+uint64_t shader_cache_key(const char *vert_source, const char *frag_source) {
+	uint64_t key = shader_cache.driver_hash;
+	key = hash_cstr(vert_source, key);
+	key = hash_cstr(frag_source, key);
+	return key;
+}
+
+static void shader_cache_path(uint64_t key, char *path, size_t path_size) {
+	snprintf(path, path_size, "%s/%016llx.bin", shader_cache.dir, (unsigned long long)key);
+}
+
+bool shader_cache_load(uint64_t key, GLuint *program) {
+	if (!shader_cache.enabled) {
+		return false;
+	}
+
+	char path[512];
+	shader_cache_path(key, path, sizeof(path));
+
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		errno = 0;
+		return false;
+	}
+
+	ShaderCacheHeader header = {0};
+	void *binary = NULL;
+	bool ok = false;
+
+	if (fread(&header, sizeof(header), 1, f) != 1) goto done;
+	if (header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION) goto done;
+	if (header.key != key || header.length == 0) goto done;
+
+	binary = malloc(header.length);
+	if (binary == NULL) goto done;
+	if (fread(binary, 1, header.length, f) != header.length) goto done;
+
+	*program = glCreateProgram();
+	glProgramBinary(*program, header.format, binary, header.length);
+
+	GLint linked = 0;
+	glGetProgramiv(*program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		// the driver is free to reject binaries at any time, just rebuild
+		glDeleteProgram(*program);
+		*program = 0;
+		goto done;
+	}
+	ok = true;
+
+done:
+	fclose(f);
+	free(binary);
+	if (!ok) {
+		remove(path);
+	}
+	errno = 0;
+	return ok;
+}
+
+void shader_cache_store(uint64_t key, GLuint program) {
+	if (!shader_cache.enabled) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	void *binary = malloc(length);
+	if (binary == NULL) {
+		return;
+	}
+
+	ShaderCacheHeader header = {
+		.magic = SHADER_CACHE_MAGIC,
+		.version = SHADER_CACHE_VERSION,
+		.key = key,
+	};
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.format, binary);
+	header.length = written;
+
+	char path[512];
+	char tmp_path[520];
+	shader_cache_path(key, path, sizeof(path));
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	// write then rename so a crash never leaves a truncated entry behind
+	FILE *f = fopen(tmp_path, "wb");
+	if (f == NULL) {
+		log_error("could not write shader cache entry `%s`: %s", tmp_path, strerror(errno));
+		errno = 0;
+		free(binary);
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(binary, 1, written, f) == (size_t)written;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok || rename(tmp_path, path) < 0) {
+		remove(tmp_path);
+	}
+	errno = 0;
+	free(binary);
+}
+
+bool shader_program_from_sources(const char *vert_source, const char *frag_source, GLuint *program) {
+	uint64_t key = shader_cache_key(vert_source, frag_source);
+	if (shader_cache_load(key, program)) {
+		return true;
+	}
+
+	GLuint vert = 0;
+	if (!shader_compile_source(vert_source, GL_VERTEX_SHADER, &vert)) {
+		return false;
+	}
+
+	GLuint frag = 0;
+	if (!shader_compile_source(frag_source, GL_FRAGMENT_SHADER, &frag)) {
+		glDeleteShader(vert);
+		return false;
+	}
+
+	if (!shader_link_program(vert, frag, program)) {
+		return false;
+	}
+
+	shader_cache_store(key, *program);
+	return true;
+}
+
+bool shader_load_program_cached(const char *vertex_file_path, const char *fragment_file_path, GLuint *program) {
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *vert_source = read_entire_file_arena(vertex_file_path, scratch);
+	if (vert_source == NULL) {
+		log_error("failed to read file `%s`: %s", vertex_file_path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	char *frag_source = read_entire_file_arena(fragment_file_path, scratch);
+	if (frag_source == NULL) {
+		log_error("failed to read file `%s`: %s", fragment_file_path, strerror(errno));
+		errno = 0;
+		arena_rewind(scratch, mark);
+		return false;
+	}
+
+	bool ok = shader_program_from_sources(vert_source, frag_source, program);
+	arena_rewind(scratch, mark);
+	return ok;
+}
+
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// GLSL has no #include, so sources are expanded here before they reach the
+// driver. Every file gets its own source string number in the #line
+// directives, compile errors read `<file index>:<line>` where the index is
+// the position in ShaderSource.files.
+
+#define SHADER_PREPROCESS_MAX_FILES 16
+#define SHADER_PREPROCESS_MAX_DEPTH 8
+#define SHADER_PREPROCESS_PATH_SIZE 256
+
+typedef enum {
+	SHADER_FEATURE_LIGHTING     = 1 << 0,
+	SHADER_FEATURE_INSTANCED    = 1 << 1,
+	SHADER_FEATURE_SKINNED      = 1 << 2,
+	SHADER_FEATURE_OBJECT_BLOCK = 1 << 3, // u_model from a uniform block, see command_list.c
+	SHADER_FEATURE_COUNT        = 4,
+} ShaderFeature;
+
+static const char *shader_feature_names[SHADER_FEATURE_COUNT] = {
+	"LIGHTING",
+	"INSTANCED",
+	"SKINNED",
+	"OBJECT_BLOCK",
+};
+
+typedef struct {
+	char *items;
+	size_t count;
+	size_t capacity;
+} StringBuilder;
+
+typedef struct {
+	char *source;
+	// every file that went into source, the first one is the root
+	char files[SHADER_PREPROCESS_MAX_FILES][SHADER_PREPROCESS_PATH_SIZE];
+	size_t files_count;
+} ShaderSource;
+
+static bool sb_append(StringBuilder *sb, const char *data, size_t size) {
+	if (sb->count + size + 1 > sb->capacity) {
+		size_t capacity = sb->capacity ? sb->capacity : 1024;
+		while (sb->count + size + 1 > capacity) capacity *= 2;
+		char *items = realloc(sb->items, capacity);
+		if (items == NULL) return false;
+		sb->items = items;
+		sb->capacity = capacity;
+	}
+	memcpy(sb->items + sb->count, data, size);
+	sb->count += size;
+	sb->items[sb->count] = '\0';
+	return true;
+}
+
+static bool sb_appendf(StringBuilder *sb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static bool sb_appendf(StringBuilder *sb, const char *fmt, ...) {
+	char buffer[256];
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+	if (n < 0 || (size_t)n >= sizeof(buffer)) return false;
+	return sb_append(sb, buffer, n);
+}
+
+// returns the argument of a `#<directive>` line, or NULL if the line is something else
+static const char *shader_line_directive(const char *line, const char *line_end, const char *directive) {
+	while (line < line_end && (*line == ' ' || *line == '\t')) line++;
+	if (line >= line_end || *line != '#') return NULL;
+	line++;
+	while (line < line_end && (*line == ' ' || *line == '\t')) line++;
+
+	size_t size = strlen(directive);
+	if ((size_t)(line_end - line) < size || strncmp(line, directive, size) != 0) return NULL;
+	line += size;
+	if (line < line_end && *line != ' ' && *line != '\t') return NULL;
+	while (line < line_end && (*line == ' ' || *line == '\t')) line++;
+	return line;
+}
+
+static void shader_include_path(const char *including_path, const char *name, size_t name_size, char *path) {
+	const char *slash = strrchr(including_path, '/');
+	if (name[0] == '/' || slash == NULL) {
+		snprintf(path, SHADER_PREPROCESS_PATH_SIZE, "%.*s", (int)name_size, name);
+	} else {
+		snprintf(path, SHADER_PREPROCESS_PATH_SIZE, "%.*s/%.*s",
+			(int)(slash - including_path), including_path, (int)name_size, name);
+	}
+}
+
+static bool shader_preprocess_file(ShaderSource *out, StringBuilder *sb, const char *file_path,
+								   uint32_t features, size_t depth) {
+	if (depth > SHADER_PREPROCESS_MAX_DEPTH) {
+		log_error("`%s`: includes nested too deep", file_path);
+		return false;
+	}
+
+	// every file is only expanded once, like an implicit #pragma once
+	for (size_t i = 0; i < out->files_count; ++i) {
+		if (strcmp(out->files[i], file_path) == 0) return true;
+	}
+	if (out->files_count >= SHADER_PREPROCESS_MAX_FILES) {
+		log_error("`%s`: too many included files", file_path);
+		return false;
+	}
+	size_t file_index = out->files_count++;
+	snprintf(out->files[file_index], SHADER_PREPROCESS_PATH_SIZE, "%s", file_path);
+
+	// includes nest, each level rewinds to its own mark
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *text = read_entire_file_arena(file_path, scratch);
+	if (text == NULL) {
+		log_error("failed to read file `%s`: %s", file_path, strerror(errno));
+		errno = 0;
+		return false;
+	}
+
+	bool ok = true;
+	bool root = depth == 0;
+	int line_number = 1;
+	if (!root) {
+		ok = ok && sb_appendf(sb, "#line 1 %zu\n", file_index);
+	}
+
+	for (const char *line = text; ok && *line != '\0'; ++line_number) {
+		const char *line_end = strchr(line, '\n');
+		if (line_end == NULL) line_end = line + strlen(line);
+		const char *next = *line_end ? line_end + 1 : line_end;
+
+		const char *include = shader_line_directive(line, line_end, "include");
+		if (include != NULL) {
+			const char *name_end = include < line_end && *include == '"'
+				? memchr(include + 1, '"', line_end - include - 1) : NULL;
+			if (name_end == NULL) {
+				log_error("%s:%d: malformed #include", file_path, line_number);
+				ok = false;
+				break;
+			}
+
+			char path[SHADER_PREPROCESS_PATH_SIZE];
+			shader_include_path(file_path, include + 1, name_end - include - 1, path);
+			ok = shader_preprocess_file(out, sb, path, features, depth + 1)
+				&& sb_appendf(sb, "#line %d %zu\n", line_number + 1, file_index);
+		} else {
+			ok = sb_append(sb, line, next - line);
+			if (ok && *line_end == '\0') ok = sb_append(sb, "\n", 1);
+
+			// feature defines go right after #version, which has to stay first
+			if (ok && root && shader_line_directive(line, line_end, "version") != NULL) {
+				for (size_t i = 0; ok && i < SHADER_FEATURE_COUNT; ++i) {
+					if (features & (1u << i)) {
+						ok = sb_appendf(sb, "#define %s 1\n", shader_feature_names[i]);
+					}
+				}
+				ok = ok && sb_appendf(sb, "#line %d %zu\n", line_number + 1, file_index);
+			}
+		}
+		line = next;
+	}
+
+	arena_rewind(scratch, mark);
+	return ok;
+}
+
+bool shader_preprocess(const char *file_path, uint32_t features, ShaderSource *out) {
+	out->source = NULL;
+	out->files_count = 0;
+
+	StringBuilder sb = {0};
+	if (!shader_preprocess_file(out, &sb, file_path, features, 0) || sb.items == NULL) {
+		log_error("failed to preprocess `%s`", file_path);
+		free(sb.items);
+		return false;
+	}
+
+	out->source = sb.items;
+	return true;
+}
+
+void shader_source_free(ShaderSource *src) {
+	free(src->source);
+	src->source = NULL;
+}
+
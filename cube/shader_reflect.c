@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "glad.h"
+
+// Per-program reflection, built once when a program links.
+// Uniforms, uniform blocks and vertex attributes are stored in one open
+// addressing table keyed by the hash of their name, so a lookup is a hash
+// probe instead of a glGetUniformLocation round trip into the driver.
+// Uses the GL 3.3 introspection calls, glGetProgramInterfaceiv needs 4.3.
+
+#define SHADER_REFLECT_CAPACITY 64 // power of two, kept at most half full
+
+typedef enum {
+	SHADER_REFLECT_NONE = 0,
+	SHADER_REFLECT_UNIFORM,
+	SHADER_REFLECT_BLOCK,
+	SHADER_REFLECT_ATTRIBUTE,
+} ShaderReflectKind;
+
+typedef struct {
+	uint32_t name_hash;
+	ShaderReflectKind kind;
+	GLenum type;        // GL_FLOAT_MAT4, ..., 0 for blocks
+	GLint size;         // array length for uniforms and attributes, data size in bytes for blocks
+	GLint location;     // -1 for uniforms inside a block
+	GLint block_index;  // the owning block for uniforms, the block itself for blocks, -1 otherwise
+} ShaderReflectEntry;
+
+typedef struct {
+	ShaderReflectEntry entries[SHADER_REFLECT_CAPACITY];
+	uint32_t count;
+} ProgramReflection;
+
+uint32_t shader_name_hash(const char *name) {
+	uint64_t h = hash_fnv1a64(name, strlen(name), HASH_FNV1A64_SEED);
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+static ShaderReflectEntry *shader_reflect_slot(ProgramReflection *reflection, uint32_t name_hash) {
+	for (uint32_t i = name_hash;; ++i) {
+		ShaderReflectEntry *entry = &reflection->entries[i & (SHADER_REFLECT_CAPACITY - 1)];
+		if (entry->kind == SHADER_REFLECT_NONE || entry->name_hash == name_hash) {
+			return entry;
+		}
+	}
+}
+
+static void shader_reflect_add(ProgramReflection *reflection, char *name, ShaderReflectEntry entry) {
+	// arrays are reported as `name[0]`, look them up by their plain name
+	char *bracket = strchr(name, '[');
+	if (bracket != NULL) *bracket = '\0';
+
+	if (reflection->count >= SHADER_REFLECT_CAPACITY / 2) {
+		log_error("too many active resources, `%s` is not reflected", name);
+		return;
+	}
+
+	entry.name_hash = shader_name_hash(name);
+	ShaderReflectEntry *slot = shader_reflect_slot(reflection, entry.name_hash);
+	if (slot->kind != SHADER_REFLECT_NONE) {
+		log_error("`%s` collides with another name in the program", name);
+		return;
+	}
+	*slot = entry;
+	reflection->count += 1;
+}
+
+void shader_reflect_build(GLuint program, ProgramReflection *reflection) {
+	*reflection = (ProgramReflection){0};
+	char name[256];
+
+	GLint uniforms = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms);
+	for (GLuint i = 0; i < (GLuint)uniforms; ++i) {
+		ShaderReflectEntry entry = { .kind = SHADER_REFLECT_UNIFORM };
+		glGetActiveUniform(program, i, sizeof(name), NULL, &entry.size, &entry.type, name);
+		glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &entry.block_index);
+		entry.location = glGetUniformLocation(program, name);
+		shader_reflect_add(reflection, name, entry);
+	}
+
+	GLint blocks = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+	for (GLuint i = 0; i < (GLuint)blocks; ++i) {
+		ShaderReflectEntry entry = { .kind = SHADER_REFLECT_BLOCK, .location = -1, .block_index = i };
+		glGetActiveUniformBlockName(program, i, sizeof(name), NULL, name);
+		glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &entry.size);
+		shader_reflect_add(reflection, name, entry);
+	}
+
+	GLint attributes = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributes);
+	for (GLuint i = 0; i < (GLuint)attributes; ++i) {
+		ShaderReflectEntry entry = { .kind = SHADER_REFLECT_ATTRIBUTE, .block_index = -1 };
+		glGetActiveAttrib(program, i, sizeof(name), NULL, &entry.size, &entry.type, name);
+		entry.location = glGetAttribLocation(program, name);
+		shader_reflect_add(reflection, name, entry);
+	}
+}
+
+// NULL if the program has no active resource with that name
+const ShaderReflectEntry *shader_reflect_find(const ProgramReflection *reflection, uint32_t name_hash) {
+	if (reflection == NULL) {
+		return NULL;
+	}
+	const ShaderReflectEntry *entry = shader_reflect_slot((ProgramReflection *)reflection, name_hash);
+	return entry->kind != SHADER_REFLECT_NONE ? entry : NULL;
+}
+
+// -1 like glGetUniformLocation when the uniform is inactive or missing
+GLint shader_reflect_location(const ProgramReflection *reflection, uint32_t name_hash) {
+	const ShaderReflectEntry *entry = shader_reflect_find(reflection, name_hash);
+	return entry ? entry->location : -1;
+}
+
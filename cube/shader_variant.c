@@ -0,0 +1,399 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shader permutations.
+// A family is a vertex/fragment file pair, a variant is that pair compiled
+// with a ShaderFeature bitmask turned into #defines. Variants are built on
+// first request through the batch compiler, or up front from a manifest.
+// When one of a variant's files changes it is rebuilt in the background and
+// the running program is only replaced once the new one linked.
+// Preprocessing only reads files, so it runs as jobs, both stages of a
+// variant at once and every variant of a manifest at once. Only handing
+// the sources to GL happens on the thread that owns the context. A rebuild
+// never waits for its files in the frame: shader_variant_update starts the
+// jobs and hands the sources over in a later frame, once they're done.
+
+#define SHADER_FAMILY_MAX  32
+#define SHADER_VARIANT_MAX 256 // power of two
+#define SHADER_VARIANT_RELOADS 8 // rebuilds preprocessing at once
+
+typedef uint32_t ShaderFamily; // 0 is never a valid family
+
+typedef struct {
+	char vert_path[SHADER_PREPROCESS_PATH_SIZE];
+	char frag_path[SHADER_PREPROCESS_PATH_SIZE];
+} ShaderFamilyEntry;
+
+typedef struct {
+	uint64_t key; // 0 marks an empty slot
+	ProgramHandle program; // 0 if the variant failed to preprocess
+	ProgramHandle pending; // rebuild in flight, replaces program once ready
+	uint32_t reload; // 1 + the shader_variants.reloads slot preprocessing it, 0 if none
+	bool dirty;
+	// hashes of every file the sources were built from
+	uint64_t files[SHADER_PREPROCESS_MAX_FILES * 2];
+	uint32_t files_count;
+} ShaderVariantEntry;
+
+static struct {
+	ShaderFamilyEntry families[SHADER_FAMILY_MAX];
+	uint32_t families_count;
+	ShaderVariantEntry variants[SHADER_VARIANT_MAX];
+	uint32_t variants_count;
+} shader_variants;
+
+ShaderFamily shader_family_register(const char *vert_path, const char *frag_path) {
+	for (uint32_t i = 0; i < shader_variants.families_count; ++i) {
+		ShaderFamilyEntry *family = &shader_variants.families[i];
+		if (strcmp(family->vert_path, vert_path) == 0 && strcmp(family->frag_path, frag_path) == 0) {
+			return i + 1;
+		}
+	}
+
+	if (shader_variants.families_count >= SHADER_FAMILY_MAX) {
+		log_error("too many shader families, could not register `%s`", frag_path);
+		return 0;
+	}
+
+	ShaderFamilyEntry *family = &shader_variants.families[shader_variants.families_count++];
+	snprintf(family->vert_path, sizeof(family->vert_path), "%s", vert_path);
+	snprintf(family->frag_path, sizeof(family->frag_path), "%s", frag_path);
+	return shader_variants.families_count;
+}
+
+static uint64_t shader_variant_key(ShaderFamily family, uint32_t features) {
+	return ((uint64_t)family << 32) | features;
+}
+
+static ShaderVariantEntry *shader_variant_slot(uint64_t key) {
+	uint64_t i = hash_fnv1a64(&key, sizeof(key), HASH_FNV1A64_SEED);
+	for (;; ++i) {
+		ShaderVariantEntry *entry = &shader_variants.variants[i & (SHADER_VARIANT_MAX - 1)];
+		if (entry->key == key || entry->key == 0) {
+			return entry;
+		}
+	}
+}
+
+static void shader_variant_add_files(ShaderVariantEntry *entry, const ShaderSource *src) {
+	for (size_t i = 0; i < src->files_count; ++i) {
+		entry->files[entry->files_count++] = hash_cstr(src->files[i], HASH_FNV1A64_SEED);
+		hot_reload_watch(src->files[i]);
+	}
+}
+
+typedef struct {
+	ShaderVariantEntry *entry;
+	const ShaderFamilyEntry *family;
+	uint32_t features;
+	ShaderSource vert, frag;
+	bool vert_ok, frag_ok;
+} ShaderVariantLoad;
+
+// rebuilds started by shader_variant_update, GL thread only
+static struct {
+	ShaderVariantLoad load;
+	JobCounter counter;
+	bool busy;
+} shader_variant_reloads[SHADER_VARIANT_RELOADS];
+
+static void shader_variant_preprocess_vert(void *data, size_t begin, size_t end) {
+	ShaderVariantLoad *load = data;
+	load->vert_ok = shader_preprocess(load->family->vert_path, load->features, &load->vert);
+}
+
+static void shader_variant_preprocess_frag(void *data, size_t begin, size_t end) {
+	ShaderVariantLoad *load = data;
+	load->frag_ok = shader_preprocess(load->family->frag_path, load->features, &load->frag);
+}
+
+// a job, waits for both stages without holding up its worker
+static void shader_variant_load(void *data, size_t begin, size_t end) {
+	JobCounter stages = {0};
+	jobs_run(shader_variant_preprocess_vert, data, &stages);
+	jobs_run(shader_variant_preprocess_frag, data, &stages);
+	jobs_wait(&stages);
+}
+
+static void shader_variant_load_init(ShaderVariantLoad *load, ShaderVariantEntry *entry) {
+	*load = (ShaderVariantLoad){
+		.entry = entry,
+		.family = &shader_variants.families[(entry->key >> 32) - 1],
+		.features = (uint32_t)entry->key,
+	};
+}
+
+// on the GL thread once shader_variant_load finished
+static ProgramHandle shader_variant_submit(ShaderVariantLoad *load) {
+	// the file list is filled even when preprocessing fails,
+	// so fixing a broken include still triggers a rebuild
+	load->entry->files_count = 0;
+	shader_variant_add_files(load->entry, &load->vert);
+	shader_variant_add_files(load->entry, &load->frag);
+	ProgramHandle program = 0;
+	if (load->vert_ok && load->frag_ok) {
+		program = shader_batch_submit(load->vert.source, load->frag.source, load->family->frag_path);
+	}
+
+	shader_source_free(&load->vert);
+	shader_source_free(&load->frag);
+	return program;
+}
+
+static ProgramHandle shader_variant_build(ShaderVariantEntry *entry) {
+	// a new variant, not the steady state
+	alloc_track_excuse();
+	ShaderVariantLoad load;
+	shader_variant_load_init(&load, entry);
+	shader_variant_load(&load, 0, 1);
+	return shader_variant_submit(&load);
+}
+
+// the entry for a variant, a new one with the key set if it wasn't known
+static ShaderVariantEntry *shader_variant_reserve(ShaderFamily family, uint32_t features, bool *created) {
+	*created = false;
+	if (family == 0 || family > shader_variants.families_count) {
+		return NULL;
+	}
+
+	uint64_t key = shader_variant_key(family, features);
+	ShaderVariantEntry *entry = shader_variant_slot(key);
+	if (entry->key == key) {
+		return entry;
+	}
+
+	// keep the table at most half full so probes stay short
+	if (shader_variants.variants_count >= SHADER_VARIANT_MAX / 2) {
+		log_error("too many shader variants");
+		return NULL;
+	}
+
+	*entry = (ShaderVariantEntry){ .key = key };
+	shader_variants.variants_count += 1;
+	*created = true;
+	return entry;
+}
+
+// compiles the variant on first use, check the handle's state before drawing
+ProgramHandle shader_variant_get(ShaderFamily family, uint32_t features) {
+	bool created = false;
+	ShaderVariantEntry *entry = shader_variant_reserve(family, features, &created);
+	if (entry == NULL) {
+		return 0;
+	}
+	if (created) {
+		entry->program = shader_variant_build(entry);
+	}
+	return entry->program;
+}
+
+// HotReloadCallback, marks every variant built from file_path for a rebuild
+void shader_variant_file_changed(const char *file_path) {
+	uint64_t file = hash_cstr(file_path, HASH_FNV1A64_SEED);
+	for (uint32_t i = 0; i < SHADER_VARIANT_MAX; ++i) {
+		ShaderVariantEntry *entry = &shader_variants.variants[i];
+		for (uint32_t j = 0; entry->key != 0 && j < entry->files_count; ++j) {
+			if (entry->files[j] == file) {
+				entry->dirty = true;
+				break;
+			}
+		}
+	}
+}
+
+// preprocesses a changed variant on the workers, stays dirty while all
+// reload slots are busy
+static void shader_variant_reload_start(ShaderVariantEntry *entry) {
+	for (uint32_t i = 0; i < SHADER_VARIANT_RELOADS; ++i) {
+		if (!shader_variant_reloads[i].busy) {
+			shader_variant_reloads[i].busy = true;
+			entry->dirty = false;
+			entry->reload = i + 1;
+			shader_variant_load_init(&shader_variant_reloads[i].load, entry);
+			jobs_run(shader_variant_load, &shader_variant_reloads[i].load, &shader_variant_reloads[i].counter);
+			return;
+		}
+	}
+}
+
+// submits the rebuild once its preprocessing is done
+static void shader_variant_reload_finish(ShaderVariantEntry *entry) {
+	uint32_t slot = entry->reload - 1;
+	if (atomic_load_explicit(&shader_variant_reloads[slot].counter.pending, memory_order_acquire) != 0) {
+		return;
+	}
+	// an edited variant, not the steady state
+	alloc_track_excuse();
+	ProgramHandle program = shader_variant_submit(&shader_variant_reloads[slot].load);
+	shader_variant_reloads[slot].busy = false;
+	entry->reload = 0;
+	if (entry->program == 0) {
+		entry->program = program;
+	} else {
+		entry->pending = program;
+	}
+}
+
+// Call once per frame after shader_batch_poll. Starts rebuilds of changed
+// variants and swaps in the ones that finished, the programs handed out by
+// shader_variant_get change at this point, so anything resolved against the
+// old GL program has to be resolved again.
+void shader_variant_update(void) {
+	for (uint32_t i = 0; i < SHADER_VARIANT_MAX; ++i) {
+		ShaderVariantEntry *entry = &shader_variants.variants[i];
+		if (entry->key == 0) {
+			continue;
+		}
+
+		if (entry->pending != 0) {
+			ProgramState state = shader_batch_state(entry->pending);
+			if (state == PROGRAM_READY) {
+				shader_batch_release(entry->program);
+				entry->program = entry->pending;
+				entry->pending = 0;
+			} else if (state == PROGRAM_FAILED) {
+				// keep running with the last program that worked
+				shader_batch_release(entry->pending);
+				entry->pending = 0;
+			}
+		}
+
+		if (entry->reload != 0) {
+			shader_variant_reload_finish(entry);
+		}
+
+		// one rebuild at a time, more edits during it queue another one
+		if (entry->dirty && entry->pending == 0 && entry->reload == 0) {
+			shader_variant_reload_start(entry);
+		}
+	}
+}
+
+// waits for the rebuilds still preprocessing, call before jobs_shutdown
+void shader_variant_shutdown(void) {
+	for (uint32_t i = 0; i < SHADER_VARIANT_RELOADS; ++i) {
+		if (shader_variant_reloads[i].busy) {
+			jobs_wait(&shader_variant_reloads[i].counter);
+			shader_source_free(&shader_variant_reloads[i].load.vert);
+			shader_source_free(&shader_variant_reloads[i].load.frag);
+			shader_variant_reloads[i].busy = false;
+		}
+	}
+}
+
+static bool shader_feature_from_name(const char *name, uint32_t *feature) {
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+		if (strcmp(shader_feature_names[i], name) == 0) {
+			*feature = 1u << i;
+			return true;
+		}
+	}
+	return false;
+}
+
+typedef struct {
+	JobCounter counter;
+	ShaderVariantLoad *loads;
+	uint32_t loads_count;
+	bool ok;
+} ShaderPrewarm;
+
+// Each line of a manifest names one variant to build ahead of time:
+//     <vertex file> <fragment file> [FEATURE...]
+// paths are relative to the working directory, `#` starts a comment.
+// Starts preprocessing every variant of the manifest on the job system,
+// shader_variant_prewarm_end hands them to GL. The variants read as failed
+// in between, load the rest of what startup needs meanwhile.
+void shader_variant_prewarm_begin(const char *manifest_path, ShaderPrewarm *prewarm) {
+	*prewarm = (ShaderPrewarm){ .ok = true };
+	Arena *scratch = arena_scratch();
+	ArenaMark mark = arena_mark(scratch);
+	char *text = read_entire_file_arena(manifest_path, scratch);
+	if (text == NULL) {
+		log_error("failed to read file `%s`: %s", manifest_path, strerror(errno));
+		errno = 0;
+		prewarm->ok = false;
+		return;
+	}
+	prewarm->loads = calloc(SHADER_VARIANT_MAX / 2, sizeof(ShaderVariantLoad));
+	if (prewarm->loads == NULL) {
+		log_error("out of memory prewarming `%s`", manifest_path);
+		arena_rewind(scratch, mark);
+		prewarm->ok = false;
+		return;
+	}
+
+	int line_number = 0;
+	for (char *line = text, *next = NULL; line != NULL; line = next) {
+		line_number += 1;
+		next = strchr(line, '\n');
+		if (next != NULL) *next++ = '\0';
+
+		char *comment = strchr(line, '#');
+		if (comment != NULL) *comment = '\0';
+
+		char *save_word = NULL;
+		const char *vert_path = strtok_r(line, " \t\r", &save_word);
+		if (vert_path == NULL) continue;
+		const char *frag_path = strtok_r(NULL, " \t\r", &save_word);
+		if (frag_path == NULL) {
+			log_error("%s:%d: expected a fragment shader after `%s`", manifest_path, line_number, vert_path);
+			prewarm->ok = false;
+			continue;
+		}
+
+		uint32_t features = 0;
+		bool line_ok = true;
+		for (const char *name = strtok_r(NULL, " \t\r", &save_word); name != NULL; name = strtok_r(NULL, " \t\r", &save_word)) {
+			uint32_t feature = 0;
+			if (!shader_feature_from_name(name, &feature)) {
+				log_error("%s:%d: unknown shader feature `%s`", manifest_path, line_number, name);
+				line_ok = false;
+				break;
+			}
+			features |= feature;
+		}
+		if (!line_ok) {
+			prewarm->ok = false;
+			continue;
+		}
+
+		bool created = false;
+		ShaderFamily family = shader_family_register(vert_path, frag_path);
+		ShaderVariantEntry *entry = shader_variant_reserve(family, features, &created);
+		if (entry == NULL) {
+			prewarm->ok = false;
+		} else if (created) {
+			ShaderVariantLoad *load = &prewarm->loads[prewarm->loads_count++];
+			shader_variant_load_init(load, entry);
+			jobs_run(shader_variant_load, load, &prewarm->counter);
+		}
+	}
+
+	arena_rewind(scratch, mark);
+}
+
+// waits for the loads shader_variant_prewarm_begin started and submits them
+bool shader_variant_prewarm_end(ShaderPrewarm *prewarm) {
+	jobs_wait(&prewarm->counter);
+	for (uint32_t i = 0; i < prewarm->loads_count; ++i) {
+		ShaderVariantLoad *load = &prewarm->loads[i];
+		load->entry->program = shader_variant_submit(load);
+		if (load->entry->program == 0) {
+			prewarm->ok = false;
+		}
+	}
+	free(prewarm->loads);
+	prewarm->loads = NULL;
+	return prewarm->ok;
+}
+
+bool shader_variant_prewarm_manifest(const char *manifest_path) {
+	ShaderPrewarm prewarm;
+	shader_variant_prewarm_begin(manifest_path, &prewarm);
+	return shader_variant_prewarm_end(&prewarm);
+}
@@ -0,0 +1,13 @@
+#define SKINNING_MAX_BONES 64
+
+layout (location = 6) in uvec4 a_bone_ids;
+layout (location = 7) in vec4  a_bone_weights;
+
+uniform mat4 u_bones[SKINNING_MAX_BONES];
+
+mat4 skinning_matrix() {
+	return a_bone_weights.x * u_bones[a_bone_ids.x]
+		 + a_bone_weights.y * u_bones[a_bone_ids.y]
+		 + a_bone_weights.z * u_bones[a_bone_ids.z]
+		 + a_bone_weights.w * u_bones[a_bone_ids.w];
+}
@@ -0,0 +1,50 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed timestep simulation.
+// Frame time goes into an accumulator that is paid out in whole steps of
+// the same length, so simulation cost follows wall time instead of frame
+// rate and runs fed the same frame times step the same way. What's left in
+// the accumulator is how far the frame lies past the newest step; rendering
+// interpolates between the last two steps by that much.
+// After a long stall the steps owed are capped, the rest of the time is
+// dropped and the simulation runs slow for a moment instead of spending
+// ever longer frames catching up.
+
+typedef struct {
+	double step;      // seconds per step
+	int max_steps;    // per frame
+	double accumulator;
+	uint64_t steps;   // run so far
+	double dropped;   // seconds given up to max_steps so far
+} FixedTimestep;
+
+void fixed_timestep_init(FixedTimestep *timestep, double step, int max_steps) {
+	*timestep = (FixedTimestep){ .step = step, .max_steps = max_steps };
+}
+
+// how many steps to run for a frame that took frame_seconds
+int fixed_timestep_advance(FixedTimestep *timestep, double frame_seconds) {
+	if (frame_seconds > 0.0) {
+		timestep->accumulator += frame_seconds;
+	}
+	int steps = (int)(timestep->accumulator / timestep->step);
+	if (steps > timestep->max_steps) {
+		// keep the fraction, so interpolation doesn't jump
+		double owed = timestep->accumulator - timestep->max_steps * timestep->step;
+		double kept = owed - (steps - timestep->max_steps) * timestep->step;
+		timestep->dropped += owed - kept;
+		timestep->accumulator = kept + timestep->max_steps * timestep->step;
+		steps = timestep->max_steps;
+	}
+	timestep->accumulator -= steps * timestep->step;
+	timestep->steps += steps;
+	return steps;
+}
+
+// where between the previous and the newest step to draw, 0 to 1
+float fixed_timestep_alpha(const FixedTimestep *timestep) {
+	float alpha = (float)(timestep->accumulator / timestep->step);
+	return alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+}
+
@@ -0,0 +1,289 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+// Two level segregated fit allocation of ranges, after Masmano et al.
+// A Tlsf hands out ranges of a span of units it doesn't own, offsets into
+// a GL buffer for instance, so its blocks are kept in a table of their own
+// rather than in headers inside the span. Free blocks sit in lists by size
+// class: the first level is the power of two at or below the size, the
+// second splits it into TLSF_SL_COUNT linear steps, and a bit per list
+// says whether it has any. Allocating rounds the size up to the next
+// class, so any block of the first non-empty list from there fits, two bit
+// scans find it. Freeing merges the block with its free neighbours in the
+// span right away, no two free blocks are ever next to each other. Both
+// take constant time, only tlsf_stats walks the blocks.
+// Not thread safe.
+
+#define TLSF_SL_LOG2    4
+#define TLSF_SL_COUNT   (1u << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT   (32 - TLSF_SL_LOG2 + 1)
+#define TLSF_MAX_BLOCKS 1024 // free and used, per allocator
+#define TLSF_NONE       UINT32_MAX
+
+typedef struct {
+	uint32_t offset, size;         // in units
+	uint32_t prev, next;           // neighbours in the span, TLSF_NONE at its ends
+	uint32_t prev_free, next_free; // in its free list, next_free chains unused blocks too
+	bool free;
+} TlsfBlock;
+
+typedef struct {
+	uint32_t size;   // of the span
+	uint32_t first;  // block at offset 0
+	uint32_t unused; // first block of the table nothing uses, TLSF_NONE if none
+	uint32_t blocks_count; // used and free
+	uint32_t free;   // units in free blocks
+	uint32_t fl_bitmap;
+	uint32_t sl_bitmap[TLSF_FL_COUNT];
+	uint32_t heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+	TlsfBlock blocks[TLSF_MAX_BLOCKS];
+} Tlsf;
+
+typedef struct {
+	uint32_t size, used, free; // in units
+	uint32_t largest_free;
+	uint32_t used_blocks, free_blocks;
+	float fragmentation; // 1 - largest_free / free, 0 with one free block
+} TlsfStats;
+
+static uint32_t tlsf_log2(uint32_t value) {
+	return 31 - (uint32_t)__builtin_clz(value);
+}
+
+static void tlsf_mapping(uint32_t size, uint32_t *fl, uint32_t *sl) {
+	if (size < TLSF_SL_COUNT) {
+		*fl = 0;
+		*sl = size;
+		return;
+	}
+	uint32_t log2 = tlsf_log2(size);
+	*fl = log2 - TLSF_SL_LOG2 + 1;
+	*sl = (size >> (log2 - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+}
+
+static void tlsf_insert(Tlsf *tlsf, uint32_t index) {
+	TlsfBlock *block = &tlsf->blocks[index];
+	uint32_t fl = 0, sl = 0;
+	tlsf_mapping(block->size, &fl, &sl);
+	block->free = true;
+	block->prev_free = TLSF_NONE;
+	block->next_free = tlsf->heads[fl][sl];
+	if (block->next_free != TLSF_NONE) {
+		tlsf->blocks[block->next_free].prev_free = index;
+	}
+	tlsf->heads[fl][sl] = index;
+	tlsf->free += block->size;
+	tlsf->fl_bitmap |= 1u << fl;
+	tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void tlsf_remove(Tlsf *tlsf, uint32_t index) {
+	TlsfBlock *block = &tlsf->blocks[index];
+	uint32_t fl = 0, sl = 0;
+	tlsf_mapping(block->size, &fl, &sl);
+	if (block->prev_free != TLSF_NONE) {
+		tlsf->blocks[block->prev_free].next_free = block->next_free;
+	} else {
+		tlsf->heads[fl][sl] = block->next_free;
+		if (block->next_free == TLSF_NONE) {
+			tlsf->sl_bitmap[fl] &= ~(1u << sl);
+			if (tlsf->sl_bitmap[fl] == 0) {
+				tlsf->fl_bitmap &= ~(1u << fl);
+			}
+		}
+	}
+	if (block->next_free != TLSF_NONE) {
+		tlsf->blocks[block->next_free].prev_free = block->prev_free;
+	}
+	tlsf->free -= block->size;
+	block->free = false;
+}
+
+static uint32_t tlsf_new_block(Tlsf *tlsf) {
+	uint32_t index = tlsf->unused;
+	tlsf->unused = tlsf->blocks[index].next_free;
+	tlsf->blocks_count += 1;
+	return index;
+}
+
+static void tlsf_drop_block(Tlsf *tlsf, uint32_t index) {
+	tlsf->blocks[index].next_free = tlsf->unused;
+	tlsf->unused = index;
+	tlsf->blocks_count -= 1;
+}
+
+// the first free block of a class at or above fl and sl, TLSF_NONE if none
+static uint32_t tlsf_find(const Tlsf *tlsf, uint32_t fl, uint32_t sl) {
+	uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0) {
+		uint32_t fl_map = fl + 1 < 32 ? tlsf->fl_bitmap & (~0u << (fl + 1)) : 0;
+		if (fl_map == 0) {
+			return TLSF_NONE;
+		}
+		fl = (uint32_t)__builtin_ctz(fl_map);
+		sl_map = tlsf->sl_bitmap[fl];
+	}
+	return tlsf->heads[fl][(uint32_t)__builtin_ctz(sl_map)];
+}
+
+// one free block over all size units
+void tlsf_init(Tlsf *tlsf, uint32_t size) {
+	*tlsf = (Tlsf){ .size = size };
+	for (uint32_t fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+		for (uint32_t sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+			tlsf->heads[fl][sl] = TLSF_NONE;
+		}
+	}
+	for (uint32_t i = 0; i < TLSF_MAX_BLOCKS; ++i) {
+		tlsf->blocks[i].next_free = i + 1 < TLSF_MAX_BLOCKS ? i + 1 : TLSF_NONE;
+	}
+	tlsf->unused = 0;
+	tlsf->first = tlsf_new_block(tlsf);
+	tlsf->blocks[tlsf->first] = (TlsfBlock){ .size = size, .prev = TLSF_NONE, .next = TLSF_NONE };
+	tlsf_insert(tlsf, tlsf->first);
+}
+
+// Size units at an offset that's a multiple of align, a power of two.
+// block is what tlsf_free takes back. False when nothing fits.
+bool tlsf_alloc(Tlsf *tlsf, uint32_t size, uint32_t align, uint32_t *block, uint32_t *offset) {
+	if (size == 0 || align == 0 || (align & (align - 1)) != 0) {
+		log_error("tlsf_alloc of %u units aligned to %u", size, align);
+		return false;
+	}
+	// splitting takes up to two blocks of the table
+	if (tlsf->blocks_count + 2 > TLSF_MAX_BLOCKS) {
+		return false;
+	}
+	// any block of the class above the size plus the worst alignment fits
+	uint32_t request = size + (align - 1);
+	if (request < size) {
+		return false;
+	}
+	if (request >= TLSF_SL_COUNT) {
+		uint32_t round = (1u << (tlsf_log2(request) - TLSF_SL_LOG2)) - 1;
+		if (request + round < request) {
+			return false;
+		}
+		request += round;
+	}
+	uint32_t fl = 0, sl = 0;
+	tlsf_mapping(request, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT) {
+		return false;
+	}
+	uint32_t index = tlsf_find(tlsf, fl, sl);
+	if (index == TLSF_NONE) {
+		return false;
+	}
+	tlsf_remove(tlsf, index);
+	TlsfBlock *found = &tlsf->blocks[index];
+
+	// what alignment skips stays free, its neighbour before is used
+	uint32_t gap = (align - found->offset % align) % align;
+	if (gap > 0) {
+		uint32_t front = tlsf_new_block(tlsf);
+		tlsf->blocks[front] = (TlsfBlock){
+			.offset = found->offset, .size = gap, .prev = found->prev, .next = index,
+		};
+		if (found->prev != TLSF_NONE) {
+			tlsf->blocks[found->prev].next = front;
+		} else {
+			tlsf->first = front;
+		}
+		found->prev = front;
+		found->offset += gap;
+		found->size -= gap;
+		tlsf_insert(tlsf, front);
+	}
+	if (found->size > size) {
+		uint32_t back = tlsf_new_block(tlsf);
+		tlsf->blocks[back] = (TlsfBlock){
+			.offset = found->offset + size, .size = found->size - size, .prev = index, .next = found->next,
+		};
+		if (found->next != TLSF_NONE) {
+			tlsf->blocks[found->next].prev = back;
+		}
+		found->next = back;
+		found->size = size;
+		tlsf_insert(tlsf, back);
+	}
+	*block = index;
+	*offset = found->offset;
+	return true;
+}
+
+// takes back a block of tlsf_alloc and merges it with free neighbours
+void tlsf_free(Tlsf *tlsf, uint32_t block) {
+	if (block >= TLSF_MAX_BLOCKS || tlsf->blocks[block].free || tlsf->blocks[block].size == 0) {
+		log_error("tlsf_free of a block that isn't allocated");
+		return;
+	}
+	TlsfBlock *freed = &tlsf->blocks[block];
+	if (freed->prev != TLSF_NONE && tlsf->blocks[freed->prev].free) {
+		uint32_t prev = freed->prev;
+		TlsfBlock *merged = &tlsf->blocks[prev];
+		tlsf_remove(tlsf, prev);
+		merged->size += freed->size;
+		merged->next = freed->next;
+		if (freed->next != TLSF_NONE) {
+			tlsf->blocks[freed->next].prev = prev;
+		}
+		freed->size = 0;
+		tlsf_drop_block(tlsf, block);
+		block = prev;
+		freed = merged;
+	}
+	if (freed->next != TLSF_NONE && tlsf->blocks[freed->next].free) {
+		uint32_t next = freed->next;
+		TlsfBlock *merged = &tlsf->blocks[next];
+		tlsf_remove(tlsf, next);
+		freed->size += merged->size;
+		freed->next = merged->next;
+		if (merged->next != TLSF_NONE) {
+			tlsf->blocks[merged->next].prev = block;
+		}
+		merged->size = 0;
+		tlsf_drop_block(tlsf, next);
+	}
+	tlsf_insert(tlsf, block);
+}
+
+// Like the fragmentation of tlsf_stats without walking the blocks, the
+// largest free block is only looked for in the highest non-empty list.
+float tlsf_fragmentation(const Tlsf *tlsf) {
+	if (tlsf->fl_bitmap == 0) {
+		return 0.0f;
+	}
+	uint32_t fl = tlsf_log2(tlsf->fl_bitmap);
+	uint32_t largest = 0;
+	for (uint32_t i = tlsf->heads[fl][tlsf_log2(tlsf->sl_bitmap[fl])]; i != TLSF_NONE; i = tlsf->blocks[i].next_free) {
+		if (tlsf->blocks[i].size > largest) {
+			largest = tlsf->blocks[i].size;
+		}
+	}
+	return 1.0f - (float)largest / tlsf->free;
+}
+
+// the size of an allocated block
+uint32_t tlsf_size(const Tlsf *tlsf, uint32_t block) {
+	return tlsf->blocks[block].size;
+}
+
+TlsfStats tlsf_stats(const Tlsf *tlsf) {
+	TlsfStats stats = { .size = tlsf->size };
+	for (uint32_t i = tlsf->first; i != TLSF_NONE; i = tlsf->blocks[i].next) {
+		const TlsfBlock *block = &tlsf->blocks[i];
+		if (block->free) {
+			stats.free += block->size;
+			stats.free_blocks += 1;
+			if (block->size > stats.largest_free) {
+				stats.largest_free = block->size;
+			}
+		} else {
+			stats.used += block->size;
+			stats.used_blocks += 1;
+		}
+	}
+	stats.fragmentation = stats.free != 0 ? 1.0f - (float)stats.largest_free / stats.free : 0.0f;
+	return stats;
+}
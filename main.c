@@ -13,6 +13,11 @@
 #define SCREEN_WIDTH  800
 #define SCREEN_HEIGHT 600
 #define ENABLE_VSYNC 1
+// 1 for a debug context wired to message_callback, 0 for a release context
+// that asks for KHR_no_error, `make main-debug` builds the former
+#ifndef ENABLE_GL_DEBUG
+#define ENABLE_GL_DEBUG 0
+#endif
 
 char *read_entire_file(const char *file_path) {
 	FILE *f = NULL;
@@ -186,7 +191,11 @@ int main(void) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if ENABLE_GL_DEBUG
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#else
+	glfwWindowHint(GLFW_CONTEXT_NO_ERROR, GL_TRUE);
+#endif
 
 	GLFWwindow * const window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "opengl_template", NULL, NULL);
 	if (window == NULL) {
@@ -204,12 +213,12 @@ int main(void) {
 
 
 
-#if ENABLE_GL_MESSAGE_CALLBACK
+#if ENABLE_GL_DEBUG
 	if (glDebugMessageCallbackARB != NULL) {
 		glEnable(GL_DEBUG_OUTPUT);
 		glDebugMessageCallbackARB(message_callback, 0);
 	}
-#endif // ENABLE_GL_MESSAGE_CALLBACK
+#endif // ENABLE_GL_DEBUG
 	glfwSetFramebufferSizeCallback(window, window_size_callback);
 	glfwSetKeyCallback(window, key_callback);
 
@@ -243,8 +252,9 @@ int main(void) {
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    const GLint in_pos_location = glGetAttribLocation(program, "in_pos");
-    const GLint in_col_location = glGetAttribLocation(program, "in_col");
+	// fixed by layout qualifiers in shader.vert, no need to ask the driver
+	const GLint in_pos_location = 0;
+	const GLint in_col_location = 1;
 
 	GLuint vertex_array;
 	glGenVertexArrays(1, &vertex_array);
@@ -1,7 +1,7 @@
 #version 330 core
 
-in vec3 in_pos;
-in vec3 in_col;
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_col;
 
 out vec3 color;
 